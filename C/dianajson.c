@@ -1,11 +1,34 @@
 #include "dianajson.h"
 #include <assert.h> /* assert() */
 #include <stddef.h>
+#include <stdint.h> /* uint64_t */
 #include <stdlib.h>
 #include <stdio.h>  /* sprintf */
 #include <errno.h>  /* errno, ERANGE */
 #include <math.h>   /* HUGE_VAL */
 #include <string.h> /* memcpy() */
+#if DIANA_PARSE_STATS
+#include <time.h> /* clock() */
+#endif
+
+/* 按编译目标选择字符串与白空格扫描的实现：AVX2、SSSE3、SSE2（x86-64的基线）或逐字节 */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DIANA_SIMD_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#define DIANA_SIMD_WIDTH 16
+#endif
+#if defined(DIANA_SIMD_WIDTH) && defined(_MSC_VER)
+#include <intrin.h> /* _BitScanForward */
+#endif
+#if DIANA_PARSE_VALIDATE_UTF8 && (defined(__AVX2__) || defined(__SSSE3__))
+#define DIANA_UTF8_SIMD 1 /* 以查表法向量化校验UTF-8，否则逐字节校验含非ASCII字节的段 */
+#endif
 
 /* 使用者可在编译选项中自行设置DIANA_PARSE_STACK_INIT_SIZE宏 */
 #ifndef DIANA_PARSE_STACK_INIT_SIZE
@@ -27,14 +50,290 @@
 #define ISDIGIT(ch) ((ch) >= '0' && (ch) <= '9')
 #define ISDIGIT1TO9(ch) ((ch) >= '1' && (ch) <= '9')
 
+/* 使用者可在编译选项中自行设置DIANA_ARENA_BLOCK_SIZE宏 */
+#ifndef DIANA_ARENA_BLOCK_SIZE
+#define DIANA_ARENA_BLOCK_SIZE 65536
+#endif
+
+/* 默认分配器：malloc/realloc/free */
+static void *diana_std_alloc(void *user, size_t size)
+{
+    (void)user;
+    return malloc(size);
+}
+
+static void *diana_std_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    (void)user;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void diana_std_free(void *user, void *ptr, size_t size)
+{
+    (void)user;
+    (void)size;
+    free(ptr);
+}
+
+static const diana_allocator diana_std_allocator = {diana_std_alloc, diana_std_realloc, diana_std_free, NULL};
+
+#define DIANA_ALLOCATOR(a) ((a) != NULL ? (a) : &diana_std_allocator)
+
+/* 经分配器分配与释放，零长度对应NULL */
+static void *diana_malloc(const diana_allocator *a, size_t size)
+{
+    return size > 0 ? a->alloc(a->user, size) : NULL;
+}
+
+static void diana_dealloc(const diana_allocator *a, void *ptr, size_t size)
+{
+    if (ptr != NULL && a->free != NULL)
+        a->free(a->user, ptr, size);
+}
+
+static void *diana_realloc(const diana_allocator *a, void *ptr, size_t old_size, size_t new_size)
+{
+    if (ptr == NULL)
+        return diana_malloc(a, new_size);
+    if (new_size == 0)
+    {
+        diana_dealloc(a, ptr, old_size);
+        return NULL;
+    }
+    return a->realloc(a->user, ptr, old_size, new_size);
+}
+
+/* 标签：低8位为类型，其余位为字符串长度、元素数或成员数 */
+#define DIANA_TYPE(v) ((diana_type)((v)->tag & 0xFF))
+#define DIANA_SIZE(v) ((size_t)((v)->tag >> 8))
+#define DIANA_TAG(type, size) ((uint64_t)(size) << 8 | (uint64_t)(type))
+#define DIANA_SET_SIZE(v, size) ((v)->tag = DIANA_TAG(DIANA_TYPE(v), size))
+
+/* 短字符串存放在值内，其余在堆上 */
+#define DIANA_IS_SHORT(len) ((len) < DIANA_SHORT_STRING_SIZE)
+#define DIANA_STRING_DATA(v) (DIANA_IS_SHORT(DIANA_SIZE(v)) ? (v)->u.ss : (v)->u.s)
+
+/* 堆上的字符串之前存放引用计数，u.s指向其后的字符 */
+#define DIANA_STRING_REFS(v) ((size_t *)(void *)(v)->u.s - 1)
+#define DIANA_STRING_BYTES(len) (sizeof(size_t) + (len) + 1)
+
+typedef struct diana_object_index diana_object_index;
+
+/* 数组与对象堆块的头部，元素（成员）紧随其后；容量为0时不分配，指针为NULL */
+typedef struct
+{
+    size_t refs; // 引用计数：共享复制时增加，大于1时修改前先复制（写时复制）
+    size_t capacity;
+    diana_object_index *index; // 仅对象使用：成员数超过阈值后建立的哈希索引，否则为NULL
+} diana_container;
+
+#define DIANA_HEADER(p) ((diana_container *)(void *)(p) - 1)
+#define DIANA_CAPACITY(v) ((v)->u.e != NULL ? DIANA_HEADER((v)->u.e)->capacity : 0)
+#define DIANA_INDEX(v) ((v)->u.m != NULL ? DIANA_HEADER((v)->u.m)->index : NULL)
+
+/* 对象哈希索引：成员数超过阈值的对象在成员数组之外维护一张开放寻址（线性探测）表 */
+/* 表中记录键的哈希值与成员下标，槽数为2的幂且不小于容量的两倍，扩容时直接使用记录的哈希值重建 */
+/* 使用者可在编译选项中自行设置DIANA_OBJECT_INDEX_THRESHOLD宏 */
+#ifndef DIANA_OBJECT_INDEX_THRESHOLD
+#define DIANA_OBJECT_INDEX_THRESHOLD 8
+#endif
+
+typedef struct
+{
+    size_t hash;
+    size_t pos; // 成员下标+1，0表示空槽
+} diana_slot;
+
+struct diana_object_index
+{
+    size_t mask; // 槽数-1
+    diana_slot slots[];
+};
+
+/* FNV-1a */
+static size_t diana_hash_key(const char *key, size_t klen)
+{
+    uint64_t h = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < klen; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static size_t diana_index_bytes(const diana_object_index *index)
+{
+    return sizeof(diana_object_index) + (index->mask + 1) * sizeof(diana_slot);
+}
+
+/* 分配、扩展或收缩数组（对象）的堆块，elem为元素（成员）大小，保留头部中的索引 */
+/* capacity为0时连同索引一起释放，返回NULL；只用于独占的堆块 */
+static void *diana_container_resize(void *p, size_t elem, size_t capacity, const diana_allocator *a)
+{
+    diana_container *h = p != NULL ? DIANA_HEADER(p) : NULL;
+    size_t old = h != NULL ? sizeof(diana_container) + h->capacity * elem : 0;
+    assert(h == NULL || h->refs <= 1);
+    if (capacity == 0)
+    {
+        if (h != NULL)
+        {
+            if (h->index != NULL)
+                diana_dealloc(a, h->index, diana_index_bytes(h->index));
+            diana_dealloc(a, h, old);
+        }
+        return NULL;
+    }
+    h = (diana_container *)diana_realloc(a, h, old, sizeof(diana_container) + capacity * elem);
+    if (p == NULL)
+    {
+        h->refs = 1;
+        h->index = NULL;
+    }
+    h->capacity = capacity;
+    return h + 1;
+}
+
+static void diana_index_insert(diana_object_index *index, size_t hash, size_t pos)
+{
+    size_t i = hash & index->mask;
+    while (index->slots[i].pos != 0)
+        i = (i + 1) & index->mask;
+    index->slots[i].hash = hash;
+    index->slots[i].pos = pos + 1;
+}
+
+/* 删除成员下标pos对应的槽，将探测链中后续的槽前移以保持连续 */
+static void diana_index_erase(diana_object_index *index, size_t hash, size_t pos)
+{
+    size_t i = hash & index->mask, j, home;
+    while (index->slots[i].pos != pos + 1)
+        i = (i + 1) & index->mask;
+    for (j = (i + 1) & index->mask; index->slots[j].pos != 0; j = (j + 1) & index->mask)
+    {
+        home = index->slots[j].hash & index->mask;
+        if (((j - home) & index->mask) >= ((j - i) & index->mask))
+        {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i].pos = 0;
+}
+
+/* 查找键对应的成员下标，hash仅在存在索引时使用 */
+static size_t diana_object_lookup(const diana_value *v, const char *key, size_t klen, size_t hash)
+{
+    const diana_object_index *index = DIANA_INDEX(v);
+    const diana_member *m;
+    size_t i;
+    if (index == NULL)
+    {
+        for (i = 0; i < DIANA_SIZE(v); i++)
+        {
+            if (v->u.m[i].klen == klen && memcmp(v->u.m[i].k, key, klen) == 0)
+                return i;
+        }
+        return DIANA_KEY_NOT_EXIST;
+    }
+    for (i = hash & index->mask; index->slots[i].pos != 0; i = (i + 1) & index->mask)
+    {
+        if (index->slots[i].hash != hash)
+            continue;
+        m = &v->u.m[index->slots[i].pos - 1];
+        if (m->klen == klen && memcmp(m->k, key, klen) == 0)
+            return index->slots[i].pos - 1;
+    }
+    return DIANA_KEY_NOT_EXIST;
+}
+
+#define DIANA_OBJECT_HASH(v, key, klen) (DIANA_INDEX(v) != NULL ? diana_hash_key(key, klen) : 0)
+
+/* 按当前成员数与容量建立或重建索引，成员数不超过阈值时释放索引 */
+/* from非NULL时复用其中记录的哈希值（成员下标须与v一致），否则由键计算 */
+static void diana_object_reindex(diana_value *v, const diana_object_index *from, const diana_allocator *a)
+{
+    diana_object_index *old = DIANA_INDEX(v), *index;
+    size_t i, slots;
+    if (DIANA_SIZE(v) <= DIANA_OBJECT_INDEX_THRESHOLD)
+    {
+        if (old != NULL)
+        {
+            diana_dealloc(a, old, diana_index_bytes(old));
+            DIANA_HEADER(v->u.m)->index = NULL;
+        }
+        return;
+    }
+    for (slots = 16; slots < DIANA_CAPACITY(v) * 2; slots <<= 1)
+        ;
+    if (old != NULL && old == from && old->mask + 1 == slots)
+        return;
+    index = (diana_object_index *)diana_malloc(a, sizeof(diana_object_index) + slots * sizeof(diana_slot));
+    index->mask = slots - 1;
+    memset(index->slots, 0, slots * sizeof(diana_slot));
+    if (from != NULL)
+    {
+        for (i = 0; i <= from->mask; i++)
+            if (from->slots[i].pos != 0)
+                diana_index_insert(index, from->slots[i].hash, from->slots[i].pos - 1);
+    }
+    else
+    {
+        for (i = 0; i < DIANA_SIZE(v); i++)
+            diana_index_insert(index, diana_hash_key(v->u.m[i].k, v->u.m[i].klen), i);
+    }
+    if (old != NULL)
+        diana_dealloc(a, old, diana_index_bytes(old));
+    DIANA_HEADER(v->u.m)->index = index;
+}
+
+/* 在末尾追加成员（接管已分配的键），维护索引；hash仅在存在索引时使用 */
+static diana_value *diana_object_append(diana_value *v, char *k, size_t klen, size_t hash, const diana_allocator *a)
+{
+    diana_member *m;
+    size_t size = DIANA_SIZE(v);
+    if (size == DIANA_CAPACITY(v))
+        diana_reserve_object_alloc(v, size == 0 ? 1 : size * 2, a);
+    m = &v->u.m[size];
+    m->k = k;
+    m->klen = klen;
+    diana_init(&m->v);
+    DIANA_SET_SIZE(v, size + 1);
+    if (DIANA_INDEX(v) != NULL)
+        diana_index_insert(DIANA_INDEX(v), hash, size);
+    else if (size + 1 > DIANA_OBJECT_INDEX_THRESHOLD)
+        diana_object_reindex(v, NULL, a);
+    return &m->v;
+}
+
 /* 减少解析函数之间传递多个参数 */
 typedef struct
 {
     const char *json;
     char *stack;
-    size_t size, top; // size当前堆栈容量，top栈顶位置
+    size_t size, top;         // size当前堆栈容量，top栈顶位置
+    const diana_allocator *a; // 为解析结果分配内存，堆栈本身始终使用malloc
+#if DIANA_PARSE_STATS
+    diana_parse_stats stats;
+#endif
 } diana_context;
 
+/* 解析统计，DIANA_PARSE_STATS为0时展开为空 */
+#if DIANA_PARSE_STATS
+#define DIANA_STAT(stmt) \
+    do                   \
+    {                    \
+        stmt;            \
+    } while (0)
+#else
+#define DIANA_STAT(stmt) \
+    do                   \
+    {                    \
+    } while (0)
+#endif
+
 static void *diana_context_push(diana_context *c, size_t size)
 {
     void *ret;
@@ -64,16 +363,144 @@ static void *diana_context_pop(diana_context *c, size_t size)
         *(char *)diana_context_push(c, sizeof(char)) = (ch); \
     } while (0)
 
+#define ISWHITESPACE(ch) ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+
+#ifdef DIANA_SIMD_WIDTH
+/* 按对齐的块读取：对齐的块不会跨越内存页，读到'\0'之后的块尾是安全的，但AddressSanitizer会报告越界 */
+#if defined(__GNUC__) || defined(__clang__)
+#define DIANA_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define DIANA_NO_SANITIZE_ADDRESS
+#endif
+
+static unsigned diana_ctz(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return (unsigned)i;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#if DIANA_SIMD_WIDTH == 32
+typedef __m256i diana_simd;
+#define DIANA_SIMD_LOAD(p) _mm256_load_si256((const __m256i *)(const void *)(p))
+#define DIANA_SIMD_LOADU(p) _mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define DIANA_SIMD_SET1(ch) _mm256_set1_epi8((char)(ch))
+#define DIANA_SIMD_ZERO() _mm256_setzero_si256()
+#define DIANA_SIMD_AND(a, b) _mm256_and_si256(a, b)
+#define DIANA_SIMD_OR(a, b) _mm256_or_si256(a, b)
+#define DIANA_SIMD_EQ(a, b) _mm256_cmpeq_epi8(a, b)
+#define DIANA_SIMD_LT(a, b) _mm256_cmpgt_epi8(b, a)
+#define DIANA_SIMD_MIN(a, b) _mm256_min_epu8(a, b)
+#define DIANA_SIMD_MASK(a) ((unsigned)_mm256_movemask_epi8(a))
+#define DIANA_SIMD_INDEX() _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, \
+                                            16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31)
+#define DIANA_SIMD_ALL_BITS 0xFFFFFFFFu
+#else
+typedef __m128i diana_simd;
+#define DIANA_SIMD_LOAD(p) _mm_load_si128((const __m128i *)(const void *)(p))
+#define DIANA_SIMD_LOADU(p) _mm_loadu_si128((const __m128i *)(const void *)(p))
+#define DIANA_SIMD_SET1(ch) _mm_set1_epi8((char)(ch))
+#define DIANA_SIMD_ZERO() _mm_setzero_si128()
+#define DIANA_SIMD_AND(a, b) _mm_and_si128(a, b)
+#define DIANA_SIMD_OR(a, b) _mm_or_si128(a, b)
+#define DIANA_SIMD_EQ(a, b) _mm_cmpeq_epi8(a, b)
+#define DIANA_SIMD_LT(a, b) _mm_cmplt_epi8(a, b)
+#define DIANA_SIMD_MIN(a, b) _mm_min_epu8(a, b)
+#define DIANA_SIMD_MASK(a) ((unsigned)_mm_movemask_epi8(a))
+#define DIANA_SIMD_INDEX() _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+#define DIANA_SIMD_ALL_BITS 0xFFFFu
+#endif
+
+/* 白空格多为几个到十几个字节，从p起不对齐地读取一块，通常一次即可跳过；块不跨越内存页时读取是安全的，跨页时逐字节处理 */
+#define DIANA_PAGE_SIZE 4096
+#define DIANA_SIMD_IN_PAGE(p) (((uintptr_t)(p) & (DIANA_PAGE_SIZE - 1)) <= DIANA_PAGE_SIZE - DIANA_SIMD_WIDTH)
+
+/* 返回从p起第一个不是空格的位置，每块只比较一次 */
+DIANA_NO_SANITIZE_ADDRESS
+static const char *diana_skip_spaces(const char *p)
+{
+    const diana_simd space = DIANA_SIMD_SET1(' ');
+    unsigned mask;
+    while (DIANA_SIMD_IN_PAGE(p))
+    {
+        mask = ~DIANA_SIMD_MASK(DIANA_SIMD_EQ(DIANA_SIMD_LOADU(p), space)) & DIANA_SIMD_ALL_BITS;
+        if (mask != 0)
+            return p + diana_ctz(mask);
+        p += DIANA_SIMD_WIDTH;
+    }
+    while (*p == ' ')
+        p++;
+    return p;
+}
+
+/* 返回从p起第一个不是白空格的位置 */
+DIANA_NO_SANITIZE_ADDRESS
+static const char *diana_skip_whitespace(const char *p)
+{
+    const diana_simd space = DIANA_SIMD_SET1(' '), tab = DIANA_SIMD_SET1('\t'), lf = DIANA_SIMD_SET1('\n'), cr = DIANA_SIMD_SET1('\r');
+    unsigned mask;
+    while (DIANA_SIMD_IN_PAGE(p))
+    {
+        diana_simd input = DIANA_SIMD_LOADU(p);
+        diana_simd ws = DIANA_SIMD_OR(DIANA_SIMD_OR(DIANA_SIMD_EQ(input, space), DIANA_SIMD_EQ(input, tab)),
+                                      DIANA_SIMD_OR(DIANA_SIMD_EQ(input, lf), DIANA_SIMD_EQ(input, cr)));
+        mask = ~DIANA_SIMD_MASK(ws) & DIANA_SIMD_ALL_BITS;
+        if (mask != 0)
+            return p + diana_ctz(mask);
+        p += DIANA_SIMD_WIDTH;
+    }
+    while (ISWHITESPACE(*p))
+        p++;
+    return p;
+}
+#else
+static const char *diana_skip_spaces(const char *p)
+{
+    while (*p == ' ')
+        p++;
+    return p;
+}
+
+static const char *diana_skip_whitespace(const char *p)
+{
+    while (ISWHITESPACE(*p))
+        p++;
+    return p;
+}
+#endif
+
 /* 处理白空格ws */
 /* ws = *(%x20 / %x09 / %x0A / %x0D) */
+/* 缩进多为换行后接若干空格，只需比较空格；其余情况按块跳过 */
 static void diana_parse_whitespace(diana_context *c)
 {
     const char *p = c->json;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+    if (*p == ' ' && (unsigned char)p[1] > ' ') /* ", "与": " */
+    {
+        c->json = p + 1;
+        return;
+    }
+    if (*p == '\r' && p[1] == '\n')
         p++;
+    if (*p == '\n')
+        p = diana_skip_spaces(p + 1);
+    if (ISWHITESPACE(*p))
+        p = diana_skip_whitespace(p);
     c->json = p;
 }
 
+/* 紧凑文本的下一个字符通常不是白空格（白空格都不大于' '），只比较一次，不调用函数 */
+#define PARSE_WHITESPACE(c)                   \
+    do                                        \
+    {                                         \
+        if ((unsigned char)*(c)->json <= ' ') \
+            diana_parse_whitespace(c);        \
+    } while (0)
+
 /* 统一解析null/false/true */
 /* null = "null" */
 /* true = "true" */
@@ -88,7 +515,7 @@ static int diana_parse_literal(diana_context *c, diana_value *v, const char *lit
             return DIANA_PARSE_INVALID_VALUE;
     }
     c->json += i;
-    v->type = type;
+    v->tag = type;
     return DIANA_PARSE_OK;
 }
 
@@ -152,7 +579,7 @@ static int diana_parse_number(diana_context *c, diana_value *v)
     v->u.n = strtod(c->json, NULL);
     if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL))
         return DIANA_PARSE_NUMBER_TOO_BIG;
-    v->type = DIANA_NUMBER;
+    v->tag = DIANA_NUMBER;
     c->json = p;
     return DIANA_PARSE_OK;
 }
@@ -212,6 +639,200 @@ static void diana_encode_utf8(diana_context *c, unsigned u)
     }
 }
 
+#if DIANA_PARSE_VALIDATE_UTF8 && !defined(DIANA_UTF8_SIMD)
+/* 校验[p, end)为合法的UTF-8：拒绝过长编码、代理项、超出U+10FFFF的码点与截断的序列 */
+static int diana_validate_utf8(const unsigned char *p, const unsigned char *end)
+{
+    while (p < end)
+    {
+        unsigned char ch = *p, lo = 0x80, hi = 0xBF;
+        size_t n, i;
+        if (ch < 0x80)
+        {
+            p++;
+            continue;
+        }
+        if (ch >= 0xC2 && ch <= 0xDF)
+            n = 1;
+        else if (ch >= 0xE0 && ch <= 0xEF)
+            n = 2;
+        else if (ch >= 0xF0 && ch <= 0xF4)
+            n = 3;
+        else
+            return 0;
+        if ((size_t)(end - p) <= n)
+            return 0;
+        if (ch == 0xE0)
+            lo = 0xA0;
+        else if (ch == 0xED)
+            hi = 0x9F;
+        else if (ch == 0xF0)
+            lo = 0x90;
+        else if (ch == 0xF4)
+            hi = 0x8F;
+        if (p[1] < lo || p[1] > hi)
+            return 0;
+        for (i = 2; i <= n; i++)
+            if ((p[i] & 0xC0) != 0x80)
+                return 0;
+        p += n + 1;
+    }
+    return 1;
+}
+#endif
+
+/* 字符串扫描：返回从p起第一个'"'、'\\'或控制字符（含'\0'）的位置，其间的字节可以整段复制 */
+/* 开启DIANA_PARSE_VALIDATE_UTF8时同时校验这段字节，不合法时返回NULL */
+#ifdef DIANA_SIMD_WIDTH
+#ifdef DIANA_UTF8_SIMD
+/* 查表法校验UTF-8（Keiser & Lemire）：以前一字节的高、低4位与当前字节的高4位查三张表，三者相与得到两字节间的错误 */
+/* 三、四字节序列的后续字节另以前两、三字节判断，非ASCII的块与前一块相接，块尾未完成的序列留待下一块检查 */
+#define DIANA_UTF8_TOO_SHORT 0x01      /* 11______ 0_______ 或 11______ 11______ */
+#define DIANA_UTF8_TOO_LONG 0x02       /* 0_______ 10______ */
+#define DIANA_UTF8_OVERLONG_3 0x04     /* 11100000 100_____ */
+#define DIANA_UTF8_TOO_LARGE 0x08      /* 11110100 1001____ 及更大 */
+#define DIANA_UTF8_SURROGATE 0x10      /* 11101101 101_____ */
+#define DIANA_UTF8_OVERLONG_2 0x20     /* 1100000_ 10______ */
+#define DIANA_UTF8_TOO_LARGE_1000 0x40 /* 11110101 1000____ 及更大 */
+#define DIANA_UTF8_OVERLONG_4 0x40     /* 11110000 1000____ */
+#define DIANA_UTF8_TWO_CONTS 0x80      /* 10______ 10______ */
+#define DIANA_UTF8_CARRY (DIANA_UTF8_TOO_SHORT | DIANA_UTF8_TOO_LONG | DIANA_UTF8_TWO_CONTS)
+#define DIANA_UTF8_LARGE (DIANA_UTF8_CARRY | DIANA_UTF8_TOO_LARGE | DIANA_UTF8_TOO_LARGE_1000)
+
+static const unsigned char diana_utf8_byte1_high[16] = {
+    DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG,
+    DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG, DIANA_UTF8_TOO_LONG,
+    DIANA_UTF8_TWO_CONTS, DIANA_UTF8_TWO_CONTS, DIANA_UTF8_TWO_CONTS, DIANA_UTF8_TWO_CONTS,
+    DIANA_UTF8_TOO_SHORT | DIANA_UTF8_OVERLONG_2,
+    DIANA_UTF8_TOO_SHORT,
+    DIANA_UTF8_TOO_SHORT | DIANA_UTF8_OVERLONG_3 | DIANA_UTF8_SURROGATE,
+    DIANA_UTF8_TOO_SHORT | DIANA_UTF8_TOO_LARGE | DIANA_UTF8_TOO_LARGE_1000 | DIANA_UTF8_OVERLONG_4};
+static const unsigned char diana_utf8_byte1_low[16] = {
+    DIANA_UTF8_CARRY | DIANA_UTF8_OVERLONG_3 | DIANA_UTF8_OVERLONG_2 | DIANA_UTF8_OVERLONG_4,
+    DIANA_UTF8_CARRY | DIANA_UTF8_OVERLONG_2,
+    DIANA_UTF8_CARRY, DIANA_UTF8_CARRY,
+    DIANA_UTF8_CARRY | DIANA_UTF8_TOO_LARGE,
+    DIANA_UTF8_LARGE, DIANA_UTF8_LARGE, DIANA_UTF8_LARGE,
+    DIANA_UTF8_LARGE, DIANA_UTF8_LARGE, DIANA_UTF8_LARGE, DIANA_UTF8_LARGE, DIANA_UTF8_LARGE,
+    DIANA_UTF8_LARGE | DIANA_UTF8_SURROGATE,
+    DIANA_UTF8_LARGE, DIANA_UTF8_LARGE};
+static const unsigned char diana_utf8_byte2_high[16] = {
+    DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT,
+    DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT,
+    DIANA_UTF8_TOO_LONG | DIANA_UTF8_OVERLONG_2 | DIANA_UTF8_TWO_CONTS | DIANA_UTF8_OVERLONG_3 | DIANA_UTF8_TOO_LARGE_1000 | DIANA_UTF8_OVERLONG_4,
+    DIANA_UTF8_TOO_LONG | DIANA_UTF8_OVERLONG_2 | DIANA_UTF8_TWO_CONTS | DIANA_UTF8_OVERLONG_3 | DIANA_UTF8_TOO_LARGE,
+    DIANA_UTF8_TOO_LONG | DIANA_UTF8_OVERLONG_2 | DIANA_UTF8_TWO_CONTS | DIANA_UTF8_SURROGATE | DIANA_UTF8_TOO_LARGE,
+    DIANA_UTF8_TOO_LONG | DIANA_UTF8_OVERLONG_2 | DIANA_UTF8_TWO_CONTS | DIANA_UTF8_SURROGATE | DIANA_UTF8_TOO_LARGE,
+    DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT, DIANA_UTF8_TOO_SHORT};
+#endif
+
+#ifdef DIANA_UTF8_SIMD
+#if DIANA_SIMD_WIDTH == 32
+#define DIANA_SIMD_TABLE(t) _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(t)))
+#define DIANA_SIMD_LOOKUP(t, i) _mm256_shuffle_epi8(t, i)
+#define DIANA_SIMD_HIGH4(a) _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi8(0x0F))
+#define DIANA_SIMD_SUBS(a, b) _mm256_subs_epu8(a, b)
+#define DIANA_SIMD_XOR(a, b) _mm256_xor_si256(a, b)
+/* 当前块整体后移n字节，空出的位置由前一块的末尾填补 */
+#define DIANA_SIMD_PREV(input, prev, n) _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+/* 块尾的最后三个字节若是未完成序列的首字节则非零 */
+#define DIANA_SIMD_INCOMPLETE() _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, \
+                                                 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,          \
+                                                 (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1))
+#else
+#define DIANA_SIMD_TABLE(t) _mm_loadu_si128((const __m128i *)(const void *)(t))
+#define DIANA_SIMD_LOOKUP(t, i) _mm_shuffle_epi8(t, i)
+#define DIANA_SIMD_HIGH4(a) _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi8(0x0F))
+#define DIANA_SIMD_SUBS(a, b) _mm_subs_epu8(a, b)
+#define DIANA_SIMD_XOR(a, b) _mm_xor_si128(a, b)
+#define DIANA_SIMD_PREV(input, prev, n) _mm_alignr_epi8(input, prev, 16 - (n))
+#define DIANA_SIMD_INCOMPLETE() _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, \
+                                              (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1))
+#endif
+
+/* 返回input中每个字节处的错误（非零即不合法），prev为前一块 */
+static diana_simd diana_utf8_check(diana_simd input, diana_simd prev)
+{
+    diana_simd prev1 = DIANA_SIMD_PREV(input, prev, 1), low = DIANA_SIMD_SET1(0x0F);
+    diana_simd special = DIANA_SIMD_AND(DIANA_SIMD_AND(DIANA_SIMD_LOOKUP(DIANA_SIMD_TABLE(diana_utf8_byte1_high), DIANA_SIMD_HIGH4(prev1)),
+                                                       DIANA_SIMD_LOOKUP(DIANA_SIMD_TABLE(diana_utf8_byte1_low), DIANA_SIMD_AND(prev1, low))),
+                                        DIANA_SIMD_LOOKUP(DIANA_SIMD_TABLE(diana_utf8_byte2_high), DIANA_SIMD_HIGH4(input)));
+    /* 前两字节为111_____或前三字节为1111____时，当前字节必须是后续字节 */
+    diana_simd must23 = DIANA_SIMD_OR(DIANA_SIMD_SUBS(DIANA_SIMD_PREV(input, prev, 2), DIANA_SIMD_SET1(0xE0 - 0x80)),
+                                      DIANA_SIMD_SUBS(DIANA_SIMD_PREV(input, prev, 3), DIANA_SIMD_SET1(0xF0 - 0x80)));
+    return DIANA_SIMD_XOR(DIANA_SIMD_AND(must23, DIANA_SIMD_SET1(0x80)), special);
+}
+#endif
+
+DIANA_NO_SANITIZE_ADDRESS
+static const char *diana_scan_string(const char *p)
+{
+    const diana_simd quote = DIANA_SIMD_SET1('"'), backslash = DIANA_SIMD_SET1('\\'), control = DIANA_SIMD_SET1(0x1F);
+    const char *block = (const char *)((uintptr_t)p & ~(uintptr_t)(DIANA_SIMD_WIDTH - 1));
+    unsigned skip = (unsigned)(p - block), mask, end;
+#if DIANA_PARSE_VALIDATE_UTF8
+    const diana_simd index = DIANA_SIMD_INDEX();
+    diana_simd error = DIANA_SIMD_ZERO(), v;
+#ifdef DIANA_UTF8_SIMD
+    diana_simd prev = error, incomplete = error;
+#endif
+#endif
+    for (;;)
+    {
+        diana_simd input = DIANA_SIMD_LOAD(block);
+        diana_simd special = DIANA_SIMD_OR(DIANA_SIMD_OR(DIANA_SIMD_EQ(input, quote), DIANA_SIMD_EQ(input, backslash)),
+                                           DIANA_SIMD_EQ(DIANA_SIMD_MIN(input, control), input));
+        mask = DIANA_SIMD_MASK(special) >> skip << skip; /* 首块中p之前的字节不属于本段 */
+        end = mask != 0 ? diana_ctz(mask) : DIANA_SIMD_WIDTH;
+#if DIANA_PARSE_VALIDATE_UTF8
+        /* 本段以外的字节清零，视为ASCII；段前是ASCII的引号或转义，段后的零使截断的序列报错 */
+        v = DIANA_SIMD_AND(input, DIANA_SIMD_AND(DIANA_SIMD_LT(DIANA_SIMD_SET1(skip - 1), index), DIANA_SIMD_LT(index, DIANA_SIMD_SET1(end))));
+#ifdef DIANA_UTF8_SIMD
+        if (DIANA_SIMD_MASK(v) != 0)
+        {
+            error = DIANA_SIMD_OR(error, diana_utf8_check(v, prev));
+            incomplete = DIANA_SIMD_SUBS(v, DIANA_SIMD_INCOMPLETE());
+        }
+        else
+            error = DIANA_SIMD_OR(error, incomplete);
+        prev = v;
+#else
+        error = DIANA_SIMD_OR(error, v); /* 没有查表指令时只记录是否含非ASCII字节，最后逐字节校验 */
+#endif
+#endif
+        if (mask != 0)
+            break;
+        block += DIANA_SIMD_WIDTH;
+        skip = 0;
+    }
+#if DIANA_PARSE_VALIDATE_UTF8
+#ifdef DIANA_UTF8_SIMD
+    if (DIANA_SIMD_MASK(DIANA_SIMD_EQ(error, DIANA_SIMD_ZERO())) != DIANA_SIMD_ALL_BITS)
+        return NULL;
+#else
+    if (DIANA_SIMD_MASK(error) != 0 && !diana_validate_utf8((const unsigned char *)p, (const unsigned char *)block + end))
+        return NULL;
+#endif
+#endif
+    return block + end;
+}
+#else
+static const char *diana_scan_string(const char *p)
+{
+    const unsigned char *s = (const unsigned char *)p;
+    unsigned char high = 0;
+    while (*s != '"' && *s != '\\' && *s >= 0x20)
+        high |= *s++;
+#if DIANA_PARSE_VALIDATE_UTF8
+    if ((high & 0x80) != 0 && !diana_validate_utf8((const unsigned char *)p, s))
+        return NULL;
+#else
+    (void)high;
+#endif
+    return (const char *)s;
+}
+#endif
+
 /* 解析JSON字符串，把结果写入str和len */
 /* str只想c->stack中的元素 */
 static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
@@ -223,7 +844,14 @@ static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
     p = c->json;
     for (;;)
     {
-        char ch = *p++;
+        /* 整段复制不需要转义的字节 */
+        const char *run = p;
+        char ch;
+        if ((p = diana_scan_string(run)) == NULL)
+            STRING_ERROR(DIANA_PARSE_INVALID_UTF8);
+        if (p != run)
+            memcpy(diana_context_push(c, (size_t)(p - run)), run, (size_t)(p - run));
+        ch = *p++;
         switch (ch)
         {
         case '\"':
@@ -231,8 +859,10 @@ static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
             // diana_set_string(v, (const char *)diana_context_pop(c, *len), *len);
             *str = diana_context_pop(c, *len);
             c->json = p;
+            DIANA_STAT(c->stats.string_bytes += *len);
             return DIANA_PARSE_OK;
         case '\\':
+            DIANA_STAT(c->stats.escapes++);
             switch (*p++)
             {
             case '\"':
@@ -260,6 +890,7 @@ static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
                 PUTC(c, '\t');
                 break;
             case 'u':
+                DIANA_STAT(c->stats.unicode_escapes++);
                 if (!(p = diana_parse_hex4(p, &u)))
                     STRING_ERROR(DIANA_PARSE_INVALID_UNICODE_HEX);
                 /* surrogate handling */
@@ -273,6 +904,7 @@ static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
                         STRING_ERROR(DIANA_PARSE_INVALID_UNICODE_HEX);
                     if (u2 < 0xDC00 || u2 > 0xDFFF)
                         STRING_ERROR(DIANA_PARSE_INVALID_UNICODE_SURROGATE);
+                    DIANA_STAT(c->stats.escapes++; c->stats.unicode_escapes++);
                     u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
                 }
                 diana_encode_utf8(c, u);
@@ -283,10 +915,8 @@ static int diana_parse_string_raw(diana_context *c, char **str, size_t *len)
             break;
         case '\0':
             STRING_ERROR(DIANA_PARSE_MISS_QUOTATION_MARK);
-        default:
-            if ((unsigned char)ch < 0x20)
-                STRING_ERROR(DIANA_PARSE_INVALID_STRING_CHAR);
-            PUTC(c, ch);
+        default: /* diana_scan_string只停在控制字符上 */
+            STRING_ERROR(DIANA_PARSE_INVALID_STRING_CHAR);
         }
     }
 }
@@ -297,783 +927,1425 @@ static int diana_parse_string(diana_context *c, diana_value *v)
     char *s;
     size_t len;
     if ((ret = diana_parse_string_raw(c, &s, &len)) == DIANA_PARSE_OK)
-        diana_set_string(v, s, len);
+        diana_set_string_alloc(v, s, len, c->a);
     return ret;
 }
 
-static int diana_parse_value(diana_context *c, diana_value *v); /* 前向声明 */
+/* 数组与对象的解析帧，与已解析的元素（成员）一起保存在diana_context堆栈中 */
+/* 堆栈布局：[帧][元素0][元素1]...[内层帧][元素0]...，帧之间以偏移量相连（堆栈可能被realloc移动） */
+typedef struct
+{
+    size_t parent; // 外层帧的偏移，DIANA_NO_FRAME表示根
+    size_t size;   // 已解析的元素（成员）数
+    char *k;       // 对象：已解析、等待值的键
+    size_t klen;
+    diana_type type;
+} diana_frame;
+
+#define DIANA_NO_FRAME ((size_t)-1)
+#define DIANA_FRAME_SIZE ((sizeof(diana_frame) + 7) & ~(size_t)7)
+#define DIANA_FRAME(c, offset) ((diana_frame *)((c)->stack + (offset)))
+
+/* 解析对象的键及其后的冒号，键保存在帧中 */
+static int diana_parse_key(diana_context *c, size_t frame)
+{
+    char *str;
+    size_t klen;
+    int ret;
+    if (*c->json != '"')
+        return DIANA_PARSE_MISS_KEY;
+    if ((ret = diana_parse_string_raw(c, &str, &klen)) != DIANA_PARSE_OK)
+        return ret;
+    memcpy(DIANA_FRAME(c, frame)->k = (char *)diana_malloc(c->a, klen + 1), str, klen);
+    DIANA_FRAME(c, frame)->k[klen] = '\0';
+    DIANA_FRAME(c, frame)->klen = klen;
+    DIANA_STAT(c->stats.keys++);
+    /* parse ws colon ws */
+    PARSE_WHITESPACE(c);
+    if (*c->json != ':')
+        return DIANA_PARSE_MISS_COLON;
+    c->json++;
+    PARSE_WHITESPACE(c);
+    return DIANA_PARSE_OK;
+}
 
-/* 解析数组 */
-static int diana_parse_array(diana_context *c, diana_value *v)
+/* value = null / false / true / number / string / array / object */
+/* array = %x5B ws [ value *( ws %x2C ws value ) ] ws %x5D */
+/* object = %x7B ws [ member *( ws %x2C ws member ) ] ws %x7D */
+/* 以显式堆栈代替递归，嵌套深度超过DIANA_PARSE_MAX_DEPTH时返回DIANA_PARSE_DEPTH_EXCEEDED */
+static int diana_parse_value(diana_context *c, diana_value *v)
 {
-    size_t i, size = 0;
+    size_t frame = DIANA_NO_FRAME, depth = 0, i;
+    diana_frame *f;
+    diana_value e;
     int ret;
-    EXPECT(c, '[');
-    diana_parse_whitespace(c);
-    if (*c->json == ']')
-    {
-        c->json++;
-        // v->type = DIANA_ARRAY;
-        // v->u.a.size = 0;
-        // v->u.a.e = NULL;
-        diana_set_array(v, 0);
-        return DIANA_PARSE_OK;
-    }
     for (;;)
     {
-        diana_value e;
+        /* 解析一个值到e，遇到非空的数组或对象时入帧并继续解析其第一个元素 */
         diana_init(&e);
-        if ((ret = diana_parse_value(c, &e)) != DIANA_PARSE_OK)
+        switch (*c->json)
+        {
+        case 't':
+            ret = diana_parse_literal(c, &e, "true", DIANA_TRUE);
+            break;
+        case 'f':
+            ret = diana_parse_literal(c, &e, "false", DIANA_FALSE);
+            break;
+        case 'n':
+            ret = diana_parse_literal(c, &e, "null", DIANA_NULL);
+            break;
+        default:
+            ret = diana_parse_number(c, &e);
+            break;
+        case '"':
+            ret = diana_parse_string(c, &e);
+            break;
+        case '[':
+        case '{':
+            if (depth == DIANA_PARSE_MAX_DEPTH)
+            {
+                ret = DIANA_PARSE_DEPTH_EXCEEDED;
+                break;
+            }
+            DIANA_STAT(if (depth + 1 > c->stats.max_depth) c->stats.max_depth = depth + 1);
+            ret = DIANA_PARSE_OK;
+            if (*c->json++ == '[')
+            {
+                PARSE_WHITESPACE(c);
+                if (*c->json == ']') // 空数组
+                {
+                    c->json++;
+                    diana_set_array_alloc(&e, 0, c->a);
+                    break;
+                }
+                e.tag = DIANA_ARRAY;
+            }
+            else
+            {
+                PARSE_WHITESPACE(c);
+                if (*c->json == '}') // 空对象
+                {
+                    c->json++;
+                    diana_set_object_alloc(&e, 0, c->a);
+                    break;
+                }
+                e.tag = DIANA_OBJECT;
+            }
+            f = (diana_frame *)diana_context_push(c, DIANA_FRAME_SIZE);
+            f->parent = frame;
+            f->size = 0;
+            f->k = NULL;
+            f->type = DIANA_TYPE(&e);
+            frame = (size_t)((char *)f - c->stack);
+            depth++;
+            if (DIANA_TYPE(&e) == DIANA_OBJECT && (ret = diana_parse_key(c, frame)) != DIANA_PARSE_OK)
+                goto fail;
+            continue;
+        case '\0':
+            ret = DIANA_PARSE_EXPECT_VALUE;
             break;
-        memcpy(diana_context_push(c, sizeof(diana_value)), &e, sizeof(diana_value));
-        size++;
-        diana_parse_whitespace(c);
-        if (*c->json == ',')
+        }
+        if (ret != DIANA_PARSE_OK)
+            goto fail;
+
+        /* e已完成：加入当前帧；遇到右括号时出帧，生成的数组（对象）继续加入外层帧 */
+        for (;;)
         {
+            DIANA_STAT(c->stats.values[DIANA_TYPE(&e)]++);
+            if (frame == DIANA_NO_FRAME)
+            {
+                memcpy(v, &e, sizeof(diana_value));
+                return DIANA_PARSE_OK;
+            }
+            if (DIANA_FRAME(c, frame)->type == DIANA_ARRAY)
+                memcpy(diana_context_push(c, sizeof(diana_value)), &e, sizeof(diana_value));
+            else
+            {
+                diana_member *m = (diana_member *)diana_context_push(c, sizeof(diana_member));
+                f = DIANA_FRAME(c, frame);
+                m->k = f->k;
+                m->klen = f->klen;
+                memcpy(&m->v, &e, sizeof(diana_value));
+                f->k = NULL; /* ownership is transferred to member on stack */
+            }
+            f = DIANA_FRAME(c, frame);
+            f->size++;
+            /* parse ws [comma | right bracket] ws */
+            PARSE_WHITESPACE(c);
+            if (*c->json == ',')
+            {
+                c->json++;
+                PARSE_WHITESPACE(c);
+                if (f->type == DIANA_OBJECT && (ret = diana_parse_key(c, frame)) != DIANA_PARSE_OK)
+                    goto fail;
+                break;
+            }
+            if (*c->json != (f->type == DIANA_ARRAY ? ']' : '}'))
+            {
+                ret = f->type == DIANA_ARRAY ? DIANA_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : DIANA_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                goto fail;
+            }
             c->json++;
-            diana_parse_whitespace(c);
+            {
+                size_t size = f->size, parent = f->parent;
+                DIANA_STAT(if (size > c->stats.largest_container) c->stats.largest_container = size);
+                diana_init(&e);
+                if (f->type == DIANA_ARRAY)
+                {
+                    diana_set_array_alloc(&e, size, c->a);
+                    memcpy(e.u.e, diana_context_pop(c, size * sizeof(diana_value)), size * sizeof(diana_value));
+                    DIANA_SET_SIZE(&e, size);
+                }
+                else
+                {
+                    diana_set_object_alloc(&e, size, c->a);
+                    memcpy(e.u.m, diana_context_pop(c, size * sizeof(diana_member)), size * sizeof(diana_member));
+                    DIANA_SET_SIZE(&e, size);
+                    diana_object_reindex(&e, NULL, c->a);
+                }
+                diana_context_pop(c, DIANA_FRAME_SIZE);
+                frame = parent;
+                depth--;
+            }
         }
-        else if (*c->json == ']')
+    }
+
+fail:
+    /* Pop and free values (members) on the stack, frame by frame */
+    while (frame != DIANA_NO_FRAME)
+    {
+        f = DIANA_FRAME(c, frame);
+        if (f->type == DIANA_ARRAY)
         {
-            c->json++;
-            // v->type = DIANA_ARRAY;
-            // v->u.a.size = size;
-            // size *= sizeof(diana_value);
-            diana_set_array(v, size);
-            // memcpy(v->u.a.e = (diana_value *)malloc(size), diana_context_pop(c, size), size);
-            memcpy(v->u.a.e, diana_context_pop(c, size * sizeof(diana_value)), size * sizeof(diana_value));
-            v->u.a.size = size;
-            return DIANA_PARSE_OK;
+            for (i = 0; i < f->size; i++)
+                diana_free_alloc((diana_value *)diana_context_pop(c, sizeof(diana_value)), c->a);
         }
         else
         {
-            ret = DIANA_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
-            break;
+            if (f->k != NULL)
+                diana_dealloc(c->a, f->k, f->klen + 1);
+            for (i = 0; i < f->size; i++)
+            {
+                diana_member *m = (diana_member *)diana_context_pop(c, sizeof(diana_member));
+                diana_dealloc(c->a, m->k, m->klen + 1);
+                diana_free_alloc(&m->v, c->a);
+            }
         }
+        frame = f->parent;
+        diana_context_pop(c, DIANA_FRAME_SIZE);
     }
-
-    /* Pop and free values on the stack */
-    for (i = 0; i < size; i++)
-        diana_free((diana_value *)diana_context_pop(c, sizeof(diana_value)));
     return ret;
 }
 
-/* 解析对象 */
-/* object = %x7B ws [ member *( ws %x2C ws member ) ] ws %x7D */
-static int diana_parse_object(diana_context *c, diana_value *v)
+/* 格式：JSON-text = ws value ws */
+/* 递归下降解析器，堆栈由调用方提供，返回时c->top归零但保留容量 */
+static int diana_parse_root(diana_context *c, diana_value *v, const char *json, const diana_allocator *a)
 {
-    size_t i, size;
-    diana_member m;
     int ret;
-    EXPECT(c, '{');
-    diana_parse_whitespace(c);
-    if (*c->json == '}') // 空对象
-    {
-        c->json++;
-        // v->type = DIANA_OBJECT;
-        // v->u.o.m = 0;
-        // v->u.o.size = 0;
-        diana_set_object(v, 0);
-        return DIANA_PARSE_OK;
-    }
-    m.k = NULL;
-    size = 0;
-    for (;;)
+#if DIANA_PARSE_STATS
+    clock_t start = clock();
+    memset(&c->stats, 0, sizeof(diana_parse_stats));
+#endif
+    assert(v != NULL);
+    c->json = json;
+    c->a = DIANA_ALLOCATOR(a);
+    c->top = 0;
+    diana_init(v);
+    PARSE_WHITESPACE(c);
+    if ((ret = diana_parse_value(c, v)) == DIANA_PARSE_OK)
     {
-        char *str;
-        diana_init(&m.v);
-        /* parse key to m.k, m.klen */
-        if (*c->json != '"')
+        PARSE_WHITESPACE(c); // 检测第三部分
+        if (*c->json != '\0')
         {
-            ret = DIANA_PARSE_MISS_KEY;
-            break;
-        }
-        if ((ret = diana_parse_string_raw(c, &str, &m.klen)) != DIANA_PARSE_OK)
-            break;
-        memcpy(m.k = (char *)malloc(m.klen + 1), str, m.klen);
-        m.k[m.klen] = '\0';
-        /* parse ws colon ws */
-        diana_parse_whitespace(c);
-        if (*c->json != ':')
-        {
-            ret = DIANA_PARSE_MISS_COLON;
-            break;
+            diana_free_alloc(v, c->a);
+            ret = DIANA_PARSE_ROOT_NOT_SINGULAR;
         }
-        c->json++;
-        diana_parse_whitespace(c);
-        /* parse value */
-        if ((ret = diana_parse_value(c, &m.v)) != DIANA_PARSE_OK)
-            break;
-        memcpy(diana_context_push(c, sizeof(diana_member)), &m, sizeof(diana_member));
-        size++;
-        m.k = NULL; /* ownership is transferred to member on stack */
-        /* parse ws [comma | right-curly-brace] ws */
-        diana_parse_whitespace(c);
-        if (*c->json == ',')
-        {
-            c->json++;
-            diana_parse_whitespace(c);
-        }
-        else if (*c->json == '}')
-        {
-            // size_t s = sizeof(diana_member) * size;
-            c->json++;
-            // v->type = DIANA_OBJECT;
-            // v->u.o.size = size;
-            diana_set_object(v, size);
-            // memcpy(v->u.o.m = (diana_member *)malloc(s), diana_context_pop(c, s), s);
-            memcpy(v->u.o.m, diana_context_pop(c, sizeof(diana_member) * size), sizeof(diana_member) * size);
-            v->u.o.size = size;
-            return DIANA_PARSE_OK;
-        }
-        else
-        {
-            ret = DIANA_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
-            break;
-        }
-    }
-    /* Pop and free members on the stack */
-    free(m.k);
-    for (i = 0; i < size; i++)
-    {
-        diana_member *m = (diana_member *)diana_context_pop(c, sizeof(diana_member));
-        free(m->k);
-        diana_free(&m->v);
     }
-    v->type = DIANA_NULL;
+    assert(c->top == 0);
+#if DIANA_PARSE_STATS
+    c->stats.bytes = (size_t)(c->json - json);
+    c->stats.seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+#endif
     return ret;
 }
 
-/* value = null / false / true / number / string / array */
-static int diana_parse_value(diana_context *c, diana_value *v)
+int diana_parse(diana_value *v, const char *json)
 {
-    switch (*c->json)
-    {
-    case 't':
-        return diana_parse_literal(c, v, "true", DIANA_TRUE);
-    case 'f':
-        return diana_parse_literal(c, v, "false", DIANA_FALSE);
-    case 'n':
-        return diana_parse_literal(c, v, "null", DIANA_NULL);
-    default:
-        return diana_parse_number(c, v);
-    case '"':
-        return diana_parse_string(c, v);
-    case '[':
-        return diana_parse_array(c, v);
-    case '{':
-        return diana_parse_object(c, v);
-    case '\0':
-        return DIANA_PARSE_EXPECT_VALUE;
-    }
+    return diana_parse_alloc(v, json, NULL);
 }
 
-/* 格式：JSON-text = ws value ws */
-/* 递归下降解析器 */
-int diana_parse(diana_value *v, const char *json)
+int diana_parse_alloc(diana_value *v, const char *json, const diana_allocator *a)
 {
     diana_context c;
     int ret;
-    assert(v != NULL);
-    c.json = json;
     /* 初始化堆栈 */
     c.stack = NULL;
     c.size = c.top = 0;
-    diana_init(v);
-    diana_parse_whitespace(&c);
-    if ((ret = diana_parse_value(&c, v)) == DIANA_PARSE_OK)
-    {
-        diana_parse_whitespace(&c); // 检测第三部分
-        if (*c.json != '\0')
-        {
-            v->type = DIANA_NULL;
-            ret = DIANA_PARSE_ROOT_NOT_SINGULAR;
-        }
-    }
-    assert(c.top == 0);
+    ret = diana_parse_root(&c, v, json, a);
+    free(c.stack);
+    return ret;
+}
+
+#if DIANA_PARSE_STATS
+int diana_parse_alloc_stats(diana_value *v, const char *json, const diana_allocator *a, diana_parse_stats *stats)
+{
+    diana_context c;
+    int ret;
+    assert(stats != NULL);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    ret = diana_parse_root(&c, v, json, a);
     free(c.stack);
+    *stats = c.stats;
     return ret;
 }
+#endif
+
+/* 可复用的解析器/生成器，持有堆栈并在多次调用之间保留其容量 */
+struct diana_parser
+{
+    diana_context c;
+};
+
+struct diana_writer
+{
+    diana_context c;
+};
+
+diana_parser *diana_parser_create(void)
+{
+    diana_parser *p = (diana_parser *)malloc(sizeof(diana_parser));
+    p->c.stack = NULL;
+    p->c.size = p->c.top = 0;
+#if DIANA_PARSE_STATS
+    memset(&p->c.stats, 0, sizeof(diana_parse_stats));
+#endif
+    return p;
+}
+
+void diana_parser_destroy(diana_parser *p)
+{
+    if (p == NULL)
+        return;
+    free(p->c.stack);
+    free(p);
+}
+
+void diana_parser_reset(diana_parser *p)
+{
+    assert(p != NULL);
+    free(p->c.stack);
+    p->c.stack = NULL;
+    p->c.size = p->c.top = 0;
+}
+
+int diana_parse_with(diana_parser *p, diana_value *v, const char *json)
+{
+    return diana_parse_with_alloc(p, v, json, NULL);
+}
+
+int diana_parse_with_alloc(diana_parser *p, diana_value *v, const char *json, const diana_allocator *a)
+{
+    assert(p != NULL);
+    return diana_parse_root(&p->c, v, json, a);
+}
+
+#if DIANA_PARSE_STATS
+const diana_parse_stats *diana_parser_stats(const diana_parser *p)
+{
+    assert(p != NULL);
+    return &p->c.stats;
+}
+#endif
 
 void diana_free(diana_value *v)
 {
+    diana_free_alloc(v, NULL);
+}
+
+/* 短字符串不占用堆内存，共享的字符串只减少引用计数 */
+static void diana_free_string(diana_value *v, const diana_allocator *a)
+{
+    if (!DIANA_IS_SHORT(DIANA_SIZE(v)) && --*DIANA_STRING_REFS(v) == 0)
+        diana_dealloc(a, DIANA_STRING_REFS(v), DIANA_STRING_BYTES(DIANA_SIZE(v)));
+}
+
+/* 减少数组（对象）堆块的引用计数，返回是否应当释放 */
+static int diana_release_container(const diana_value *v)
+{
+    return v->u.e == NULL || --DIANA_HEADER(v->u.e)->refs == 0;
+}
+
+/* 释放子节点：字符串直接释放，非空的数组与对象压入堆栈稍后处理 */
+static void diana_free_child(diana_context *c, diana_value *v, const diana_allocator *a)
+{
+    if (DIANA_TYPE(v) == DIANA_STRING)
+        diana_free_string(v, a);
+    else if (DIANA_TYPE(v) == DIANA_ARRAY || DIANA_TYPE(v) == DIANA_OBJECT)
+        memcpy(diana_context_push(c, sizeof(diana_value)), v, sizeof(diana_value));
+}
+
+/* 以显式堆栈代替递归，只有嵌套的数组与对象才会占用堆栈 */
+void diana_free_alloc(diana_value *v, const diana_allocator *a)
+{
+    diana_context c;
+    diana_value x;
     size_t i;
     assert(v != NULL);
-    switch (v->type)
+    a = DIANA_ALLOCATOR(a);
+    if (a->free == NULL) // 分配器不逐个释放（如arena），无需遍历子节点
     {
-    case DIANA_STRING:
-        free(v->u.s.s);
-        break;
-    case DIANA_ARRAY:
-        for (i = 0; i < v->u.a.size; ++i)
-            diana_free(&v->u.a.e[i]);
-        free(v->u.a.e);
-        break;
-    case DIANA_OBJECT:
-        for (i = 0; i < v->u.o.size; i++)
+        v->tag = DIANA_NULL;
+        return;
+    }
+    c.stack = NULL;
+    c.size = c.top = 0;
+    memcpy(&x, v, sizeof(diana_value));
+    v->tag = DIANA_NULL; // 类型置为null，避免重复释放
+    for (;;)
+    {
+        switch (DIANA_TYPE(&x))
         {
-            free(v->u.o.m[i].k);
-            v->u.o.m[i].klen = 0;
-            diana_free(&v->u.o.m[i].v);
+        case DIANA_STRING:
+            diana_free_string(&x, a);
+            break;
+        case DIANA_ARRAY:
+            if (!diana_release_container(&x))
+                break;
+            for (i = 0; i < DIANA_SIZE(&x); ++i)
+                diana_free_child(&c, &x.u.e[i], a);
+            diana_container_resize(x.u.e, sizeof(diana_value), 0, a);
+            break;
+        case DIANA_OBJECT:
+            if (!diana_release_container(&x))
+                break;
+            for (i = 0; i < DIANA_SIZE(&x); i++)
+            {
+                diana_dealloc(a, x.u.m[i].k, x.u.m[i].klen + 1);
+                diana_free_child(&c, &x.u.m[i].v, a);
+            }
+            diana_container_resize(x.u.m, sizeof(diana_member), 0, a); // 连同索引一起释放
+            break;
+        default:
+            break;
         }
-        free(v->u.o.m);
-        break;
-    default:
-        break;
+        if (c.top == 0)
+            break;
+        memcpy(&x, diana_context_pop(&c, sizeof(diana_value)), sizeof(diana_value));
     }
-    v->type = DIANA_NULL; // 类型置为null，避免重复释放
+    free(c.stack);
 }
 
 diana_type diana_get_type(const diana_value *v)
 {
     assert(v != NULL);
-    return v->type;
+    return DIANA_TYPE(v);
 }
 
 int diana_get_boolean(const diana_value *v)
 {
-    assert(v != NULL && (v->type == DIANA_TRUE || v->type == DIANA_FALSE));
-    return v->type == DIANA_TRUE ? 1 : 0;
+    assert(v != NULL && (DIANA_TYPE(v) == DIANA_TRUE || DIANA_TYPE(v) == DIANA_FALSE));
+    return DIANA_TYPE(v) == DIANA_TRUE ? 1 : 0;
 }
 
 void diana_set_boolean(diana_value *v, int b)
 {
-    diana_free(v);
-    v->type = (b == 1 ? DIANA_TRUE : DIANA_FALSE);
+    diana_set_boolean_alloc(v, b, NULL);
+}
+
+void diana_set_boolean_alloc(diana_value *v, int b, const diana_allocator *a)
+{
+    diana_free_alloc(v, a);
+    v->tag = (b == 1 ? DIANA_TRUE : DIANA_FALSE);
 }
 
 double diana_get_number(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_NUMBER);
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_NUMBER);
     return v->u.n;
 }
 
 void diana_set_number(diana_value *v, double n)
 {
-    diana_free(v);
+    diana_set_number_alloc(v, n, NULL);
+}
+
+void diana_set_number_alloc(diana_value *v, double n, const diana_allocator *a)
+{
+    diana_free_alloc(v, a);
     v->u.n = n;
-    v->type = DIANA_NUMBER;
+    v->tag = DIANA_NUMBER;
 }
 const char *diana_get_string(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_STRING);
-    return v->u.s.s;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_STRING);
+    return DIANA_STRING_DATA(v);
 }
 size_t diana_get_string_length(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_STRING);
-    return v->u.s.len;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_STRING);
+    return DIANA_SIZE(v);
 }
 
 void diana_set_string(diana_value *v, const char *s, size_t len)
+{
+    diana_set_string_alloc(v, s, len, NULL);
+}
+
+void diana_set_string_alloc(diana_value *v, const char *s, size_t len, const diana_allocator *a)
 {
     assert(v != NULL && (s != NULL || len == 0)); // 非空指针或者零长度的字符串都是合法的
-    diana_free(v);                                // 首先清空v可能分配到的内存
-    v->u.s.s = (char *)malloc(len + 1);           // 分配字符串内存
-    memcpy(v->u.s.s, s, len);
-    v->u.s.s[len] = '\0';
-    v->u.s.len = len;
-    v->type = DIANA_STRING;
+    a = DIANA_ALLOCATOR(a);
+    diana_free_alloc(v, a); // 首先清空v可能分配到的内存
+    v->tag = DIANA_TAG(DIANA_STRING, len);
+    if (!DIANA_IS_SHORT(len)) // 分配字符串内存（含引用计数），短字符串直接存放在值内
+    {
+        v->u.s = (char *)diana_malloc(a, DIANA_STRING_BYTES(len)) + sizeof(size_t);
+        *DIANA_STRING_REFS(v) = 1;
+    }
+    if (len > 0)
+        memcpy(DIANA_STRING_DATA(v), s, len);
+    DIANA_STRING_DATA(v)[len] = '\0';
 }
 
 void diana_set_array(diana_value *v, size_t capacity)
+{
+    diana_set_array_alloc(v, capacity, NULL);
+}
+
+void diana_set_array_alloc(diana_value *v, size_t capacity, const diana_allocator *a)
 {
     assert(v != NULL);
-    diana_free(v);
-    v->type = DIANA_ARRAY;
-    v->u.a.size = 0;
-    v->u.a.capacity = capacity;
-    v->u.a.e = capacity > 0 ? (diana_value *)malloc(capacity * sizeof(diana_value)) : NULL;
+    a = DIANA_ALLOCATOR(a);
+    diana_free_alloc(v, a);
+    v->tag = DIANA_ARRAY;
+    v->u.e = (diana_value *)diana_container_resize(NULL, sizeof(diana_value), capacity, a);
 }
 
 void diana_reserve_array(diana_value *v, size_t capacity)
 {
-    if (v == NULL)
-        printf("v is null!\n");
-    if (v->type != DIANA_ARRAY)
-        printf("v->type != DIANA_ARRAY!\n");
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    if (v->u.a.capacity < capacity)
-    {
-        v->u.a.capacity = capacity;
-        v->u.a.e = (diana_value *)realloc(v->u.a.e, capacity * sizeof(diana_value));
-    }
+    diana_reserve_array_alloc(v, capacity, NULL);
+}
+
+void diana_reserve_array_alloc(diana_value *v, size_t capacity, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    diana_unshare_alloc(v, a);
+    if (DIANA_CAPACITY(v) < capacity)
+        v->u.e = (diana_value *)diana_container_resize(v->u.e, sizeof(diana_value), capacity, DIANA_ALLOCATOR(a));
 }
 
 void diana_shrink_array(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    if (v->u.a.capacity > v->u.a.size)
-    {
-        v->u.a.capacity = v->u.a.size;
-        v->u.a.e = (diana_value *)realloc(v->u.a.e, v->u.a.size * sizeof(diana_value));
-    }
+    diana_shrink_array_alloc(v, NULL);
+}
+
+void diana_shrink_array_alloc(diana_value *v, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    diana_unshare_alloc(v, a);
+    if (DIANA_CAPACITY(v) > DIANA_SIZE(v))
+        v->u.e = (diana_value *)diana_container_resize(v->u.e, sizeof(diana_value), DIANA_SIZE(v), DIANA_ALLOCATOR(a));
 }
 
 size_t diana_get_array_capacity(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    return v->u.a.capacity;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    return DIANA_CAPACITY(v);
 }
 
 size_t diana_get_array_size(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    return v->u.a.size;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    return DIANA_SIZE(v);
 }
 
 diana_value *diana_get_array_element(const diana_value *v, size_t index)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    assert(index < v->u.a.size);
-    return &v->u.a.e[index];
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    assert(index < DIANA_SIZE(v));
+    return &v->u.e[index];
 }
 
 diana_value *diana_pushback_array_element(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    if (v->u.a.size == v->u.a.capacity)
-        diana_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
-    diana_init(&v->u.a.e[v->u.a.size]);
-    return &v->u.a.e[v->u.a.size++];
+    return diana_pushback_array_element_alloc(v, NULL);
 }
 
-void diana_popback_array_element(diana_value *v)
+diana_value *diana_pushback_array_element_alloc(diana_value *v, const diana_allocator *a)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY && v->u.a.size > 0);
-    diana_free(&v->u.a.e[--v->u.a.size]);
+    size_t size;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    diana_unshare_alloc(v, a);
+    if ((size = DIANA_SIZE(v)) == DIANA_CAPACITY(v))
+        diana_reserve_array_alloc(v, size == 0 ? 1 : size * 2, a);
+    diana_init(&v->u.e[size]);
+    DIANA_SET_SIZE(v, size + 1);
+    return &v->u.e[size];
 }
 
-diana_value *diana_insert_array_element(diana_value *v, size_t index)
+void diana_popback_array_element(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY && index <= v->u.a.size);
+    diana_popback_array_element_alloc(v, NULL);
+}
 
-    if (v->u.a.size + 1 >= v->u.a.capacity) // 检测是否插入一个元素会导致超容
-        diana_reserve_array(v, v->u.a.capacity * 2);
+void diana_popback_array_element_alloc(diana_value *v, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY && DIANA_SIZE(v) > 0);
+    diana_unshare_alloc(v, a);
+    DIANA_SET_SIZE(v, DIANA_SIZE(v) - 1);
+    diana_free_alloc(&v->u.e[DIANA_SIZE(v)], a);
+}
 
-    if (index == v->u.a.size) // 插入末尾
-        return diana_pushback_array_element(v);
+diana_value *diana_insert_array_element(diana_value *v, size_t index)
+{
+    return diana_insert_array_element_alloc(v, index, NULL);
+}
 
-    // 插入数组中间
+diana_value *diana_insert_array_element_alloc(diana_value *v, size_t index, const diana_allocator *a)
+{
+    size_t size;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY && index <= DIANA_SIZE(v));
+    diana_unshare_alloc(v, a);
+    if ((size = DIANA_SIZE(v)) == DIANA_CAPACITY(v)) // 检测是否插入一个元素会导致超容
+        diana_reserve_array_alloc(v, size == 0 ? 1 : size * 2, a);
     // 0 1 2 3 4
     // 0 1 2 5 3 4
-    diana_value *temp = (diana_value *)malloc(sizeof(diana_value) * (v->u.a.size - index));
-    memcpy(temp, v->u.a.e + index, sizeof(diana_value) * (v->u.a.size - index));
-    memcpy(v->u.a.e + index + 1, temp, sizeof(diana_value) * (v->u.a.size - index));
-    v->u.a.size++;
-    diana_free(&v->u.a.e[index]);
-    diana_init(&v->u.a.e[index]);
-    free(temp);
-    return &v->u.a.e[index];
-
-    return NULL;
+    memmove(v->u.e + index + 1, v->u.e + index, (size - index) * sizeof(diana_value));
+    DIANA_SET_SIZE(v, size + 1);
+    diana_init(&v->u.e[index]);
+    return &v->u.e[index];
 }
 
 void diana_erase_array_element(diana_value *v, size_t index, size_t count)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY && index + count <= v->u.a.size);
-    size_t i, tmp;
-    tmp = index;
-    for (i = 0; i < count; i++)
-    {
-        diana_free(&v->u.a.e[tmp++]);
-    }
-    // Move
-    if (index + count < v->u.a.size)
-    {
-        diana_value *temp = (diana_value *)malloc(sizeof(diana_value) * (v->u.a.size - index - count));
-        memcpy(temp, v->u.a.e + index + count, sizeof(diana_value) * (v->u.a.size - index - count));
-        memcpy(v->u.a.e + index, temp, sizeof(diana_value) * (v->u.a.size - index - count));
-        free(temp);
+    diana_erase_array_element_alloc(v, index, count, NULL);
+}
 
-        // TODO diana_init移动后多余的节点
-        // 0 1 2 3 4 5
-        // 0 1 4 5 E E
-    }
+void diana_erase_array_element_alloc(diana_value *v, size_t index, size_t count, const diana_allocator *a)
+{
+    size_t i;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY && index + count <= DIANA_SIZE(v));
+    diana_unshare_alloc(v, a);
+    for (i = index; i < index + count; i++)
+        diana_free_alloc(&v->u.e[i], a);
+    // 0 1 2 3 4 5
+    // 0 1 4 5
+    memmove(v->u.e + index, v->u.e + index + count, (DIANA_SIZE(v) - index - count) * sizeof(diana_value));
+    DIANA_SET_SIZE(v, DIANA_SIZE(v) - count);
+}
+
+void diana_swap_remove_array_element(diana_value *v, size_t index)
+{
+    diana_swap_remove_array_element_alloc(v, index, NULL);
+}
+
+void diana_swap_remove_array_element_alloc(diana_value *v, size_t index, const diana_allocator *a)
+{
+    size_t last;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY && index < DIANA_SIZE(v));
+    diana_unshare_alloc(v, a);
+    diana_free_alloc(&v->u.e[index], a);
+    if (index != (last = DIANA_SIZE(v) - 1))
+        memcpy(&v->u.e[index], &v->u.e[last], sizeof(diana_value));
+    DIANA_SET_SIZE(v, last);
+}
 
-    v->u.a.size -= count;
+void diana_append_array_elements(diana_value *v, diana_value *values, size_t count)
+{
+    diana_append_array_elements_alloc(v, values, count, NULL);
+}
+
+void diana_append_array_elements_alloc(diana_value *v, diana_value *values, size_t count, const diana_allocator *a)
+{
+    size_t i, size;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY && (values != NULL || count == 0));
+    diana_unshare_alloc(v, a);
+    size = DIANA_SIZE(v);
+    if (size + count > DIANA_CAPACITY(v))
+        diana_reserve_array_alloc(v, size + count > DIANA_CAPACITY(v) * 2 ? size + count : DIANA_CAPACITY(v) * 2, a);
+    if (count > 0)
+        memcpy(v->u.e + size, values, count * sizeof(diana_value));
+    DIANA_SET_SIZE(v, size + count);
+    for (i = 0; i < count; i++)
+        diana_init(&values[i]);
 }
+
 void diana_clear_array(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_ARRAY);
-    diana_erase_array_element(v, 0, v->u.a.size);
+    diana_clear_array_alloc(v, NULL);
+}
+
+void diana_clear_array_alloc(diana_value *v, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_ARRAY);
+    diana_erase_array_element_alloc(v, 0, DIANA_SIZE(v), a);
 }
 
 void diana_set_object(diana_value *v, size_t capacity)
+{
+    diana_set_object_alloc(v, capacity, NULL);
+}
+
+void diana_set_object_alloc(diana_value *v, size_t capacity, const diana_allocator *a)
 {
     assert(v != NULL);
-    diana_free(v);
-    v->type = DIANA_OBJECT;
-    v->u.o.size = 0;
-    v->u.o.capacity = capacity;
-    v->u.o.m = capacity > 0 ? (diana_member *)malloc(capacity * sizeof(diana_member)) : NULL;
+    a = DIANA_ALLOCATOR(a);
+    diana_free_alloc(v, a);
+    v->tag = DIANA_OBJECT;
+    v->u.m = (diana_member *)diana_container_resize(NULL, sizeof(diana_member), capacity, a);
 }
 
 size_t diana_get_object_size(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    return v->u.o.size;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    return DIANA_SIZE(v);
 }
 
 size_t diana_get_object_capacity(const diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    return v->u.o.capacity;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    return DIANA_CAPACITY(v);
 }
 
 void diana_reserve_object(diana_value *v, size_t capacity)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
+    diana_reserve_object_alloc(v, capacity, NULL);
+}
+
+void diana_reserve_object_alloc(diana_value *v, size_t capacity, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    diana_unshare_alloc(v, a);
     /* TODO */
-    if (v->u.o.capacity < capacity)
+    if (DIANA_CAPACITY(v) < capacity)
     {
-        v->u.o.capacity = capacity;
-        v->u.o.m = (diana_member *)realloc(v->u.o.m, capacity * sizeof(diana_member));
+        a = DIANA_ALLOCATOR(a);
+        v->u.m = (diana_member *)diana_container_resize(v->u.m, sizeof(diana_member), capacity, a);
+        if (DIANA_INDEX(v) != NULL) // 保持槽数不小于容量的两倍
+            diana_object_reindex(v, DIANA_INDEX(v), a);
     }
 }
 
 void diana_shrink_object(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
+    diana_shrink_object_alloc(v, NULL);
+}
+
+void diana_shrink_object_alloc(diana_value *v, const diana_allocator *a)
+{
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    diana_unshare_alloc(v, a);
     /* TODO */
-    if (v->u.o.capacity > v->u.o.size)
+    if (DIANA_CAPACITY(v) > DIANA_SIZE(v))
     {
-        v->u.o.capacity = v->u.o.size;
-        v->u.o.m = (diana_member *)realloc(v->u.o.m, v->u.o.size * sizeof(diana_member));
+        a = DIANA_ALLOCATOR(a);
+        v->u.m = (diana_member *)diana_container_resize(v->u.m, sizeof(diana_member), DIANA_SIZE(v), a);
+        diana_object_reindex(v, DIANA_INDEX(v), a);
     }
 }
 
 void diana_clear_object(diana_value *v)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    /* TODO */
+    diana_clear_object_alloc(v, NULL);
+}
+
+void diana_clear_object_alloc(diana_value *v, const diana_allocator *a)
+{
     size_t i;
-    for (i = 0; i < v->u.o.size; i++)
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    diana_unshare_alloc(v, a);
+    /* TODO */
+    a = DIANA_ALLOCATOR(a);
+    for (i = 0; i < DIANA_SIZE(v); i++)
     {
         // key and value
-        free(v->u.o.m[i].k);
-        v->u.o.m[i].klen = 0;
-        diana_free(&v->u.o.m[i].v);
+        diana_dealloc(a, v->u.m[i].k, v->u.m[i].klen + 1);
+        v->u.m[i].klen = 0;
+        diana_free_alloc(&v->u.m[i].v, a);
     }
-    v->u.o.size = 0;
+    DIANA_SET_SIZE(v, 0);
+    if (DIANA_INDEX(v) != NULL) // 保留索引的内存
+        memset(DIANA_INDEX(v)->slots, 0, (DIANA_INDEX(v)->mask + 1) * sizeof(diana_slot));
 }
 
 const char *diana_get_object_key(const diana_value *v, size_t index)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].k;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    assert(index < DIANA_SIZE(v));
+    return v->u.m[index].k;
 }
 
 size_t diana_get_object_key_length(const diana_value *v, size_t index)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].klen;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    assert(index < DIANA_SIZE(v));
+    return v->u.m[index].klen;
 }
 
 diana_value *diana_get_object_value(const diana_value *v, size_t index)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT);
-    assert(index < v->u.o.size);
-    return &v->u.o.m[index].v;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    assert(index < DIANA_SIZE(v));
+    return &v->u.m[index].v;
 }
 
 size_t diana_find_object_index(const diana_value *v, const char *key, size_t klen)
 {
-    size_t i;
-    assert(v != NULL && v->type == DIANA_OBJECT && key != NULL);
-    for (i = 0; i < v->u.o.size; i++)
-    {
-        if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0)
-            return i;
-    }
-    return DIANA_KEY_NOT_EXIST;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT && key != NULL);
+    return diana_object_lookup(v, key, klen, DIANA_OBJECT_HASH(v, key, klen));
 }
 
 diana_value *diana_find_object_value(diana_value *v, const char *key, size_t klen)
+{
+    return diana_find_object_value_alloc(v, key, klen, NULL);
+}
+
+diana_value *diana_find_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a)
 {
     size_t index = diana_find_object_index(v, key, klen);
-    return index != DIANA_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+    if (index == DIANA_KEY_NOT_EXIST)
+        return NULL;
+    diana_unshare_alloc(v, a); // 返回的指针可被写入
+    return &v->u.m[index].v;
 }
 
 diana_value *diana_set_object_value(diana_value *v, const char *key, size_t klen)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT && key != NULL);
-    /* TODO */
+    return diana_set_object_value_alloc(v, key, klen, NULL);
+}
+
+diana_value *diana_set_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a)
+{
+    size_t hash, index;
+    char *k;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT && key != NULL);
+    diana_unshare_alloc(v, a);
     // 先搜寻是否存在该键
-    size_t index = diana_find_object_index(v, key, klen);
-    if (index != DIANA_KEY_NOT_EXIST)
-    {
-        // 键存在
-        // diana_copy(diana_get_object_value(v, index), value);
+    hash = DIANA_OBJECT_HASH(v, key, klen);
+    index = diana_object_lookup(v, key, klen, hash);
+    if (index != DIANA_KEY_NOT_EXIST) // 键存在
         return diana_get_object_value(v, index);
-    }
-    else
-    {
-        // 键不存在，插入新键
-        printf("New key:%s, klen=%zu\n", key, klen);
-
-        if (v->u.o.size == v->u.o.capacity) // 先判断是否需要扩容
-            diana_reserve_object(v, v->u.o.capacity == 0 ? 1 : v->u.o.capacity * 2);
-        // key and value
-        memcpy(v->u.o.m[v->u.o.size].k = (char *)malloc(klen + 1), key, klen);
-        v->u.o.m[v->u.o.size].k[klen] = '\0';
-        v->u.o.m[v->u.o.size].klen = klen;
-
-        diana_init(&v->u.o.m[v->u.o.size].v);
-
-        return &v->u.o.m[v->u.o.size++].v;
-    }
+    // 键不存在，插入新键
+    a = DIANA_ALLOCATOR(a);
+    memcpy(k = (char *)diana_malloc(a, klen + 1), key, klen);
+    k[klen] = '\0';
+    return diana_object_append(v, k, klen, hash, a);
 }
 
 void diana_remove_object_value(diana_value *v, size_t index)
 {
-    assert(v != NULL && v->type == DIANA_OBJECT && index < v->u.o.size);
-    /* TODO */
+    diana_erase_object_value_alloc(v, index, 1, NULL);
+}
 
-    // key and value
-    free(v->u.o.m[index].k);
-    v->u.o.m[index].klen = 0;
-    diana_free(&v->u.o.m[index].v);
+void diana_remove_object_value_alloc(diana_value *v, size_t index, const diana_allocator *a)
+{
+    diana_erase_object_value_alloc(v, index, 1, a);
+}
+
+void diana_erase_object_value(diana_value *v, size_t index, size_t count)
+{
+    diana_erase_object_value_alloc(v, index, count, NULL);
+}
 
-    // move
+void diana_erase_object_value_alloc(diana_value *v, size_t index, size_t count, const diana_allocator *a)
+{
+    diana_object_index *idx;
+    size_t i;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT && index + count <= DIANA_SIZE(v));
+    diana_unshare_alloc(v, a);
+    a = DIANA_ALLOCATOR(a);
+    if ((idx = DIANA_INDEX(v)) != NULL)
+    {
+        // 索引：删除这些成员的槽，其后成员的下标减count
+        for (i = index; i < index + count; i++)
+            diana_index_erase(idx, diana_hash_key(v->u.m[i].k, v->u.m[i].klen), i);
+        for (i = 0; i <= idx->mask; i++)
+            if (idx->slots[i].pos > index + count)
+                idx->slots[i].pos -= count;
+    }
+    for (i = index; i < index + count; i++)
+    {
+        diana_dealloc(a, v->u.m[i].k, v->u.m[i].klen + 1);
+        diana_free_alloc(&v->u.m[i].v, a);
+    }
     // 0 1 2 3 4
     // 0 1 3 4
-    size_t i, tmp;
-    tmp = index;
-    for (i = 0; i < v->u.o.size - index - 1; i++)
+    memmove(v->u.m + index, v->u.m + index + count, (DIANA_SIZE(v) - index - count) * sizeof(diana_member));
+    DIANA_SET_SIZE(v, DIANA_SIZE(v) - count);
+}
+
+void diana_swap_remove_object_value(diana_value *v, size_t index)
+{
+    diana_swap_remove_object_value_alloc(v, index, NULL);
+}
+
+void diana_swap_remove_object_value_alloc(diana_value *v, size_t index, const diana_allocator *a)
+{
+    diana_object_index *idx;
+    size_t last;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT && index < DIANA_SIZE(v));
+    diana_unshare_alloc(v, a);
+    a = DIANA_ALLOCATOR(a);
+    last = DIANA_SIZE(v) - 1;
+    if ((idx = DIANA_INDEX(v)) != NULL)
     {
-        // key and value
-        if (v->u.o.m[tmp].k == NULL)
-            v->u.o.m[tmp].k = (char *)malloc(v->u.o.m[tmp + 1].klen);
-        memcpy(v->u.o.m[tmp].k, v->u.o.m[tmp + 1].k, v->u.o.m[tmp + 1].klen);
-        v->u.o.m[tmp].klen = v->u.o.m[tmp + 1].klen;
-        diana_move(&v->u.o.m[tmp].v, &v->u.o.m[tmp + 1].v);
-        tmp++;
+        diana_index_erase(idx, diana_hash_key(v->u.m[index].k, v->u.m[index].klen), index);
+        if (index != last) // 末尾成员的槽改为指向index
+        {
+            size_t hash = diana_hash_key(v->u.m[last].k, v->u.m[last].klen), i;
+            for (i = hash & idx->mask; idx->slots[i].pos != last + 1; i = (i + 1) & idx->mask)
+                ;
+            idx->slots[i].pos = index + 1;
+        }
     }
+    diana_dealloc(a, v->u.m[index].k, v->u.m[index].klen + 1);
+    diana_free_alloc(&v->u.m[index].v, a);
+    if (index != last)
+        memcpy(&v->u.m[index], &v->u.m[last], sizeof(diana_member));
+    DIANA_SET_SIZE(v, last);
+}
 
-    v->u.o.size--;
+diana_value *diana_append_object_value(diana_value *v, const char *key, size_t klen)
+{
+    return diana_append_object_value_alloc(v, key, klen, NULL);
 }
 
-int diana_is_equal(const diana_value *lhs, const diana_value *rhs)
+diana_value *diana_append_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a)
+{
+    char *k;
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT && key != NULL);
+    diana_unshare_alloc(v, a);
+    a = DIANA_ALLOCATOR(a);
+    memcpy(k = (char *)diana_malloc(a, klen + 1), key, klen);
+    k[klen] = '\0';
+    return diana_object_append(v, k, klen, DIANA_OBJECT_HASH(v, key, klen), a);
+}
+
+size_t diana_check_object_keys(const diana_value *v)
 {
     size_t i;
-    assert(lhs != NULL && rhs != NULL);
-    if (lhs->type != rhs->type)
+    assert(v != NULL && DIANA_TYPE(v) == DIANA_OBJECT);
+    // 查找总是返回键第一次出现的位置
+    for (i = 0; i < DIANA_SIZE(v); i++)
+    {
+        const diana_member *m = &v->u.m[i];
+        if (diana_object_lookup(v, m->k, m->klen, DIANA_OBJECT_HASH(v, m->k, m->klen)) != i)
+            return i;
+    }
+    return DIANA_KEY_NOT_EXIST;
+}
+
+/* 比较类型与标量值，数组与对象只比较元素（成员）数 */
+static int diana_is_equal_shallow(const diana_value *lhs, const diana_value *rhs)
+{
+    if (DIANA_TYPE(lhs) != DIANA_TYPE(rhs))
         return 0;
-    switch (lhs->type)
+    switch (DIANA_TYPE(lhs))
     {
     case DIANA_STRING:
-        return lhs->u.s.len == rhs->u.s.len &&
-               memcmp(lhs->u.s.s, rhs->u.s.s, lhs->u.s.len) == 0;
+        return DIANA_SIZE(lhs) == DIANA_SIZE(rhs) &&
+               ((!DIANA_IS_SHORT(DIANA_SIZE(lhs)) && lhs->u.s == rhs->u.s) || // 共享的字符串
+                memcmp(DIANA_STRING_DATA(lhs), DIANA_STRING_DATA(rhs), DIANA_SIZE(lhs)) == 0);
     case DIANA_NUMBER:
         return lhs->u.n == rhs->u.n;
     case DIANA_ARRAY:
-        if (lhs->u.a.size != rhs->u.a.size)
-            return 0;
-        for (i = 0; i < lhs->u.a.size; i++)
-            if (!diana_is_equal(&lhs->u.a.e[i], &rhs->u.a.e[i]))
-                return 0;
-        return 1;
+        return DIANA_SIZE(lhs) == DIANA_SIZE(rhs);
     case DIANA_OBJECT:
-        if (lhs->u.o.size != rhs->u.o.size)
-            return 0;
-        for (i = 0; i < lhs->u.a.size; i++)
-        {
-            size_t index = diana_find_object_index(rhs, lhs->u.o.m[i].k, lhs->u.o.m[i].klen);
-            if (index == DIANA_KEY_NOT_EXIST)
-                return 0;
-            if (!diana_is_equal(&lhs->u.o.m[i].v, &rhs->u.o.m[index].v))
-                return 0;
-        }
-        return 1;
+        return DIANA_SIZE(lhs) == DIANA_SIZE(rhs);
     default:
         return 1;
     }
 }
 
-#define PUTS(c, s, len) memcpy(diana_context_push(c, len), s, len)
-
-static void diana_stringify_string(diana_context *c, const char *s, size_t len)
+/* 比较子节点，嵌套的数组与对象成对压入堆栈稍后比较，共享同一堆块的容器不必展开 */
+static int diana_is_equal_child(diana_context *c, const diana_value *lhs, const diana_value *rhs)
 {
-    static const char hex_digits[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-    size_t i, size;
-    char *head, *p;
-    assert(s != NULL);
-    p = head = diana_context_push(c, size = len * 6 + 2);
-    *p++ = '"';
-    for (i = 0; i < len; i++)
+    if (!diana_is_equal_shallow(lhs, rhs))
+        return 0;
+    if ((DIANA_TYPE(lhs) == DIANA_ARRAY || DIANA_TYPE(lhs) == DIANA_OBJECT) && lhs->u.e != rhs->u.e)
     {
-        unsigned char ch = (unsigned char)s[i];
-        switch (ch)
-        {
-        case '\"':
-            *p++ = '\\';
-            *p++ = '\"';
-            break;
-        case '\\':
-            *p++ = '\\';
-            *p++ = '\\';
-            break;
-        case '\b':
-            *p++ = '\\';
-            *p++ = 'b';
-            break;
-        case '\f':
-            *p++ = '\\';
-            *p++ = 'f';
-            break;
-        case '\n':
-            *p++ = '\\';
-            *p++ = 'n';
-            break;
-        case '\r':
-            *p++ = '\\';
-            *p++ = 'r';
-            break;
-        case '\t':
-            *p++ = '\\';
-            *p++ = 't';
+        const diana_value **p = (const diana_value **)diana_context_push(c, 2 * sizeof(const diana_value *));
+        p[0] = lhs;
+        p[1] = rhs;
+    }
+    return 1;
+}
+
+/* 以显式堆栈代替递归 */
+int diana_is_equal(const diana_value *lhs, const diana_value *rhs)
+{
+    diana_context c;
+    size_t i, index;
+    int equal;
+    assert(lhs != NULL && rhs != NULL);
+    if (!diana_is_equal_shallow(lhs, rhs))
+        return 0;
+    c.stack = NULL;
+    c.size = c.top = 0;
+    for (equal = 1; equal;)
+    {
+        if (lhs->u.e == rhs->u.e && (DIANA_TYPE(lhs) == DIANA_ARRAY || DIANA_TYPE(lhs) == DIANA_OBJECT))
+            ; // 共享同一堆块
+        else if (DIANA_TYPE(lhs) == DIANA_ARRAY)
+        {
+            for (i = 0; equal && i < DIANA_SIZE(lhs); i++)
+                equal = diana_is_equal_child(&c, &lhs->u.e[i], &rhs->u.e[i]);
+        }
+        else if (DIANA_TYPE(lhs) == DIANA_OBJECT)
+        {
+            for (i = 0; equal && i < DIANA_SIZE(lhs); i++)
+            {
+                const diana_member *m = &lhs->u.m[i];
+                index = diana_object_lookup(rhs, m->k, m->klen, DIANA_OBJECT_HASH(rhs, m->k, m->klen));
+                equal = index != DIANA_KEY_NOT_EXIST && diana_is_equal_child(&c, &m->v, &rhs->u.m[index].v);
+            }
+        }
+        if (c.top == 0)
             break;
-        default:
-            if (ch < 0x20)
+        {
+            const diana_value **p = (const diana_value **)diana_context_pop(&c, 2 * sizeof(const diana_value *));
+            lhs = p[0];
+            rhs = p[1];
+        }
+    }
+    free(c.stack);
+    return equal;
+}
+
+#define PUTS(c, s, len) memcpy(diana_context_push(c, len), s, len)
+
+/* 生成器输出：sink为NULL时全部累积在c中，否则c为固定大小的缓冲区，写满即交给sink */
+typedef struct
+{
+    diana_context c;
+    diana_sink sink;
+    void *user;
+    int status; // sink返回的首个非零值，此后的输出全部丢弃
+} diana_output;
+
+static void diana_output_flush(diana_output *o)
+{
+    if (o->c.top > 0 && o->status == 0)
+        o->status = o->sink(o->user, o->c.stack, o->c.top);
+    o->c.top = 0;
+}
+
+static void *diana_output_push(diana_output *o, size_t size)
+{
+    if (o->sink != NULL && o->c.top + size >= o->c.size)
+    {
+        assert(size < o->c.size);
+        diana_output_flush(o);
+    }
+    return diana_context_push(&o->c, size);
+}
+
+#define OUTC(o, ch)                                         \
+    do                                                      \
+    {                                                       \
+        *(char *)diana_output_push(o, sizeof(char)) = (ch); \
+    } while (0)
+
+#define OUTS(o, s, len) memcpy(diana_output_push(o, len), s, len)
+
+/* 每次转义的输入字节数，输出最多为其6倍，须小于DIANA_STRINGIFY_BUFFER_SIZE，缓冲区较小时随之缩短 */
+#define DIANA_STRINGIFY_STRING_CHUNK (DIANA_STRINGIFY_BUFFER_SIZE > 6 * 256 ? 256 : (DIANA_STRINGIFY_BUFFER_SIZE - 1) / 6)
+
+static void diana_stringify_string(diana_output *o, const char *s, size_t len)
+{
+    static const char hex_digits[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+    size_t i, n, size;
+    char *head, *p;
+    assert(s != NULL);
+    OUTC(o, '"');
+    /* 分段转义，长字符串不需要与其等长的缓冲区 */
+    for (; len > 0; s += n, len -= n)
+    {
+        n = len < DIANA_STRINGIFY_STRING_CHUNK ? len : DIANA_STRINGIFY_STRING_CHUNK;
+        p = head = diana_output_push(o, size = n * 6);
+        for (i = 0; i < n; i++)
+        {
+            unsigned char ch = (unsigned char)s[i];
+            switch (ch)
             {
+            case '\"':
+                *p++ = '\\';
+                *p++ = '\"';
+                break;
+            case '\\':
+                *p++ = '\\';
+                *p++ = '\\';
+                break;
+            case '\b':
+                *p++ = '\\';
+                *p++ = 'b';
+                break;
+            case '\f':
+                *p++ = '\\';
+                *p++ = 'f';
+                break;
+            case '\n':
+                *p++ = '\\';
+                *p++ = 'n';
+                break;
+            case '\r':
+                *p++ = '\\';
+                *p++ = 'r';
+                break;
+            case '\t':
                 *p++ = '\\';
-                *p++ = 'u';
-                *p++ = '0';
-                *p++ = '0';
-                *p++ = hex_digits[ch >> 4];
-                *p++ = hex_digits[ch & 15];
+                *p++ = 't';
+                break;
+            default:
+                if (ch < 0x20)
+                {
+                    *p++ = '\\';
+                    *p++ = 'u';
+                    *p++ = '0';
+                    *p++ = '0';
+                    *p++ = hex_digits[ch >> 4];
+                    *p++ = hex_digits[ch & 15];
+                }
+                else
+                    *p++ = s[i];
             }
-            else
-                *p++ = s[i];
         }
+        o->c.top -= size - (p - head);
     }
-    *p++ = '"';
-    c->top -= size - (p - head);
+    OUTC(o, '"');
 }
 
-static void diana_stringify_value(diana_context *c, const diana_value *v)
+/* 生成器的容器帧：正在输出的容器与当前子节点下标 */
+typedef struct
 {
+    const diana_value *v;
     size_t i;
-    switch (v->type)
+} diana_stringify_frame;
+
+/* 以显式栈代替递归，帧保存在独立的堆栈中，输出缓冲区可随时交给sink */
+static void diana_stringify_value(diana_output *o, const diana_value *v)
+{
+    diana_context s;
+    diana_stringify_frame *f;
+    s.stack = NULL;
+    s.size = s.top = 0;
+    while (o->status == 0)
     {
-    case DIANA_NULL:
-        PUTS(c, "null", 4);
-        break;
-    case DIANA_FALSE:
-        PUTS(c, "false", 5);
-        break;
-    case DIANA_TRUE:
-        PUTS(c, "true", 4);
-        break;
-    case DIANA_NUMBER:
-        c->top -= 32 - sprintf(diana_context_push(c, 32), "%.17g", v->u.n);
-        break;
-    case DIANA_STRING:
-        diana_stringify_string(c, v->u.s.s, v->u.s.len);
-        break;
-    case DIANA_ARRAY:
-        PUTC(c, '[');
-        for (i = 0; i < v->u.a.size; i++)
+        switch (DIANA_TYPE(v))
+        {
+        case DIANA_NULL:
+            OUTS(o, "null", 4);
+            break;
+        case DIANA_FALSE:
+            OUTS(o, "false", 5);
+            break;
+        case DIANA_TRUE:
+            OUTS(o, "true", 4);
+            break;
+        case DIANA_NUMBER:
+            o->c.top -= 32 - sprintf(diana_output_push(o, 32), "%.17g", v->u.n);
+            break;
+        case DIANA_STRING:
+            diana_stringify_string(o, DIANA_STRING_DATA(v), DIANA_SIZE(v));
+            break;
+        case DIANA_ARRAY:
+            OUTC(o, '[');
+            if (DIANA_SIZE(v) > 0)
+            {
+                f = (diana_stringify_frame *)diana_context_push(&s, sizeof(diana_stringify_frame));
+                f->v = v;
+                f->i = 0;
+                v = &v->u.e[0];
+                continue;
+            }
+            OUTC(o, ']');
+            break;
+        case DIANA_OBJECT:
+            OUTC(o, '{');
+            if (DIANA_SIZE(v) > 0)
+            {
+                f = (diana_stringify_frame *)diana_context_push(&s, sizeof(diana_stringify_frame));
+                f->v = v;
+                f->i = 0;
+                diana_stringify_string(o, v->u.m[0].k, v->u.m[0].klen);
+                OUTC(o, ':');
+                v = &v->u.m[0].v;
+                continue;
+            }
+            OUTC(o, '}');
+            break;
+        default:
+            assert(0 && "invalid type");
+        }
+        /* 当前值已输出完毕，关闭所有已遍历完的容器 */
+        for (;;)
         {
-            if (i > 0)
-                PUTC(c, ',');
-            diana_stringify_value(c, &v->u.a.e[i]);
+            if (s.top == 0)
+            {
+                free(s.stack);
+                return;
+            }
+            f = (diana_stringify_frame *)(s.stack + s.top - sizeof(diana_stringify_frame));
+            if (++f->i < DIANA_SIZE(f->v))
+                break;
+            OUTC(o, DIANA_TYPE(f->v) == DIANA_ARRAY ? ']' : '}');
+            diana_context_pop(&s, sizeof(diana_stringify_frame));
         }
-        PUTC(c, ']');
-        break;
-    case DIANA_OBJECT:
-        PUTC(c, '{');
-        for (i = 0; i < v->u.o.size; i++)
+        OUTC(o, ',');
+        if (DIANA_TYPE(f->v) == DIANA_ARRAY)
+            v = &f->v->u.e[f->i];
+        else
         {
-            if (i > 0)
-                PUTC(c, ',');
-            diana_stringify_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
-            PUTC(c, ':');
-            diana_stringify_value(c, &v->u.o.m[i].v);
+            diana_stringify_string(o, f->v->u.m[f->i].k, f->v->u.m[f->i].klen);
+            OUTC(o, ':');
+            v = &f->v->u.m[f->i].v;
         }
-        PUTC(c, '}');
-        break;
-    default:
-        assert(0 && "invalid type");
     }
+    free(s.stack);
 }
 
 /* 生成器 */
 char *diana_stringify(const diana_value *v, size_t *length)
 {
-    diana_context c;
+    diana_output o;
     assert(v != NULL);
-    c.stack = (char *)malloc(c.size = DIANA_PARSE_STRINGIFY_INIT_SIZE);
-    c.top = 0;
-    diana_stringify_value(&c, v);
+    o.c.stack = (char *)malloc(o.c.size = DIANA_PARSE_STRINGIFY_INIT_SIZE);
+    o.c.top = 0;
+    o.sink = NULL;
+    o.user = NULL;
+    o.status = 0;
+    diana_stringify_value(&o, v);
     if (length)
-        *length = c.top;
-    PUTC(&c, '\0');
-    return c.stack;
+        *length = o.c.top;
+    PUTC(&o.c, '\0');
+    return o.c.stack;
+}
+
+int diana_stringify_to(const diana_value *v, diana_sink sink, void *user)
+{
+    char buffer[DIANA_STRINGIFY_BUFFER_SIZE];
+    diana_output o;
+    assert(v != NULL && sink != NULL);
+    o.c.stack = buffer;
+    o.c.size = sizeof(buffer);
+    o.c.top = 0;
+    o.sink = sink;
+    o.user = user;
+    o.status = 0;
+    diana_stringify_value(&o, v);
+    diana_output_flush(&o);
+    return o.status;
+}
+
+static int diana_file_sink(void *user, const char *data, size_t length)
+{
+    return fwrite(data, 1, length, (FILE *)user) == length ? 0 : EOF;
+}
+
+int diana_stringify_file(const diana_value *v, FILE *fp)
+{
+    assert(fp != NULL);
+    return diana_stringify_to(v, diana_file_sink, fp);
+}
+
+diana_writer *diana_writer_create(void)
+{
+    diana_writer *w = (diana_writer *)malloc(sizeof(diana_writer));
+    w->c.stack = NULL;
+    w->c.size = w->c.top = 0;
+    return w;
+}
+
+void diana_writer_destroy(diana_writer *w)
+{
+    if (w == NULL)
+        return;
+    free(w->c.stack);
+    free(w);
 }
 
+void diana_writer_reset(diana_writer *w)
+{
+    assert(w != NULL);
+    free(w->c.stack);
+    w->c.stack = NULL;
+    w->c.size = w->c.top = 0;
+}
+
+const char *diana_stringify_with(diana_writer *w, const diana_value *v, size_t *length)
+{
+    diana_output o;
+    assert(w != NULL && v != NULL);
+    o.c = w->c;
+    o.c.top = 0;
+    o.sink = NULL;
+    o.user = NULL;
+    o.status = 0;
+    diana_stringify_value(&o, v);
+    if (length)
+        *length = o.c.top;
+    PUTC(&o.c, '\0');
+    w->c = o.c;
+    return w->c.stack;
+}
+
+/* 使用者可在编译选项中设置DIANA_COPY_SHARED为1，使diana_copy以共享复制代替深度复制 */
+#ifndef DIANA_COPY_SHARED
+#define DIANA_COPY_SHARED 0
+#endif
+
 void diana_copy(diana_value *dst, const diana_value *src)
 {
+    diana_copy_alloc(dst, src, NULL);
+}
+
+/* 复制子节点（dst已初始化）：标量直接复制，数组与对象成对压入堆栈稍后处理 */
+static void diana_copy_child(diana_context *c, diana_value *dst, const diana_value *src, const diana_allocator *a)
+{
+    if (DIANA_TYPE(src) == DIANA_STRING && !DIANA_IS_SHORT(DIANA_SIZE(src)))
+        diana_set_string_alloc(dst, src->u.s, DIANA_SIZE(src), a);
+    else if (DIANA_TYPE(src) == DIANA_ARRAY || DIANA_TYPE(src) == DIANA_OBJECT)
+    {
+        void **p = (void **)diana_context_push(c, 2 * sizeof(void *));
+        p[0] = dst;
+        p[1] = (void *)src;
+    }
+    else
+        memcpy(dst, src, sizeof(diana_value));
+}
+
+/* 以显式堆栈代替递归，容器按源的元素（成员）数一次分配，此后不再移动 */
+void diana_copy_alloc(diana_value *dst, const diana_value *src, const diana_allocator *a)
+{
+    diana_context c;
     size_t i;
     assert(src != NULL && dst != NULL && src != dst);
-    switch (src->type)
+#if DIANA_COPY_SHARED
+    diana_copy_shared_alloc(dst, src, a);
+    return;
+#endif
+    a = DIANA_ALLOCATOR(a);
+    diana_free_alloc(dst, a);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    for (;;)
     {
-    case DIANA_STRING:
-        diana_set_string(dst, src->u.s.s, src->u.s.len);
-        break;
-    case DIANA_ARRAY:
-        /*TODO*/
-        // How to allocate N
-        diana_free(dst);
-        // dst = (diana_value *)malloc(sizeof(diana_value)); // 给数组对象分配一个新空间
-        dst->type = DIANA_ARRAY; // 划分类型为数组
-        dst->u.a.size = src->u.a.size;
-        dst->u.a.e = (diana_value *)malloc(sizeof(diana_value) * src->u.a.size); // 为数组元素中的数据区划分相同大小的空间
-        for (i = 0; i < src->u.a.size; i++)
+        switch (DIANA_TYPE(src))
         {
-            diana_init(&dst->u.a.e[i]); // 初始化当前元素
-            diana_copy(&dst->u.a.e[i], &src->u.a.e[i]);
+        case DIANA_ARRAY:
+            diana_set_array_alloc(dst, DIANA_SIZE(src), a); // 为数组元素中的数据区划分相同大小的空间
+            DIANA_SET_SIZE(dst, DIANA_SIZE(src));
+            for (i = 0; i < DIANA_SIZE(src); i++)
+            {
+                diana_init(&dst->u.e[i]); // 初始化当前元素
+                diana_copy_child(&c, &dst->u.e[i], &src->u.e[i], a);
+            }
+            break;
+        case DIANA_OBJECT:
+            diana_set_object_alloc(dst, DIANA_SIZE(src), a); // 为对象元素中的数据区划分相同大小的空间
+            DIANA_SET_SIZE(dst, DIANA_SIZE(src));
+            for (i = 0; i < DIANA_SIZE(src); i++)
+            {
+                /* key and value */
+                dst->u.m[i].k = (char *)diana_malloc(a, src->u.m[i].klen + 1); // 为key字符串分配空间（含'\0'）
+                memcpy(dst->u.m[i].k, src->u.m[i].k, src->u.m[i].klen + 1);
+                dst->u.m[i].klen = src->u.m[i].klen;
+                diana_init(&dst->u.m[i].v); // 初始化当前元素
+                diana_copy_child(&c, &dst->u.m[i].v, &src->u.m[i].v, a);
+            }
+            diana_object_reindex(dst, DIANA_INDEX(src), a);
+            break;
+        default: /* NUMBER, STRING, TRUE, FALSE, NULL */
+            diana_copy_child(&c, dst, src, a);
+            break;
         }
-        break;
-    case DIANA_OBJECT:
-        /*TODO*/
-        // How to allocate N
-        diana_free(dst);
-        // dst = (diana_value *)malloc(sizeof(diana_value)); // 给对象分配一个新空间
-        dst->type = DIANA_OBJECT; // 划分类型为对象
-        dst->u.o.size = src->u.o.size;
-        dst->u.o.m = (diana_member *)malloc(sizeof(diana_member) * src->u.o.size); // 为对象元素中的数据区划分相同大小的空间
-        for (i = 0; i < src->u.o.size; i++)
+        if (c.top == 0)
+            break;
         {
-            /* key and value */
-            dst->u.o.m[i].k = (char *)malloc(src->u.o.m[i].klen); // 为key字符串分配空间
-            memcpy(dst->u.o.m[i].k, src->u.o.m[i].k, src->u.o.m[i].klen);
-            dst->u.o.m[i].klen = src->u.o.m[i].klen;
-            diana_init(&dst->u.o.m[i].v); // 初始化当前元素
-            diana_copy(&dst->u.o.m[i].v, &src->u.o.m[i].v);
+            void **p = (void **)diana_context_pop(&c, 2 * sizeof(void *));
+            dst = (diana_value *)p[0];
+            src = (const diana_value *)p[1];
         }
-        break;
-    default: /* NUMBER, TRUE, FALSE, NULL */
-        diana_free(dst);
-        memcpy(dst, src, sizeof(diana_value));
-        break;
+    }
+    free(c.stack);
+}
+
+/* 增加堆上字符串或数组（对象）堆块的引用计数 */
+static void diana_share(const diana_value *v)
+{
+    if (DIANA_TYPE(v) == DIANA_STRING && !DIANA_IS_SHORT(DIANA_SIZE(v)))
+        ++*DIANA_STRING_REFS(v);
+    else if ((DIANA_TYPE(v) == DIANA_ARRAY || DIANA_TYPE(v) == DIANA_OBJECT) && v->u.e != NULL)
+        DIANA_HEADER(v->u.e)->refs++;
+}
+
+void diana_copy_shared(diana_value *dst, const diana_value *src)
+{
+    diana_copy_shared_alloc(dst, src, NULL);
+}
+
+/* 先增加引用计数再释放dst，src位于dst之内时依然有效 */
+void diana_copy_shared_alloc(diana_value *dst, const diana_value *src, const diana_allocator *a)
+{
+    diana_value x;
+    assert(src != NULL && dst != NULL && src != dst);
+    diana_share(src);
+    memcpy(&x, src, sizeof(diana_value));
+    diana_free_alloc(dst, a);
+    memcpy(dst, &x, sizeof(diana_value));
+}
+
+void diana_unshare(diana_value *v)
+{
+    diana_unshare_alloc(v, NULL);
+}
+
+/* 写时复制：复制共享的堆块（对象连同键与索引），子节点只增加引用计数，不递归复制 */
+void diana_unshare_alloc(diana_value *v, const diana_allocator *a)
+{
+    diana_container *h;
+    size_t i, size;
+    assert(v != NULL);
+    if ((DIANA_TYPE(v) != DIANA_ARRAY && DIANA_TYPE(v) != DIANA_OBJECT) || v->u.e == NULL ||
+        (h = DIANA_HEADER(v->u.e))->refs <= 1)
+        return;
+    a = DIANA_ALLOCATOR(a);
+    size = DIANA_SIZE(v);
+    h->refs--;
+    if (DIANA_TYPE(v) == DIANA_ARRAY)
+    {
+        diana_value *e = (diana_value *)diana_container_resize(NULL, sizeof(diana_value), h->capacity, a);
+        memcpy(e, v->u.e, size * sizeof(diana_value));
+        for (i = 0; i < size; i++)
+            diana_share(&e[i]);
+        v->u.e = e;
+    }
+    else
+    {
+        diana_member *m = (diana_member *)diana_container_resize(NULL, sizeof(diana_member), h->capacity, a);
+        memcpy(m, v->u.m, size * sizeof(diana_member));
+        for (i = 0; i < size; i++)
+        {
+            m[i].k = (char *)diana_malloc(a, m[i].klen + 1);
+            memcpy(m[i].k, v->u.m[i].k, m[i].klen + 1);
+            diana_share(&m[i].v);
+        }
+        v->u.m = m;
+        diana_object_reindex(v, h->index, a);
     }
 }
 #define NAME(x) #x
 
 void diana_move(diana_value *dst, diana_value *src)
 {
-    if (dst == NULL)
-        printf("dst is null!\n");
-    if (src == NULL)
-        printf("src is null!\n");
-    if (src == dst)
-        printf("src==dst!\n");
+    diana_move_alloc(dst, src, NULL);
+}
+
+void diana_move_alloc(diana_value *dst, diana_value *src, const diana_allocator *a)
+{
     assert(dst != NULL && src != NULL && src != dst);
-    diana_free(dst);
+    diana_free_alloc(dst, a);
     memcpy(dst, src, sizeof(diana_value));
     diana_init(src);
 }
@@ -1088,4 +2360,869 @@ void diana_swap(diana_value *lhs, diana_value *rhs)
         memcpy(lhs, rhs, sizeof(diana_value));
         memcpy(rhs, &temp, sizeof(diana_value));
     }
-}
\ No newline at end of file
+}
+/* 二进制编解码：CBOR（RFC 8949）与MessagePack */
+/* 数字以原生整数/浮点格式存储，字符串带长度前缀，解码时直接memcpy */
+
+/* 可无损表示为int64的整数值（-0除外） */
+static int diana_is_integral(double n)
+{
+    return n == floor(n) && n >= -9223372036854775808.0 && n < 9223372036854775808.0 && !(n == 0 && signbit(n));
+}
+
+static int diana_fits_float(double n)
+{
+    return (double)(float)n == n;
+}
+
+static uint32_t diana_float_bits(double n)
+{
+    float f = (float)n;
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static uint64_t diana_double_bits(double n)
+{
+    uint64_t u;
+    memcpy(&u, &n, sizeof(u));
+    return u;
+}
+
+/* 以大端序写入整数 */
+static void diana_put_be(diana_context *c, uint64_t u, size_t bytes)
+{
+    unsigned char *p = (unsigned char *)diana_context_push(c, bytes);
+    while (bytes-- > 0)
+    {
+        p[bytes] = (unsigned char)(u & 0xFF);
+        u >>= 8;
+    }
+}
+
+static void diana_encode_cbor_head(diana_context *c, unsigned major, uint64_t u)
+{
+    major <<= 5;
+    if (u < 24)
+        PUTC(c, (char)(major | u));
+    else if (u <= 0xFF)
+    {
+        PUTC(c, (char)(major | 24));
+        diana_put_be(c, u, 1);
+    }
+    else if (u <= 0xFFFF)
+    {
+        PUTC(c, (char)(major | 25));
+        diana_put_be(c, u, 2);
+    }
+    else if (u <= 0xFFFFFFFF)
+    {
+        PUTC(c, (char)(major | 26));
+        diana_put_be(c, u, 4);
+    }
+    else
+    {
+        PUTC(c, (char)(major | 27));
+        diana_put_be(c, u, 8);
+    }
+}
+
+static void diana_encode_cbor_value(diana_context *c, const diana_value *v)
+{
+    size_t i;
+    switch (DIANA_TYPE(v))
+    {
+    case DIANA_NULL:
+        PUTC(c, (char)0xF6);
+        break;
+    case DIANA_FALSE:
+        PUTC(c, (char)0xF4);
+        break;
+    case DIANA_TRUE:
+        PUTC(c, (char)0xF5);
+        break;
+    case DIANA_NUMBER:
+        if (diana_is_integral(v->u.n))
+        {
+            int64_t n = (int64_t)v->u.n;
+            if (n >= 0)
+                diana_encode_cbor_head(c, 0, (uint64_t)n);
+            else
+                diana_encode_cbor_head(c, 1, (uint64_t)(-1 - n));
+        }
+        else if (diana_fits_float(v->u.n))
+        {
+            PUTC(c, (char)0xFA);
+            diana_put_be(c, diana_float_bits(v->u.n), 4);
+        }
+        else
+        {
+            PUTC(c, (char)0xFB);
+            diana_put_be(c, diana_double_bits(v->u.n), 8);
+        }
+        break;
+    case DIANA_STRING:
+        diana_encode_cbor_head(c, 3, DIANA_SIZE(v));
+        if (DIANA_SIZE(v) > 0)
+            PUTS(c, DIANA_STRING_DATA(v), DIANA_SIZE(v));
+        break;
+    case DIANA_ARRAY:
+        diana_encode_cbor_head(c, 4, DIANA_SIZE(v));
+        for (i = 0; i < DIANA_SIZE(v); i++)
+            diana_encode_cbor_value(c, &v->u.e[i]);
+        break;
+    case DIANA_OBJECT:
+        diana_encode_cbor_head(c, 5, DIANA_SIZE(v));
+        for (i = 0; i < DIANA_SIZE(v); i++)
+        {
+            diana_encode_cbor_head(c, 3, v->u.m[i].klen);
+            if (v->u.m[i].klen > 0)
+                PUTS(c, v->u.m[i].k, v->u.m[i].klen);
+            diana_encode_cbor_value(c, &v->u.m[i].v);
+        }
+        break;
+    default:
+        assert(0 && "invalid type");
+    }
+}
+
+/* 写入MessagePack长度头：fix格式（fix为0时不使用）、8位（base8为0时不使用）、16位与32位（base16 + 1） */
+static void diana_encode_msgpack_length(diana_context *c, uint64_t len, unsigned fix, uint64_t fixmax, unsigned base8, unsigned base16)
+{
+    if (fix && len <= fixmax)
+        PUTC(c, (char)(fix | len));
+    else if (base8 && len <= 0xFF)
+    {
+        PUTC(c, (char)base8);
+        diana_put_be(c, len, 1);
+    }
+    else if (len <= 0xFFFF)
+    {
+        PUTC(c, (char)base16);
+        diana_put_be(c, len, 2);
+    }
+    else
+    {
+        PUTC(c, (char)(base16 + 1));
+        diana_put_be(c, len, 4);
+    }
+}
+
+static void diana_encode_msgpack_string(diana_context *c, const char *s, size_t len)
+{
+    diana_encode_msgpack_length(c, len, 0xA0, 31, 0xD9, 0xDA);
+    if (len > 0)
+        PUTS(c, s, len);
+}
+
+static void diana_encode_msgpack_value(diana_context *c, const diana_value *v)
+{
+    size_t i;
+    switch (DIANA_TYPE(v))
+    {
+    case DIANA_NULL:
+        PUTC(c, (char)0xC0);
+        break;
+    case DIANA_FALSE:
+        PUTC(c, (char)0xC2);
+        break;
+    case DIANA_TRUE:
+        PUTC(c, (char)0xC3);
+        break;
+    case DIANA_NUMBER:
+        if (diana_is_integral(v->u.n))
+        {
+            int64_t n = (int64_t)v->u.n;
+            if (n >= -32 && n <= 0x7F) /* positive/negative fixint */
+                PUTC(c, (char)n);
+            else if (n >= 0)
+            {
+                size_t bytes = n <= 0xFF ? 1 : n <= 0xFFFF ? 2 : n <= 0xFFFFFFFF ? 4 : 8;
+                PUTC(c, (char)(bytes == 1 ? 0xCC : bytes == 2 ? 0xCD : bytes == 4 ? 0xCE : 0xCF));
+                diana_put_be(c, (uint64_t)n, bytes);
+            }
+            else
+            {
+                size_t bytes = n >= INT8_MIN ? 1 : n >= INT16_MIN ? 2 : n >= INT32_MIN ? 4 : 8;
+                PUTC(c, (char)(bytes == 1 ? 0xD0 : bytes == 2 ? 0xD1 : bytes == 4 ? 0xD2 : 0xD3));
+                diana_put_be(c, (uint64_t)n, bytes);
+            }
+        }
+        else if (diana_fits_float(v->u.n))
+        {
+            PUTC(c, (char)0xCA);
+            diana_put_be(c, diana_float_bits(v->u.n), 4);
+        }
+        else
+        {
+            PUTC(c, (char)0xCB);
+            diana_put_be(c, diana_double_bits(v->u.n), 8);
+        }
+        break;
+    case DIANA_STRING:
+        diana_encode_msgpack_string(c, DIANA_STRING_DATA(v), DIANA_SIZE(v));
+        break;
+    case DIANA_ARRAY:
+        diana_encode_msgpack_length(c, DIANA_SIZE(v), 0x90, 15, 0, 0xDC);
+        for (i = 0; i < DIANA_SIZE(v); i++)
+            diana_encode_msgpack_value(c, &v->u.e[i]);
+        break;
+    case DIANA_OBJECT:
+        diana_encode_msgpack_length(c, DIANA_SIZE(v), 0x80, 15, 0, 0xDE);
+        for (i = 0; i < DIANA_SIZE(v); i++)
+        {
+            diana_encode_msgpack_string(c, v->u.m[i].k, v->u.m[i].klen);
+            diana_encode_msgpack_value(c, &v->u.m[i].v);
+        }
+        break;
+    default:
+        assert(0 && "invalid type");
+    }
+}
+
+char *diana_encode_cbor(const diana_value *v, size_t *length)
+{
+    diana_context c;
+    assert(v != NULL);
+    c.stack = (char *)malloc(c.size = DIANA_PARSE_STRINGIFY_INIT_SIZE);
+    c.top = 0;
+    diana_encode_cbor_value(&c, v);
+    if (length)
+        *length = c.top;
+    return c.stack;
+}
+
+char *diana_encode_msgpack(const diana_value *v, size_t *length)
+{
+    diana_context c;
+    assert(v != NULL);
+    c.stack = (char *)malloc(c.size = DIANA_PARSE_STRINGIFY_INIT_SIZE);
+    c.top = 0;
+    diana_encode_msgpack_value(&c, v);
+    if (length)
+        *length = c.top;
+    return c.stack;
+}
+
+/* 解码游标，越界即为DIANA_PARSE_INVALID_BINARY */
+typedef struct
+{
+    const unsigned char *p, *end;
+    size_t depth; /* 当前容器嵌套深度 */
+    diana_context c; /* 拼接CBOR不定长字符串的缓冲区 */
+} diana_decoder;
+
+#define DECODE_NEED(d, n)                         \
+    do                                            \
+    {                                             \
+        if ((size_t)((d)->end - (d)->p) < (n))    \
+            return DIANA_PARSE_INVALID_BINARY;    \
+    } while (0)
+
+static int diana_decode_be(diana_decoder *d, size_t bytes, uint64_t *u)
+{
+    DECODE_NEED(d, bytes);
+    *u = 0;
+    while (bytes-- > 0)
+        *u = (*u << 8) | *d->p++;
+    return DIANA_PARSE_OK;
+}
+
+static double diana_float_from_bits(uint64_t u)
+{
+    uint32_t bits = (uint32_t)u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static double diana_double_from_bits(uint64_t u)
+{
+    double n;
+    memcpy(&n, &u, sizeof(n));
+    return n;
+}
+
+static double diana_half_to_double(unsigned h)
+{
+    int exp = (h >> 10) & 0x1F;
+    int mant = h & 0x3FF;
+    double n;
+    if (exp == 0)
+        n = ldexp(mant, -24);
+    else if (exp != 31)
+        n = ldexp(mant + 1024, exp - 25);
+    else
+        n = mant == 0 ? HUGE_VAL : NAN;
+    return (h & 0x8000) ? -n : n;
+}
+
+/* 读取CBOR首字节之后的参数（ai < 28） */
+static int diana_decode_cbor_argument(diana_decoder *d, unsigned ai, uint64_t *u)
+{
+    if (ai < 24)
+    {
+        *u = ai;
+        return DIANA_PARSE_OK;
+    }
+    if (ai <= 27)
+        return diana_decode_be(d, (size_t)1 << (ai - 24), u);
+    return DIANA_PARSE_INVALID_BINARY;
+}
+
+/* 读取CBOR字符串：定长时直接指向输入；不定长时将分块拼接到缓冲区，结果在下次入栈前有效 */
+static int diana_decode_cbor_string(diana_decoder *d, unsigned major, unsigned ai, const char **s, size_t *len)
+{
+    uint64_t u;
+    int ret;
+    if (ai != 31)
+    {
+        if ((ret = diana_decode_cbor_argument(d, ai, &u)) != DIANA_PARSE_OK)
+            return ret;
+        DECODE_NEED(d, u);
+        *s = (const char *)d->p;
+        *len = (size_t)u;
+        d->p += u;
+        return DIANA_PARSE_OK;
+    }
+    *len = 0;
+    for (;;)
+    {
+        DECODE_NEED(d, 1);
+        if (*d->p == 0xFF)
+            break;
+        if ((*d->p >> 5) != major)
+            return diana_context_pop(&d->c, *len), DIANA_PARSE_INVALID_BINARY;
+        ai = *d->p++ & 0x1F;
+        if ((ret = diana_decode_cbor_argument(d, ai, &u)) != DIANA_PARSE_OK || (size_t)(d->end - d->p) < u)
+            return diana_context_pop(&d->c, *len), DIANA_PARSE_INVALID_BINARY;
+        if (u > 0)
+            PUTS(&d->c, d->p, (size_t)u);
+        d->p += u;
+        *len += (size_t)u;
+    }
+    d->p++;
+    *s = *len > 0 ? (const char *)diana_context_pop(&d->c, *len) : "";
+    return DIANA_PARSE_OK;
+}
+
+static int diana_decode_cbor_value(diana_decoder *d, diana_value *v);
+
+/* 追加对象成员，不检查键是否重复（与diana_parse一致） */
+static diana_value *diana_decode_member(diana_value *v, const char *k, size_t klen, const diana_allocator *a)
+{
+    char *key;
+    if (DIANA_SIZE(v) == DIANA_CAPACITY(v))
+        diana_reserve_object_alloc(v, DIANA_CAPACITY(v) == 0 ? 4 : DIANA_CAPACITY(v) * 2, a);
+    memcpy(key = (char *)diana_malloc(a, klen + 1), k, klen);
+    key[klen] = '\0';
+    return diana_object_append(v, key, klen, DIANA_OBJECT_HASH(v, k, klen), a);
+}
+
+static int diana_decode_cbor_items(diana_decoder *d, diana_value *v, unsigned major, unsigned ai)
+{
+    uint64_t u = 0, i;
+    int ret, indefinite = ai == 31;
+    if (!indefinite)
+    {
+        if ((ret = diana_decode_cbor_argument(d, ai, &u)) != DIANA_PARSE_OK)
+            return ret;
+        DECODE_NEED(d, u); /* 每个元素至少一个字节 */
+        if (major == 5)
+            DECODE_NEED(d, u * 2);
+    }
+    if (major == 4)
+        diana_set_array_alloc(v, (size_t)u, d->c.a);
+    else
+        diana_set_object_alloc(v, (size_t)u, d->c.a);
+    for (i = 0;; i++)
+    {
+        if (indefinite)
+        {
+            if (d->p == d->end)
+                break;
+            if (*d->p == 0xFF)
+            {
+                d->p++;
+                return DIANA_PARSE_OK;
+            }
+        }
+        else if (i == u)
+            return DIANA_PARSE_OK;
+        if (major == 4)
+            ret = diana_decode_cbor_value(d, diana_pushback_array_element_alloc(v, d->c.a));
+        else
+        {
+            const char *k;
+            size_t klen;
+            unsigned head;
+            if (d->p == d->end || ((head = *d->p++) >> 5) != 3)
+                ret = DIANA_PARSE_INVALID_BINARY;
+            else if ((ret = diana_decode_cbor_string(d, 3, head & 0x1F, &k, &klen)) == DIANA_PARSE_OK)
+                ret = diana_decode_cbor_value(d, diana_decode_member(v, k, klen, d->c.a));
+        }
+        if (ret != DIANA_PARSE_OK)
+        {
+            diana_free_alloc(v, d->c.a);
+            return ret;
+        }
+    }
+    diana_free_alloc(v, d->c.a);
+    return DIANA_PARSE_INVALID_BINARY;
+}
+
+static int diana_decode_cbor_container(diana_decoder *d, diana_value *v, unsigned major, unsigned ai)
+{
+    int ret;
+    if (d->depth == DIANA_PARSE_MAX_DEPTH)
+        return DIANA_PARSE_DEPTH_EXCEEDED;
+    d->depth++;
+    ret = diana_decode_cbor_items(d, v, major, ai);
+    d->depth--;
+    return ret;
+}
+
+static int diana_decode_cbor_value(diana_decoder *d, diana_value *v)
+{
+    unsigned head, major, ai;
+    uint64_t u;
+    const char *s;
+    size_t len;
+    int ret;
+next:
+    DECODE_NEED(d, 1);
+    head = *d->p++;
+    major = head >> 5;
+    ai = head & 0x1F;
+    switch (major)
+    {
+    case 0: /* 无符号整数 */
+    case 1: /* 负整数 */
+        if ((ret = diana_decode_cbor_argument(d, ai, &u)) != DIANA_PARSE_OK)
+            return ret;
+        diana_set_number_alloc(v, major == 0 ? (double)u : -1.0 - (double)u, d->c.a);
+        return DIANA_PARSE_OK;
+    case 2: /* 字节串按字符串处理 */
+    case 3:
+        if ((ret = diana_decode_cbor_string(d, major, ai, &s, &len)) != DIANA_PARSE_OK)
+            return ret;
+        diana_set_string_alloc(v, s, len, d->c.a);
+        return DIANA_PARSE_OK;
+    case 4:
+    case 5:
+        return diana_decode_cbor_container(d, v, major, ai);
+    case 6: /* 忽略标签，解码被标记的值；循环处理以免标签链过长时递归过深 */
+        if ((ret = diana_decode_cbor_argument(d, ai, &u)) != DIANA_PARSE_OK)
+            return ret;
+        goto next;
+    default:
+        switch (ai)
+        {
+        case 20:
+            diana_set_boolean_alloc(v, 0, d->c.a);
+            return DIANA_PARSE_OK;
+        case 21:
+            diana_set_boolean_alloc(v, 1, d->c.a);
+            return DIANA_PARSE_OK;
+        case 22:
+        case 23:
+            diana_free_alloc(v, d->c.a);
+            return DIANA_PARSE_OK;
+        case 25:
+        case 26:
+        case 27:
+            if ((ret = diana_decode_be(d, (size_t)1 << (ai - 24), &u)) != DIANA_PARSE_OK)
+                return ret;
+            diana_set_number_alloc(v, ai == 25 ? diana_half_to_double((unsigned)u) : ai == 26 ? diana_float_from_bits(u) : diana_double_from_bits(u), d->c.a);
+            return DIANA_PARSE_OK;
+        default:
+            return DIANA_PARSE_INVALID_BINARY;
+        }
+    }
+}
+
+/* 读取MessagePack字符串头（fixstr/str/bin），返回指向输入的指针 */
+static int diana_decode_msgpack_string(diana_decoder *d, unsigned head, const char **s, size_t *len)
+{
+    uint64_t u;
+    int ret = DIANA_PARSE_OK;
+    if ((head & 0xE0) == 0xA0)
+        u = head & 0x1F;
+    else if (head == 0xC4 || head == 0xD9)
+        ret = diana_decode_be(d, 1, &u);
+    else if (head == 0xC5 || head == 0xDA)
+        ret = diana_decode_be(d, 2, &u);
+    else if (head == 0xC6 || head == 0xDB)
+        ret = diana_decode_be(d, 4, &u);
+    else
+        return DIANA_PARSE_INVALID_BINARY;
+    if (ret != DIANA_PARSE_OK)
+        return ret;
+    DECODE_NEED(d, u);
+    *s = (const char *)d->p;
+    *len = (size_t)u;
+    d->p += u;
+    return DIANA_PARSE_OK;
+}
+
+static int diana_decode_msgpack_value(diana_decoder *d, diana_value *v);
+
+static int diana_decode_msgpack_items(diana_decoder *d, diana_value *v, int object, uint64_t size)
+{
+    uint64_t i;
+    int ret;
+    DECODE_NEED(d, size); /* 每个元素至少一个字节 */
+    if (object)
+        DECODE_NEED(d, size * 2);
+    if (object)
+        diana_set_object_alloc(v, (size_t)size, d->c.a);
+    else
+        diana_set_array_alloc(v, (size_t)size, d->c.a);
+    for (i = 0; i < size; i++)
+    {
+        if (object)
+        {
+            const char *k;
+            size_t klen;
+            if (d->p == d->end)
+                ret = DIANA_PARSE_INVALID_BINARY;
+            else if ((ret = diana_decode_msgpack_string(d, *d->p++, &k, &klen)) == DIANA_PARSE_OK)
+                ret = diana_decode_msgpack_value(d, diana_decode_member(v, k, klen, d->c.a));
+        }
+        else
+            ret = diana_decode_msgpack_value(d, diana_pushback_array_element_alloc(v, d->c.a));
+        if (ret != DIANA_PARSE_OK)
+        {
+            diana_free_alloc(v, d->c.a);
+            return ret;
+        }
+    }
+    return DIANA_PARSE_OK;
+}
+
+static int diana_decode_msgpack_container(diana_decoder *d, diana_value *v, int object, uint64_t size)
+{
+    int ret;
+    if (d->depth == DIANA_PARSE_MAX_DEPTH)
+        return DIANA_PARSE_DEPTH_EXCEEDED;
+    d->depth++;
+    ret = diana_decode_msgpack_items(d, v, object, size);
+    d->depth--;
+    return ret;
+}
+
+static int diana_decode_msgpack_value(diana_decoder *d, diana_value *v)
+{
+    unsigned head;
+    uint64_t u;
+    const char *s;
+    size_t len, bytes;
+    int ret;
+    DECODE_NEED(d, 1);
+    head = *d->p++;
+    if (head <= 0x7F) /* positive fixint */
+    {
+        diana_set_number_alloc(v, head, d->c.a);
+        return DIANA_PARSE_OK;
+    }
+    if (head >= 0xE0) /* negative fixint */
+    {
+        diana_set_number_alloc(v, (int)head - 0x100, d->c.a);
+        return DIANA_PARSE_OK;
+    }
+    if ((head & 0xF0) == 0x90)
+        return diana_decode_msgpack_container(d, v, 0, head & 0x0F);
+    if ((head & 0xF0) == 0x80)
+        return diana_decode_msgpack_container(d, v, 1, head & 0x0F);
+    switch (head)
+    {
+    case 0xC0:
+        diana_free_alloc(v, d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xC2:
+        diana_set_boolean_alloc(v, 0, d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xC3:
+        diana_set_boolean_alloc(v, 1, d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xCA:
+    case 0xCB:
+        if ((ret = diana_decode_be(d, head == 0xCA ? 4 : 8, &u)) != DIANA_PARSE_OK)
+            return ret;
+        diana_set_number_alloc(v, head == 0xCA ? diana_float_from_bits(u) : diana_double_from_bits(u), d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xCC:
+    case 0xCD:
+    case 0xCE:
+    case 0xCF:
+        if ((ret = diana_decode_be(d, (size_t)1 << (head - 0xCC), &u)) != DIANA_PARSE_OK)
+            return ret;
+        diana_set_number_alloc(v, (double)u, d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3:
+        bytes = (size_t)1 << (head - 0xD0);
+        if ((ret = diana_decode_be(d, bytes, &u)) != DIANA_PARSE_OK)
+            return ret;
+        if (bytes < 8 && (u >> (bytes * 8 - 1))) /* 符号扩展 */
+            u |= ~(uint64_t)0 << (bytes * 8);
+        diana_set_number_alloc(v, (double)(int64_t)u, d->c.a);
+        return DIANA_PARSE_OK;
+    case 0xDC:
+    case 0xDD:
+    case 0xDE:
+    case 0xDF:
+        if ((ret = diana_decode_be(d, (head & 1) ? 4 : 2, &u)) != DIANA_PARSE_OK)
+            return ret;
+        return diana_decode_msgpack_container(d, v, head >= 0xDE, u);
+    default: /* str/bin按字符串处理，不支持ext */
+        if ((ret = diana_decode_msgpack_string(d, head, &s, &len)) != DIANA_PARSE_OK)
+            return ret;
+        diana_set_string_alloc(v, s, len, d->c.a);
+        return DIANA_PARSE_OK;
+    }
+}
+
+static int diana_decode(diana_value *v, const char *data, size_t length, const diana_allocator *a, int (*decode)(diana_decoder *, diana_value *))
+{
+    diana_decoder d;
+    int ret;
+    assert(v != NULL && (data != NULL || length == 0));
+    d.p = (const unsigned char *)data;
+    d.end = d.p + length;
+    d.depth = 0;
+    d.c.stack = NULL;
+    d.c.size = d.c.top = 0;
+    d.c.a = DIANA_ALLOCATOR(a);
+    diana_init(v);
+    if ((ret = decode(&d, v)) == DIANA_PARSE_OK && d.p != d.end)
+    {
+        diana_free_alloc(v, d.c.a);
+        ret = DIANA_PARSE_ROOT_NOT_SINGULAR;
+    }
+    assert(d.c.top == 0);
+    free(d.c.stack);
+    return ret;
+}
+
+int diana_decode_cbor(diana_value *v, const char *data, size_t length)
+{
+    return diana_decode(v, data, length, NULL, diana_decode_cbor_value);
+}
+
+int diana_decode_cbor_alloc(diana_value *v, const char *data, size_t length, const diana_allocator *a)
+{
+    return diana_decode(v, data, length, a, diana_decode_cbor_value);
+}
+
+int diana_decode_msgpack(diana_value *v, const char *data, size_t length)
+{
+    return diana_decode(v, data, length, NULL, diana_decode_msgpack_value);
+}
+
+int diana_decode_msgpack_alloc(diana_value *v, const char *data, size_t length, const diana_allocator *a)
+{
+    return diana_decode(v, data, length, a, diana_decode_msgpack_value);
+}
+
+/* 线性（bump）分配器：在块内顺序分配，释放为空操作，由diana_arena_reset整体回收 */
+typedef struct diana_arena_block diana_arena_block;
+
+struct diana_arena_block
+{
+    diana_arena_block *next;
+    size_t size, used;
+};
+
+struct diana_arena
+{
+    diana_allocator a;
+    diana_arena_block *head; // 当前块，next指向更早的块
+    size_t block_size;
+    void *last; // 最近一次分配，realloc时可原地扩展
+};
+
+#define DIANA_ARENA_ALIGN 8
+#define DIANA_ARENA_HEADER ((sizeof(diana_arena_block) + DIANA_ARENA_ALIGN - 1) & ~(size_t)(DIANA_ARENA_ALIGN - 1))
+#define DIANA_ARENA_DATA(b) ((char *)(b) + DIANA_ARENA_HEADER)
+
+static void *diana_arena_alloc(void *user, size_t size)
+{
+    diana_arena *arena = (diana_arena *)user;
+    diana_arena_block *b = arena->head;
+    size = (size + DIANA_ARENA_ALIGN - 1) & ~(size_t)(DIANA_ARENA_ALIGN - 1);
+    if (b == NULL || b->size - b->used < size)
+    {
+        size_t bsize = size > arena->block_size ? size : arena->block_size;
+        b = (diana_arena_block *)malloc(DIANA_ARENA_HEADER + bsize);
+        b->next = arena->head;
+        b->size = bsize;
+        b->used = 0;
+        arena->head = b;
+    }
+    arena->last = DIANA_ARENA_DATA(b) + b->used;
+    b->used += size;
+    return arena->last;
+}
+
+static void *diana_arena_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    diana_arena *arena = (diana_arena *)user;
+    diana_arena_block *b = arena->head;
+    void *ret;
+    if (ptr == arena->last) // 最近一次分配：在当前块内原地伸缩
+    {
+        size_t offset = (size_t)((char *)ptr - DIANA_ARENA_DATA(b));
+        size_t size = (new_size + DIANA_ARENA_ALIGN - 1) & ~(size_t)(DIANA_ARENA_ALIGN - 1);
+        if (b->size - offset >= size)
+        {
+            b->used = offset + size;
+            return ptr;
+        }
+    }
+    if (new_size <= old_size)
+        return ptr;
+    ret = diana_arena_alloc(user, new_size);
+    memcpy(ret, ptr, old_size);
+    return ret;
+}
+
+diana_arena *diana_arena_create(size_t block_size)
+{
+    diana_arena *arena = (diana_arena *)malloc(sizeof(diana_arena));
+    arena->a.alloc = diana_arena_alloc;
+    arena->a.realloc = diana_arena_realloc;
+    arena->a.free = NULL;
+    arena->a.user = arena;
+    arena->head = NULL;
+    arena->block_size = block_size > 0 ? block_size : DIANA_ARENA_BLOCK_SIZE;
+    arena->last = NULL;
+    return arena;
+}
+
+void diana_arena_destroy(diana_arena *arena)
+{
+    if (arena == NULL)
+        return;
+    diana_arena_reset(arena);
+    free(arena->head);
+    free(arena);
+}
+
+void diana_arena_reset(diana_arena *arena)
+{
+    diana_arena_block *b;
+    assert(arena != NULL);
+    if (arena->head == NULL)
+        return;
+    /* 保留当前块供下次使用，释放其余块 */
+    while ((b = arena->head->next) != NULL)
+    {
+        arena->head->next = b->next;
+        free(b);
+    }
+    arena->head->used = 0;
+    arena->last = NULL;
+}
+
+const diana_allocator *diana_arena_allocator(diana_arena *arena)
+{
+    assert(arena != NULL);
+    return &arena->a;
+}
+
+static void *diana_counter_alloc(void *user, size_t size)
+{
+    diana_alloc_counter *counter = (diana_alloc_counter *)user;
+    counter->allocations++;
+    counter->bytes += (int64_t)size;
+    if (counter->bytes > counter->peak)
+        counter->peak = counter->bytes;
+    return counter->base->alloc(counter->base->user, size);
+}
+
+static void *diana_counter_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    diana_alloc_counter *counter = (diana_alloc_counter *)user;
+    counter->allocations++;
+    counter->frees++;
+    counter->bytes += (int64_t)new_size - (int64_t)old_size;
+    if (counter->bytes > counter->peak)
+        counter->peak = counter->bytes;
+    return counter->base->realloc(counter->base->user, ptr, old_size, new_size);
+}
+
+static void diana_counter_free(void *user, void *ptr, size_t size)
+{
+    diana_alloc_counter *counter = (diana_alloc_counter *)user;
+    counter->frees++;
+    counter->bytes -= (int64_t)size;
+    counter->base->free(counter->base->user, ptr, size);
+}
+
+const diana_allocator *diana_alloc_counter_init(diana_alloc_counter *counter, const diana_allocator *base)
+{
+    assert(counter != NULL);
+    counter->base = DIANA_ALLOCATOR(base);
+    counter->allocator.alloc = diana_counter_alloc;
+    counter->allocator.realloc = diana_counter_realloc;
+    counter->allocator.free = counter->base->free != NULL ? diana_counter_free : NULL; // 保持arena不逐个释放的语义
+    counter->allocator.user = counter;
+    diana_alloc_counter_reset(counter);
+    return &counter->allocator;
+}
+
+void diana_alloc_counter_reset(diana_alloc_counter *counter)
+{
+    assert(counter != NULL);
+    counter->allocations = counter->frees = 0;
+    counter->bytes = counter->peak = 0;
+}
+
+/* 统计一个值自身的堆内存，嵌套的数组与对象压入堆栈稍后展开 */
+static void diana_memory_child(diana_context *c, const diana_value *v, diana_memory *usage)
+{
+    usage->nodes[DIANA_TYPE(v)]++;
+    if (DIANA_TYPE(v) == DIANA_STRING && !DIANA_IS_SHORT(DIANA_SIZE(v)))
+        usage->bytes += DIANA_STRING_BYTES(DIANA_SIZE(v));
+    else if (DIANA_TYPE(v) == DIANA_ARRAY || DIANA_TYPE(v) == DIANA_OBJECT)
+        *(const diana_value **)diana_context_push(c, sizeof(const diana_value *)) = v;
+}
+
+void diana_memory_usage(const diana_value *v, diana_memory *usage)
+{
+    diana_context c;
+    size_t i;
+    assert(v != NULL && usage != NULL);
+    memset(usage, 0, sizeof(diana_memory));
+    c.stack = NULL;
+    c.size = c.top = 0;
+    diana_memory_child(&c, v, usage);
+    while (c.top != 0)
+    {
+        v = *(const diana_value **)diana_context_pop(&c, sizeof(const diana_value *));
+        if (v->u.e == NULL)
+            continue;
+        if (DIANA_TYPE(v) == DIANA_ARRAY)
+        {
+            usage->bytes += sizeof(diana_container) + DIANA_CAPACITY(v) * sizeof(diana_value);
+            for (i = 0; i < DIANA_SIZE(v); i++)
+                diana_memory_child(&c, &v->u.e[i], usage);
+        }
+        else
+        {
+            usage->bytes += sizeof(diana_container) + DIANA_CAPACITY(v) * sizeof(diana_member);
+            if (DIANA_INDEX(v) != NULL)
+                usage->bytes += diana_index_bytes(DIANA_INDEX(v));
+            for (i = 0; i < DIANA_SIZE(v); i++)
+            {
+                usage->bytes += v->u.m[i].klen + 1;
+                diana_memory_child(&c, &v->u.m[i].v, usage);
+            }
+        }
+    }
+    free(c.stack);
+}
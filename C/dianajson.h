@@ -2,6 +2,12 @@
 #define DIANAJSON_H
 
 #include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h>  /* FILE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* Json 7种数据类型 */
 /* 使用项目简写作为标识符的前缀（C无CPP命名空间功能） */
@@ -18,35 +24,46 @@ typedef enum
 
 #define DIANA_KEY_NOT_EXIST ((size_t)-1)
 
+/* 使用者可在编译选项中自行设置DIANA_PARSE_MAX_DEPTH宏，限制数组与对象的嵌套深度 */
+#ifndef DIANA_PARSE_MAX_DEPTH
+#define DIANA_PARSE_MAX_DEPTH 1024
+#endif
+
+/* 使用者可在编译选项中设置DIANA_PARSE_VALIDATE_UTF8为0，关闭解析字符串时的UTF-8校验 */
+#ifndef DIANA_PARSE_VALIDATE_UTF8
+#define DIANA_PARSE_VALIDATE_UTF8 1
+#endif
+
+/* 使用者可在编译选项中自行设置DIANA_STRINGIFY_BUFFER_SIZE宏，流式生成器的缓冲区大小（位于调用栈上），最小为64 */
+/* 小于1536时字符串按更短的段转义，缓冲区越小调用sink越频繁 */
+#ifndef DIANA_STRINGIFY_BUFFER_SIZE
+#define DIANA_STRINGIFY_BUFFER_SIZE 4096
+#endif
+#if DIANA_STRINGIFY_BUFFER_SIZE < 64
+#error "DIANA_STRINGIFY_BUFFER_SIZE must be at least 64"
+#endif
+
 /* JSON数据结构 */
 /* 树形结构 */
 typedef struct diana_value diana_value;
 typedef struct diana_member diana_member;
 
+/* 长度不超过DIANA_SHORT_STRING_SIZE - 1的字符串直接存放在值内（含'\0'） */
+#define DIANA_SHORT_STRING_SIZE 8
+
+/* 紧凑布局：8字节的数据加8字节的标签，共16字节 */
+/* 数组与对象的容量（以及对象的哈希索引、引用计数）存放在元素（成员）之前的堆块头部 */
 struct diana_value
 {
     union
     {
-        struct /* member */
-        {
-            diana_member *m;
-            size_t size;     // member count
-            size_t capacity; // capacity
-        } o;
-        struct /* array */
-        {
-            diana_value *e;
-            size_t size;     // element count
-            size_t capacity; // capacity
-        } a;
-        struct /* string */
-        {
-            char *s;
-            size_t len;
-        } s;
-        double n; /* number */
+        double n;                          /* number */
+        char *s;                           /* string，长度不小于DIANA_SHORT_STRING_SIZE时在堆上 */
+        char ss[DIANA_SHORT_STRING_SIZE];  /* 短字符串 */
+        diana_value *e;                    /* array elements */
+        diana_member *m;                   /* object members */
     } u;
-    diana_type type;
+    uint64_t tag; /* 低8位为diana_type，其余位为字符串长度、元素数或成员数 */
 }; // 树形结构的每个节点使用diana_value表示，也称它为一个值（JSON Value）。
 
 struct diana_member
@@ -74,18 +91,38 @@ enum
     DIANA_PARSE_MISS_KEY,
     DIANA_PARSE_MISS_COLON,
     DIANA_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    DIANA_PARSE_INVALID_BINARY, // 二进制数据截断、格式非法或含不支持的类型
+    DIANA_PARSE_DEPTH_EXCEEDED, // 嵌套深度超过DIANA_PARSE_MAX_DEPTH
+    DIANA_PARSE_INVALID_UTF8,   // 字符串不是合法的UTF-8（过长编码、代理项、超出U+10FFFF或截断的序列）
     DIANA_STRINGIFY_OK
 };
 
-#define diana_init(v)           \
-    do                          \
-    {                           \
-        (v)->type = DIANA_NULL; \
+/* 自定义分配器，由各_alloc函数传入（为NULL时使用malloc/realloc/free） */
+/* realloc与free额外获得原有字节数；free为NULL时视为不逐个释放，diana_free_alloc直接返回而不遍历子节点 */
+typedef struct
+{
+    void *(*alloc)(void *user, size_t size);
+    void *(*realloc)(void *user, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(void *user, void *ptr, size_t size);
+    void *user;
+} diana_allocator;
+
+#define diana_init(v)          \
+    do                         \
+    {                          \
+        (v)->tag = DIANA_NULL; \
     } while (0) // 初始化类型
 
 /* JSON解析 */
 int diana_parse(diana_value *v, const char *json); // 解析JSON，根节点指针v是由使用方负责分配
 
+/* 可复用的解析器，在多次解析之间保留堆栈容量，稳定状态下解析不再分配临时内存 */
+typedef struct diana_parser diana_parser;
+diana_parser *diana_parser_create(void);
+void diana_parser_destroy(diana_parser *p);
+void diana_parser_reset(diana_parser *p);                                // 释放保留的堆栈
+int diana_parse_with(diana_parser *p, diana_value *v, const char *json); // 同diana_parse
+
 /* 释放数据 */
 void diana_free(diana_value *v);
 
@@ -121,6 +158,8 @@ diana_value *diana_pushback_array_element(diana_value *v);                  // 
 void diana_popback_array_element(diana_value *v);                           // 删去数组末端元素
 diana_value *diana_insert_array_element(diana_value *v, size_t index);      // 在index位置插入一个元素，返回新的元素指针
 void diana_erase_array_element(diana_value *v, size_t index, size_t count); // 删去在index位置开始共count个元素（不改变容量）
+void diana_swap_remove_array_element(diana_value *v, size_t index);         // 删去index位置的元素，由末端元素填补（不保持顺序）
+void diana_append_array_elements(diana_value *v, diana_value *values, size_t count); // 将values中的count个值移动到数组末端，values随后均为null
 void diana_clear_array(diana_value *v);                                     // 清除所有元素（不改变容量）
 
 /* 对象类型 */
@@ -134,13 +173,26 @@ const char *diana_get_object_key(const diana_value *v, size_t index);
 size_t diana_get_object_key_length(const diana_value *v, size_t index);
 diana_value *diana_get_object_value(const diana_value *v, size_t index);
 size_t diana_find_object_index(const diana_value *v, const char *key, size_t klen);
-diana_value *diana_find_object_value(diana_value *v, const char *key, size_t klen);
+diana_value *diana_find_object_value(diana_value *v, const char *key, size_t klen); // 返回可写入的值指针，对象被共享时先复制（写时复制）
 diana_value *diana_set_object_value(diana_value *v, const char *key, size_t klen); // 设置键值对，先搜寻是否存在现有的键，若存在则直接返回该值的指针，不存在时才新增。
 void diana_remove_object_value(diana_value *v, size_t index);
+void diana_erase_object_value(diana_value *v, size_t index, size_t count); // 删去在index位置开始共count个成员（保持顺序，不改变容量）
+void diana_swap_remove_object_value(diana_value *v, size_t index);         // 删去index位置的成员，由末端成员填补（不保持顺序）
+
+/* 对象构造模式：追加成员时不检查重复键，全部追加后调用一次diana_check_object_keys检查 */
+diana_value *diana_append_object_value(diana_value *v, const char *key, size_t klen);
+size_t diana_check_object_keys(const diana_value *v); // 返回第一个重复键（非首次出现）的下标，无重复时返回DIANA_KEY_NOT_EXIST
 
-/* 深度复制 */
+/* 深度复制（以DIANA_COPY_SHARED=1编译时为共享复制） */
 void diana_copy(diana_value *dst, const diana_value *src);
 
+/* 共享复制：dst与src以引用计数共享堆上的字符串与容器，复杂度O(1)，diana_free只减少引用计数 */
+/* 修改接口在写入共享的数组（对象）前只复制该节点本身（写时复制），子节点继续共享 */
+/* diana_get_array_element/diana_get_object_value返回的指针只读，写入前先对其容器调用diana_unshare */
+/* 引用计数不是原子的，共享同一节点的值不可在多个线程中同时复制、修改或释放 */
+void diana_copy_shared(diana_value *dst, const diana_value *src);
+void diana_unshare(diana_value *v); // 使v的数组（对象）堆块为当前值独占
+
 /* move */
 void diana_move(diana_value *dst, diana_value *src);
 
@@ -150,4 +202,114 @@ void diana_swap(diana_value *lhs, diana_value *rhs);
 /* 生成器 */
 char *diana_stringify(const diana_value *v, size_t *length);
 
+/* 可复用的生成器，结果写入内部缓冲区（以'\0'结尾），在下一次调用、reset或destroy之前有效，不需free */
+typedef struct diana_writer diana_writer;
+diana_writer *diana_writer_create(void);
+void diana_writer_destroy(diana_writer *w);
+void diana_writer_reset(diana_writer *w); // 释放保留的缓冲区
+const char *diana_stringify_with(diana_writer *w, const diana_value *v, size_t *length);
+
+/* 流式生成器：文本经固定大小的缓冲区分段交给sink（不含'\0'），峰值内存与文档大小无关 */
+/* sink返回非零值时停止生成并返回该值，全部写出时返回0 */
+typedef int (*diana_sink)(void *user, const char *data, size_t length);
+int diana_stringify_to(const diana_value *v, diana_sink sink, void *user);
+int diana_stringify_file(const diana_value *v, FILE *fp); // 写入失败时返回EOF
+
+/* 二进制编解码（CBOR/MessagePack） */
+/* 编码结果由使用方free，length返回字节数；解码时字节串按字符串处理，对象键必须为字符串，末尾多余字节返回DIANA_PARSE_ROOT_NOT_SINGULAR */
+char *diana_encode_cbor(const diana_value *v, size_t *length);
+int diana_decode_cbor(diana_value *v, const char *data, size_t length);
+char *diana_encode_msgpack(const diana_value *v, size_t *length);
+int diana_decode_msgpack(diana_value *v, const char *data, size_t length);
+
+/* 使用自定义分配器的版本，同一个值（含其子节点）的分配、修改与释放须使用同一个分配器 */
+/* 解析时的临时堆栈始终使用malloc */
+int diana_parse_alloc(diana_value *v, const char *json, const diana_allocator *a);
+int diana_parse_with_alloc(diana_parser *p, diana_value *v, const char *json, const diana_allocator *a);
+void diana_free_alloc(diana_value *v, const diana_allocator *a);
+void diana_set_boolean_alloc(diana_value *v, int b, const diana_allocator *a);
+void diana_set_number_alloc(diana_value *v, double n, const diana_allocator *a);
+void diana_set_string_alloc(diana_value *v, const char *s, size_t len, const diana_allocator *a);
+void diana_set_array_alloc(diana_value *v, size_t capacity, const diana_allocator *a);
+void diana_reserve_array_alloc(diana_value *v, size_t capacity, const diana_allocator *a);
+void diana_shrink_array_alloc(diana_value *v, const diana_allocator *a);
+diana_value *diana_pushback_array_element_alloc(diana_value *v, const diana_allocator *a);
+void diana_popback_array_element_alloc(diana_value *v, const diana_allocator *a);
+diana_value *diana_insert_array_element_alloc(diana_value *v, size_t index, const diana_allocator *a);
+void diana_erase_array_element_alloc(diana_value *v, size_t index, size_t count, const diana_allocator *a);
+void diana_swap_remove_array_element_alloc(diana_value *v, size_t index, const diana_allocator *a);
+void diana_append_array_elements_alloc(diana_value *v, diana_value *values, size_t count, const diana_allocator *a);
+void diana_clear_array_alloc(diana_value *v, const diana_allocator *a);
+void diana_set_object_alloc(diana_value *v, size_t capacity, const diana_allocator *a);
+void diana_reserve_object_alloc(diana_value *v, size_t capacity, const diana_allocator *a);
+void diana_shrink_object_alloc(diana_value *v, const diana_allocator *a);
+void diana_clear_object_alloc(diana_value *v, const diana_allocator *a);
+diana_value *diana_find_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a);
+diana_value *diana_set_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a);
+void diana_remove_object_value_alloc(diana_value *v, size_t index, const diana_allocator *a);
+void diana_erase_object_value_alloc(diana_value *v, size_t index, size_t count, const diana_allocator *a);
+void diana_swap_remove_object_value_alloc(diana_value *v, size_t index, const diana_allocator *a);
+diana_value *diana_append_object_value_alloc(diana_value *v, const char *key, size_t klen, const diana_allocator *a);
+void diana_copy_alloc(diana_value *dst, const diana_value *src, const diana_allocator *a);
+void diana_copy_shared_alloc(diana_value *dst, const diana_value *src, const diana_allocator *a);
+void diana_unshare_alloc(diana_value *v, const diana_allocator *a);
+void diana_move_alloc(diana_value *dst, diana_value *src, const diana_allocator *a);
+int diana_decode_cbor_alloc(diana_value *v, const char *data, size_t length, const diana_allocator *a);
+int diana_decode_msgpack_alloc(diana_value *v, const char *data, size_t length, const diana_allocator *a);
+
+/* 线性（bump）分配器：按块顺序分配，释放为空操作，diana_arena_reset整体回收全部分配 */
+typedef struct diana_arena diana_arena;
+diana_arena *diana_arena_create(size_t block_size); // block_size为0时使用DIANA_ARENA_BLOCK_SIZE
+void diana_arena_destroy(diana_arena *arena);
+void diana_arena_reset(diana_arena *arena); // 保留一块内存供复用，此前分配的值全部失效
+const diana_allocator *diana_arena_allocator(diana_arena *arena);
+
+/* 分配统计：包装另一个分配器（NULL为malloc），统计经它进行的分配与释放，realloc计为一次分配与一次释放 */
+/* 解析与生成时的临时堆栈始终使用malloc，不计入 */
+typedef struct
+{
+    diana_allocator allocator; /* 传给_alloc函数的分配器 */
+    const diana_allocator *base;
+    size_t allocations, frees;
+    int64_t bytes; /* 当前占用相对开始（reset）时的变化，释放此前分配的内存时可为负 */
+    int64_t peak;  /* bytes的最大值 */
+} diana_alloc_counter;
+const diana_allocator *diana_alloc_counter_init(diana_alloc_counter *counter, const diana_allocator *base);
+void diana_alloc_counter_reset(diana_alloc_counter *counter); // 各项清零，此后的统计相对于当前占用
+
+/* 内存占用：值所持有的堆内存字节数（字符串、键、数组与对象的堆块及哈希索引，不含v本身）与各类型的值的个数 */
+/* 共享复制得到的堆块按引用分别计入 */
+typedef struct
+{
+    size_t bytes;
+    size_t nodes[DIANA_OBJECT + 1]; /* 以diana_type为下标 */
+} diana_memory;
+void diana_memory_usage(const diana_value *v, diana_memory *usage);
+
+/* 使用者可在编译选项中设置DIANA_PARSE_STATS=1，解析时统计文档的形状；为0（默认）时统计代码不参与编译 */
+#ifndef DIANA_PARSE_STATS
+#define DIANA_PARSE_STATS 0
+#endif
+
+#if DIANA_PARSE_STATS
+typedef struct
+{
+    size_t bytes;                    /* 消耗的字节数，出错时为出错的位置 */
+    size_t values[DIANA_OBJECT + 1]; /* 各类型的值的个数，以diana_type为下标，不含对象的键 */
+    size_t keys;                     /* 对象键的个数 */
+    size_t string_bytes;             /* 字符串与键解码后的字节数 */
+    size_t escapes;                  /* 转义序列数（含\u） */
+    size_t unicode_escapes;          /* \u转义数，代理对计为2 */
+    size_t max_depth;                /* 数组与对象的最大嵌套深度 */
+    size_t largest_container;        /* 数组元素数与对象成员数的最大值 */
+    double seconds;                  /* 解析所用的处理器时间（clock()） */
+} diana_parse_stats;
+int diana_parse_alloc_stats(diana_value *v, const char *json, const diana_allocator *a, diana_parse_stats *stats); // 同diana_parse_alloc，并填写stats
+const diana_parse_stats *diana_parser_stats(const diana_parser *p);                                             // 最近一次diana_parse_with的统计
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* DIANAJSON_H */
\ No newline at end of file
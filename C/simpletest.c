@@ -8,40 +8,42 @@ int main()
     diana_value v1;
     diana_init(&v1);
     diana_parse(&v1, "{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":\"3\"}}");
-    printf("Json Size:%zu, Capacity:%zu\n", v1.u.o.size, v1.u.o.capacity);
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "n", 1))->type == DIANA_NULL)
+    printf("Json Size:%zu, Capacity:%zu\n", diana_get_object_size(&v1), diana_get_object_capacity(&v1));
+    if (diana_get_type(diana_find_object_value(&v1, "n", 1)) == DIANA_NULL)
         printf("First value is NULL\n");
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "f", 1))->type == DIANA_FALSE)
+    if (diana_get_type(diana_find_object_value(&v1, "f", 1)) == DIANA_FALSE)
         printf("Second value is FALSE\n");
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "t", 1))->type == DIANA_TRUE)
+    if (diana_get_type(diana_find_object_value(&v1, "t", 1)) == DIANA_TRUE)
         printf("Third value is TRUE\n");
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "i", 1))->type == DIANA_NUMBER)
+    if (diana_get_type(diana_find_object_value(&v1, "i", 1)) == DIANA_NUMBER)
     {
-        printf("Forth value is NUMBER:%f\n", diana_find_object_value(&v1, "i", 1)->u.n);
+        printf("Forth value is NUMBER:%f\n", diana_get_number(diana_find_object_value(&v1, "i", 1)));
     }
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "s", 1))->type == DIANA_STRING)
+    if (diana_get_type(diana_find_object_value(&v1, "s", 1)) == DIANA_STRING)
     {
-        printf("Fifth value is STRING:%s, LEN:%zu\n", diana_find_object_value(&v1, "s", 1)->u.s.s, diana_find_object_value(&v1, "s", 1)->u.s.len);
+        printf("Fifth value is STRING:%s, LEN:%zu\n", diana_get_string(diana_find_object_value(&v1, "s", 1)), diana_get_string_length(diana_find_object_value(&v1, "s", 1)));
     }
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "a", 1))->type == DIANA_ARRAY)
+    if (diana_get_type(diana_find_object_value(&v1, "a", 1)) == DIANA_ARRAY)
     {
-        printf("Sixth value is ARRAY, SIZE:%zu; ", diana_find_object_value(&v1, "a", 1)->u.a.size);
+        printf("Sixth value is ARRAY, SIZE:%zu; ", diana_get_array_size(diana_find_object_value(&v1, "a", 1)));
         printf("[");
-        for (size_t i = 0; i < diana_find_object_value(&v1, "a", 1)->u.a.size; i++)
+        for (size_t i = 0; i < diana_get_array_size(diana_find_object_value(&v1, "a", 1)); i++)
         {
-            printf("%f,", diana_find_object_value(&v1, "a", 1)->u.a.e[i].u.n);
+            printf("%f,", diana_get_number(diana_get_array_element(diana_find_object_value(&v1, "a", 1), i)));
         }
         printf("]\n");
     }
-    if (diana_get_object_value(&v1, diana_find_object_index(&v1, "o", 1))->type == DIANA_OBJECT)
+    if (diana_get_type(diana_find_object_value(&v1, "o", 1)) == DIANA_OBJECT)
     {
-        printf("Seventh value is OBJECT, SIZE:%zu\n", diana_find_object_value(&v1, "s", 1)->u.o.size);
+        printf("Seventh value is OBJECT, SIZE:%zu\n", diana_get_object_size(diana_find_object_value(&v1, "o", 1)));
         printf("{");
-        for (size_t i = 0; i < diana_find_object_value(&v1, "o", 1)->u.o.size - 1; i++)
+        diana_value *o = diana_find_object_value(&v1, "o", 1);
+        size_t last = diana_get_object_size(o) - 1;
+        for (size_t i = 0; i < last; i++)
         {
-            printf("%s:%f,", diana_find_object_value(&v1, "o", 1)->u.o.m[i].k, diana_find_object_value(&v1, "o", 1)->u.o.m[i].v.u.n);
+            printf("%s:%f,", diana_get_object_key(o, i), diana_get_number(diana_get_object_value(o, i)));
         }
-        printf("%s:%s,", diana_find_object_value(&v1, "o", 1)->u.o.m[diana_find_object_value(&v1, "o", 1)->u.o.size - 1].k, diana_find_object_value(&v1, "o", 1)->u.o.m[diana_find_object_value(&v1, "o", 1)->u.o.size - 1].v.u.s.s);
+        printf("%s:%s,", diana_get_object_key(o, last), diana_get_string(diana_get_object_value(o, last)));
         printf("}\n");
     }
 
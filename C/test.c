@@ -282,6 +282,70 @@ static void test_parse_root_not_singular()
     TEST_ERROR(DIANA_PARSE_ROOT_NOT_SINGULAR, "0x123");
 }
 
+/* 以不同的起始偏移与长度插入白空格，覆盖换行加缩进、CRLF、制表符与混合的情况，跨越向量块的边界 */
+static void test_parse_whitespace()
+{
+    static const char ws[] = " \t\n\r";
+    unsigned seed = 2025;
+    char json[512];
+    size_t i, k, len;
+
+    for (i = 0; i < 2000; i++)
+    {
+        diana_value v;
+        size_t n = i % 80, j;
+        len = i % 48;
+        memset(json, ' ', len);
+        json[len++] = '[';
+        for (j = 0; j < 4; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            switch (i % 4)
+            {
+            case 0: /* 换行后接n个空格 */
+                json[len++] = '\n';
+                memset(json + len, ' ', n);
+                len += n;
+                break;
+            case 1: /* CRLF后接n个空格 */
+                json[len++] = '\r';
+                json[len++] = '\n';
+                memset(json + len, ' ', n);
+                len += n;
+                break;
+            case 2: /* 制表符缩进 */
+                json[len++] = '\n';
+                memset(json + len, '\t', n % 12);
+                len += n % 12;
+                break;
+            default: /* 随机混合 */
+                for (k = (seed >> 8) % 80; k > 0; k--)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    json[len++] = ws[(seed >> 16) % 4];
+                }
+                break;
+            }
+            json[len++] = "1,2]"[j];
+        }
+        json[len] = '\0';
+        diana_init(&v);
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));
+        EXPECT_EQ_INT(DIANA_ARRAY, diana_get_type(&v));
+        EXPECT_EQ_SIZE_T(2, diana_get_array_size(&v));
+        diana_free(&v);
+
+        memcpy(json + len, "\n  x", 5);
+        diana_init(&v);
+        EXPECT_EQ_INT(DIANA_PARSE_ROOT_NOT_SINGULAR, diana_parse(&v, json));
+        diana_free(&v);
+        json[len + 3] = '\0';
+        diana_init(&v);
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));
+        diana_free(&v);
+    }
+}
+
 static void test_parse_number_too_big()
 {
     TEST_ERROR(DIANA_PARSE_NUMBER_TOO_BIG, "1e309");
@@ -308,6 +372,93 @@ static void test_parse_invalid_string_char()
     TEST_ERROR(DIANA_PARSE_INVALID_STRING_CHAR, "\"\x1F\"");
 }
 
+#if DIANA_PARSE_VALIDATE_UTF8
+/* 参照实现：逐个码点解码后检查范围 */
+static int utf8_valid(const unsigned char *s, size_t len)
+{
+    size_t i = 0, n, k;
+    unsigned u;
+    while (i < len)
+    {
+        if (s[i] < 0x80)
+        {
+            i++;
+            continue;
+        }
+        if ((s[i] & 0xE0) == 0xC0)
+            n = 1, u = s[i] & 0x1F;
+        else if ((s[i] & 0xF0) == 0xE0)
+            n = 2, u = s[i] & 0x0F;
+        else if ((s[i] & 0xF8) == 0xF0)
+            n = 3, u = s[i] & 0x07;
+        else
+            return 0;
+        if (i + n >= len)
+            return 0;
+        for (k = 1; k <= n; k++)
+        {
+            if ((s[i + k] & 0xC0) != 0x80)
+                return 0;
+            u = u << 6 | (s[i + k] & 0x3F);
+        }
+        if (u < (n == 1 ? 0x80u : n == 2 ? 0x800u : 0x10000u) || u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF))
+            return 0;
+        i += n + 1;
+    }
+    return 1;
+}
+
+static void test_parse_invalid_utf8()
+{
+    static const char *pieces[] = {"a", "Z", " ", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9D\x84\x9E", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF",
+                                   "\x80", "\xBF", "\xC0", "\xC1\xBF", "\xE0\x80", "\xED\xA0\x80", "\xF0\x80", "\xF4\x90", "\xF5", "\xFF"};
+    unsigned seed = 2024;
+    char json[256];
+    size_t i, k;
+
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\x80\"");
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xC0\xAF\"");             /* 过长编码 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xE0\x80\xAF\"");         /* 过长编码 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");         /* 代理项U+D800 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\"");     /* 超出U+10FFFF */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xE6\x97\"");             /* 截断 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "\"\xC3\\n\xA9\"");          /* 被转义隔断 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "{\"\xFF\":1}");              /* 键 */
+    TEST_ERROR(DIANA_PARSE_INVALID_UTF8, "[\"0123456789abcdef0123456789abcdef\xC3\"]");
+    TEST_STRING("\xEF\xBF\xBF\xF4\x8F\xBF\xBF", "\"\xEF\xBF\xBF\xF4\x8F\xBF\xBF\"");
+
+    /* 随机拼接合法与非法的片段，以不同的起始偏移跨越向量块的边界，与参照实现比较 */
+    for (i = 0; i < 4000; i++)
+    {
+        size_t offset = i % 48, len = offset + 1;
+        diana_value v;
+        memset(json, ' ', offset);
+        json[offset] = '"';
+        seed = seed * 1103515245 + 12345;
+        for (k = (seed >> 8) % 24; k > 0; k--)
+        {
+            const char *piece;
+            seed = seed * 1103515245 + 12345;
+            piece = pieces[(seed >> 16) % (i % 4 == 0 ? sizeof(pieces) / sizeof(pieces[0]) : 8)];
+            memcpy(json + len, piece, strlen(piece));
+            len += strlen(piece);
+        }
+        json[len] = '"';
+        json[len + 1] = '\0';
+        diana_init(&v);
+        if (utf8_valid((const unsigned char *)json + offset + 1, len - offset - 1))
+        {
+            EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));
+            EXPECT_EQ_SIZE_T(len - offset - 1, diana_get_string_length(&v));
+            EXPECT_TRUE(memcmp(json + offset + 1, diana_get_string(&v), len - offset - 1) == 0);
+        }
+        else
+            EXPECT_EQ_INT(DIANA_PARSE_INVALID_UTF8, diana_parse(&v, json));
+        diana_free(&v);
+    }
+}
+#endif
+
 static void test_parse_invalid_unicode_hex()
 {
     TEST_ERROR(DIANA_PARSE_INVALID_UNICODE_HEX, "\"\\u\"");
@@ -381,10 +532,14 @@ static void test_parse()
     test_parse_expect_value();
     test_parse_invalid_value();
     test_parse_root_not_singular();
+    test_parse_whitespace();
     test_parse_number_too_big();
     test_parse_miss_quotation_mark();
     test_parse_invalid_string_escape();
     test_parse_invalid_string_char();
+#if DIANA_PARSE_VALIDATE_UTF8
+    test_parse_invalid_utf8();
+#endif
     test_parse_invalid_unicode_hex();
     test_parse_invalid_unicode_surrogate();
     test_parse_miss_comma_or_square_bracket();
@@ -393,18 +548,49 @@ static void test_parse()
     test_parse_miss_comma_or_curly_bracket();
 }
 
-#define TEST_ROUNDTRIP(json)                                  \
-    do                                                        \
-    {                                                         \
-        diana_value v;                                        \
-        char *json2;                                          \
-        size_t length;                                        \
-        diana_init(&v);                                       \
-        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json)); \
-        json2 = diana_stringify(&v, &length);                 \
-        EXPECT_EQ_STRING(json, json2, length);                \
-        diana_free(&v);                                       \
-        free(json2);                                          \
+/* 收集流式生成器的输出，记录最大分段长度 */
+typedef struct
+{
+    char *data;
+    size_t length, capacity, calls, max_chunk;
+    int fail_at; // 第几次调用时返回错误，0表示不出错
+} test_sink_buffer;
+
+static int test_sink(void *user, const char *data, size_t length)
+{
+    test_sink_buffer *b = (test_sink_buffer *)user;
+    if (++b->calls == (size_t)b->fail_at)
+        return -1;
+    if (b->length + length > b->capacity)
+    {
+        while (b->length + length > b->capacity)
+            b->capacity = b->capacity ? b->capacity * 2 : 256;
+        b->data = (char *)realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+    if (length > b->max_chunk)
+        b->max_chunk = length;
+    return 0;
+}
+
+#define TEST_ROUNDTRIP(json)                                    \
+    do                                                          \
+    {                                                           \
+        diana_value v;                                          \
+        char *json2;                                            \
+        size_t length;                                          \
+        test_sink_buffer b;                                     \
+        memset(&b, 0, sizeof(b));                               \
+        diana_init(&v);                                         \
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));   \
+        json2 = diana_stringify(&v, &length);                   \
+        EXPECT_EQ_STRING(json, json2, length);                  \
+        EXPECT_EQ_INT(0, diana_stringify_to(&v, test_sink, &b)); \
+        EXPECT_EQ_STRING(json, b.data, b.length);               \
+        diana_free(&v);                                         \
+        free(json2);                                            \
+        free(b.data);                                           \
     } while (0)
 
 static void test_stringify_number()
@@ -452,6 +638,70 @@ static void test_stringify_object()
     TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
 }
 
+static void test_stringify_stream()
+{
+    diana_value v, *p;
+    test_sink_buffer b;
+    char *s, *json, *buffer;
+    size_t i, n = 100000, length, deep = 100000;
+    FILE *fp;
+
+    /* 长字符串分段转义，每次交给sink的长度不超过缓冲区 */
+    s = (char *)malloc(n);
+    for (i = 0; i < n; i++)
+        s[i] = "a\"\n\x01"[i % 4];
+    diana_init(&v);
+    diana_set_array(&v, 0);
+    diana_set_string(diana_pushback_array_element(&v), s, n);
+    for (i = 0; i < 1000; i++)
+        diana_set_number(diana_pushback_array_element(&v), i * 0.5);
+    json = diana_stringify(&v, &length);
+    memset(&b, 0, sizeof(b));
+    EXPECT_EQ_INT(0, diana_stringify_to(&v, test_sink, &b));
+    EXPECT_TRUE(length == b.length && memcmp(json, b.data, length) == 0);
+    EXPECT_TRUE(b.calls > 1);
+    EXPECT_TRUE(b.max_chunk < DIANA_STRINGIFY_BUFFER_SIZE);
+    free(b.data);
+
+    /* sink出错时立即停止并返回其错误值 */
+    memset(&b, 0, sizeof(b));
+    b.fail_at = 2;
+    EXPECT_EQ_INT(-1, diana_stringify_to(&v, test_sink, &b));
+    EXPECT_EQ_SIZE_T(2, b.calls);
+    free(b.data);
+
+    /* 写入文件 */
+    if ((fp = tmpfile()) != NULL)
+    {
+        EXPECT_EQ_INT(0, diana_stringify_file(&v, fp));
+        EXPECT_EQ_SIZE_T(length, (size_t)ftell(fp));
+        rewind(fp);
+        buffer = (char *)malloc(length);
+        EXPECT_EQ_SIZE_T(length, fread(buffer, 1, length, fp));
+        EXPECT_TRUE(memcmp(json, buffer, length) == 0);
+        free(buffer);
+        fclose(fp);
+    }
+    free(json);
+    free(s);
+    diana_free(&v);
+
+    /* 生成器不递归，任意深度的嵌套都可以输出 */
+    diana_init(&v);
+    for (p = &v, i = 0; i < deep; i++)
+    {
+        diana_set_object(p, 1);
+        p = diana_set_object_value(p, "k", 1);
+    }
+    memset(&b, 0, sizeof(b));
+    EXPECT_EQ_INT(0, diana_stringify_to(&v, test_sink, &b));
+    EXPECT_EQ_SIZE_T(deep * 6 + 4, b.length);
+    EXPECT_EQ_STRING("{\"k\":{\"k\":", b.data, 10);
+    EXPECT_EQ_STRING("null}}", b.data + deep * 5, 6);
+    free(b.data);
+    diana_free(&v);
+}
+
 static void test_stringify()
 {
     TEST_ROUNDTRIP("null");
@@ -461,6 +711,7 @@ static void test_stringify()
     test_stringify_string();
     test_stringify_array();
     test_stringify_object();
+    test_stringify_stream();
 }
 
 #define TEST_EQUAL(json1, json2, equality)                      \
@@ -545,6 +796,283 @@ static void test_swap()
     diana_free(&v2);
 }
 
+#define TEST_BINARY_ROUNDTRIP(json)                                                             \
+    do                                                                                          \
+    {                                                                                           \
+        diana_value v, v2;                                                                      \
+        char *data;                                                                             \
+        size_t length;                                                                          \
+        diana_init(&v);                                                                         \
+        diana_init(&v2);                                                                        \
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));                                   \
+        data = diana_encode_cbor(&v, &length);                                                  \
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_decode_cbor(&v2, data, length));                    \
+        EXPECT_TRUE(diana_is_equal(&v, &v2));                                                   \
+        diana_free(&v2);                                                                        \
+        while (length-- > 0)                                                                    \
+            EXPECT_EQ_INT(DIANA_PARSE_INVALID_BINARY, diana_decode_cbor(&v2, data, length));    \
+        free(data);                                                                             \
+        data = diana_encode_msgpack(&v, &length);                                               \
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_decode_msgpack(&v2, data, length));                 \
+        EXPECT_TRUE(diana_is_equal(&v, &v2));                                                   \
+        diana_free(&v2);                                                                        \
+        while (length-- > 0)                                                                    \
+            EXPECT_EQ_INT(DIANA_PARSE_INVALID_BINARY, diana_decode_msgpack(&v2, data, length)); \
+        free(data);                                                                             \
+        diana_free(&v);                                                                         \
+        diana_free(&v2);                                                                        \
+    } while (0)
+
+#define TEST_BINARY_ENCODE(expect, json, encode)                  \
+    do                                                            \
+    {                                                             \
+        diana_value v;                                            \
+        char *data;                                               \
+        size_t length;                                            \
+        diana_init(&v);                                           \
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));     \
+        data = encode(&v, &length);                               \
+        EXPECT_EQ_STRING(expect, data, length);                   \
+        free(data);                                               \
+        diana_free(&v);                                           \
+    } while (0)
+
+static void test_binary()
+{
+    diana_value v;
+    TEST_BINARY_ROUNDTRIP("null");
+    TEST_BINARY_ROUNDTRIP("[true,false,0,23,24,255,256,65535,65536,4294967296,-1,-24,-25,-33,-129,-32769,-2147483649]");
+    TEST_BINARY_ROUNDTRIP("[1.5,0.1,-0,1e300,-1.7976931348623157e+308,4.9406564584124654e-324]");
+    TEST_BINARY_ROUNDTRIP("[\"\",\"abc\",\"Hello\\u0000World\",\"0123456789012345678901234567890123456789\"]");
+    TEST_BINARY_ROUNDTRIP("{\"n\":null,\"a\":[1,[2,{}]],\"o\":{\"\":[],\"s\":\"x\"}}");
+
+    TEST_BINARY_ENCODE("\x18\x64", "100", diana_encode_cbor);
+    TEST_BINARY_ENCODE("\x39\x03\xe7", "-1000", diana_encode_cbor);
+    TEST_BINARY_ENCODE("\xfa\x3f\xc0\x00\x00", "1.5", diana_encode_cbor);
+    TEST_BINARY_ENCODE("\xa1\x61\x61\x82\xf5\xf6", "{\"a\":[true,null]}", diana_encode_cbor);
+    TEST_BINARY_ENCODE("\xd0\xdf", "-33", diana_encode_msgpack);
+    TEST_BINARY_ENCODE("\xcd\x01\x00", "256", diana_encode_msgpack);
+    TEST_BINARY_ENCODE("\x81\xa1\x61\x92\xc3\xc0", "{\"a\":[true,null]}", diana_encode_msgpack);
+
+    /* CBOR不定长数组、不定长字符串与半精度浮点数 */
+    diana_init(&v);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_decode_cbor(&v, "\x9f\x7f\x62\x61\x62\x61\x63\xff\xf9\x3c\x00\xff", 12));
+    EXPECT_EQ_SIZE_T(2, diana_get_array_size(&v));
+    EXPECT_EQ_STRING("abc", diana_get_string(diana_get_array_element(&v, 0)), diana_get_string_length(diana_get_array_element(&v, 0)));
+    EXPECT_EQ_DOUBLE(1.0, diana_get_number(diana_get_array_element(&v, 1)));
+    diana_free(&v);
+
+    EXPECT_EQ_INT(DIANA_PARSE_INVALID_BINARY, diana_decode_cbor(&v, "\xa1\x01\x02", 3));                         /* 非字符串键 */
+    EXPECT_EQ_INT(DIANA_PARSE_INVALID_BINARY, diana_decode_cbor(&v, "\x9b\xff\xff\xff\xff\xff\xff\xff\xff", 9)); /* 长度超出输入 */
+    EXPECT_EQ_INT(DIANA_PARSE_INVALID_BINARY, diana_decode_msgpack(&v, "\xc7\x01\x00\x00", 4));                 /* ext */
+    EXPECT_EQ_INT(DIANA_PARSE_ROOT_NOT_SINGULAR, diana_decode_msgpack(&v, "\xc0\xc0", 2));
+    EXPECT_EQ_INT(DIANA_NULL, diana_get_type(&v));
+}
+
+/* 复用解析器与生成器，堆栈容量在多次调用之间保留 */
+static void test_reuse()
+{
+    diana_parser *p = diana_parser_create();
+    diana_writer *w = diana_writer_create();
+    diana_value v;
+    const char *json;
+    size_t length;
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_with(p, &v, "{\"a\":[1,\"abc\",{\"b\":null}],\"s\":\"Hello\\nWorld\"}"));
+        json = diana_stringify_with(w, &v, &length);
+        EXPECT_EQ_STRING("{\"a\":[1,\"abc\",{\"b\":null}],\"s\":\"Hello\\nWorld\"}", json, length);
+        diana_free(&v);
+        EXPECT_EQ_INT(DIANA_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, diana_parse_with(p, &v, "[1,[2}"));
+        EXPECT_EQ_INT(DIANA_NULL, diana_get_type(&v));
+        diana_parser_reset(p);
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_with(p, &v, "true"));
+        json = diana_stringify_with(w, &v, &length);
+        EXPECT_EQ_STRING("true", json, length);
+    }
+    diana_writer_reset(w);
+    diana_parser_destroy(p);
+    diana_writer_destroy(w);
+}
+
+/* 记录存活字节数的分配器，用于检查释放时传入的大小与分配时一致 */
+static void *count_alloc(void *user, size_t size)
+{
+    *(size_t *)user += size;
+    return malloc(size);
+}
+
+static void *count_realloc(void *user, void *ptr, size_t old_size, size_t new_size)
+{
+    *(size_t *)user += new_size - old_size;
+    return realloc(ptr, new_size);
+}
+
+static void count_free(void *user, void *ptr, size_t size)
+{
+    *(size_t *)user -= size;
+    free(ptr);
+}
+
+static void test_allocator()
+{
+    const char *json = "{\"a\":[1,\"abc\",{\"b\":null}],\"s\":\"Hello\",\"o\":{}}";
+    size_t live = 0;
+    diana_allocator counter = {count_alloc, count_realloc, count_free, NULL};
+    diana_arena *arena = diana_arena_create(64);
+    const diana_allocator *a = diana_arena_allocator(arena);
+    diana_value v, v2;
+    char *out;
+    size_t length;
+    int i;
+
+    counter.user = &live;
+    diana_init(&v);
+    diana_init(&v2);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, &counter));
+    EXPECT_TRUE(live > 0);
+    diana_copy_alloc(&v2, &v, &counter);
+    EXPECT_TRUE(diana_is_equal(&v, &v2));
+    diana_set_string_alloc(diana_pushback_array_element_alloc(diana_find_object_value_alloc(&v2, "a", 1, &counter), &counter), "x", 1, &counter);
+    diana_shrink_array_alloc(diana_find_object_value_alloc(&v2, "a", 1, &counter), &counter);
+    diana_free_alloc(&v2, &counter);
+    EXPECT_EQ_INT(DIANA_PARSE_MISS_COLON, diana_parse_alloc(&v2, "{\"a\":[\"x\"],\"b\"", &counter));
+    diana_free_alloc(&v, &counter);
+    EXPECT_EQ_SIZE_T(0, live);
+
+    for (i = 0; i < 3; i++)
+    {
+        EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, a));
+        diana_copy_alloc(&v2, &v, a);
+        diana_set_array_alloc(diana_find_object_value_alloc(&v2, "o", 1, a), 0, a);
+        diana_set_number_alloc(diana_pushback_array_element_alloc(diana_find_object_value_alloc(&v2, "o", 1, a), a), 1.5, a);
+        out = diana_stringify(&v2, &length);
+        EXPECT_EQ_STRING("{\"a\":[1,\"abc\",{\"b\":null}],\"s\":\"Hello\",\"o\":[1.5]}", out, length);
+        free(out);
+        diana_free_alloc(&v, a); /* 空操作 */
+        EXPECT_EQ_INT(DIANA_NULL, diana_get_type(&v));
+        diana_arena_reset(arena);
+    }
+    diana_arena_destroy(arena);
+}
+
+/* 成员数超过阈值的对象使用哈希索引 */
+static void test_object_index()
+{
+    diana_value o, o2, *pv;
+    char key[16], *json, *data;
+    size_t i, n = 1000, length;
+
+    diana_init(&o);
+    diana_init(&o2);
+    diana_set_object(&o, 0);
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        diana_set_number(diana_set_object_value(&o, key, strlen(key)), (double)i);
+    }
+    EXPECT_EQ_SIZE_T(n, diana_get_object_size(&o));
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        EXPECT_EQ_SIZE_T(i, diana_find_object_index(&o, key, strlen(key)));
+    }
+    EXPECT_TRUE(diana_find_object_index(&o, "k1000", 5) == DIANA_KEY_NOT_EXIST);
+    pv = diana_find_object_value(&o, "k7", 2);
+    EXPECT_TRUE(diana_set_object_value(&o, "k7", 2) == pv); /* 已存在的键 */
+    EXPECT_EQ_SIZE_T(n, diana_get_object_size(&o));
+
+    /* 逆序构造的对象相等 */
+    diana_set_object(&o2, 0);
+    for (i = n; i-- > 0;)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        diana_set_number(diana_set_object_value(&o2, key, strlen(key)), (double)i);
+    }
+    EXPECT_TRUE(diana_is_equal(&o, &o2));
+    diana_set_number(diana_find_object_value(&o2, "k999", 4), -1);
+    EXPECT_FALSE(diana_is_equal(&o, &o2));
+
+    /* 解析、复制与二进制解码得到的对象同样建立索引 */
+    json = diana_stringify(&o, &length);
+    diana_free(&o2);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&o2, json));
+    EXPECT_EQ_SIZE_T(500, diana_find_object_index(&o2, "k500", 4));
+    free(json);
+    diana_copy(&o2, &o);
+    EXPECT_EQ_SIZE_T(999, diana_find_object_index(&o2, "k999", 4));
+    data = diana_encode_cbor(&o, &length);
+    diana_free(&o2);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_decode_cbor(&o2, data, length));
+    EXPECT_EQ_SIZE_T(123, diana_find_object_index(&o2, "k123", 4));
+    free(data);
+
+    diana_clear_object(&o);
+    EXPECT_TRUE(diana_find_object_index(&o, "k1", 2) == DIANA_KEY_NOT_EXIST);
+    diana_set_null(diana_set_object_value(&o, "k1", 2));
+    EXPECT_EQ_SIZE_T(0, diana_find_object_index(&o, "k1", 2));
+    diana_shrink_object(&o);
+    EXPECT_EQ_SIZE_T(0, diana_find_object_index(&o, "k1", 2));
+    diana_free(&o);
+    diana_free(&o2);
+}
+
+static void test_mutation()
+{
+    diana_value a, o, values[3];
+    char key[16], *json;
+    size_t i, n = 100, length;
+
+    /* 数组：插入、区间删除、交换删除与批量追加 */
+    diana_init(&a);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&a, "[0,1,2,3,4,5]"));
+    diana_set_string(diana_insert_array_element(&a, 2), "x", 1);
+    diana_erase_array_element(&a, 4, 2);
+    diana_swap_remove_array_element(&a, 0);
+    for (i = 0; i < 3; i++)
+    {
+        diana_init(&values[i]);
+        diana_set_number(&values[i], (double)(10 + i));
+    }
+    diana_append_array_elements(&a, values, 3);
+    EXPECT_EQ_INT(DIANA_NULL, diana_get_type(&values[0]));
+    json = diana_stringify(&a, &length);
+    EXPECT_EQ_STRING("[5,1,\"x\",2,10,11,12]", json, length);
+    free(json);
+    diana_free(&a);
+
+    /* 对象：构造模式追加后统一检查重复键 */
+    diana_init(&o);
+    diana_set_object(&o, 0);
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        diana_set_number(diana_append_object_value(&o, key, strlen(key)), (double)i);
+    }
+    EXPECT_TRUE(diana_check_object_keys(&o) == DIANA_KEY_NOT_EXIST);
+    diana_set_null(diana_append_object_value(&o, "k42", 3));
+    EXPECT_EQ_SIZE_T(n, diana_check_object_keys(&o));
+    EXPECT_EQ_SIZE_T(42, diana_find_object_index(&o, "k42", 3));
+    diana_remove_object_value(&o, n);
+
+    /* 区间删除保持顺序，交换删除由末端成员填补 */
+    diana_erase_object_value(&o, 10, 20);
+    EXPECT_EQ_SIZE_T(n - 20, diana_get_object_size(&o));
+    EXPECT_TRUE(diana_find_object_index(&o, "k10", 3) == DIANA_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(10, diana_find_object_index(&o, "k30", 3));
+    diana_swap_remove_object_value(&o, 0);
+    EXPECT_TRUE(diana_find_object_index(&o, "k0", 2) == DIANA_KEY_NOT_EXIST);
+    EXPECT_EQ_SIZE_T(0, diana_find_object_index(&o, "k99", 3));
+    EXPECT_EQ_STRING("k99", diana_get_object_key(&o, 0), 3);
+    for (i = 1; i < n; i++)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        EXPECT_EQ_INT(i < 10 || i >= 30, diana_find_object_index(&o, key, strlen(key)) != DIANA_KEY_NOT_EXIST);
+    }
+    diana_free(&o);
+}
+
 static void test_access_null()
 {
     diana_value v;
@@ -757,6 +1285,302 @@ static void test_access()
     test_access_object();
 }
 
+static void test_compact()
+{
+    diana_value v, copy, *e;
+    char s[32], key[16];
+    size_t len, i, n = 100;
+    const char *p;
+
+    EXPECT_EQ_SIZE_T(16, sizeof(diana_value));
+
+    /* 短字符串存放在值内，长度达到DIANA_SHORT_STRING_SIZE后改用堆 */
+    memset(s, 'x', sizeof(s));
+    diana_init(&v);
+    diana_init(&copy);
+    for (len = 0; len < sizeof(s); len++)
+    {
+        diana_set_string(&v, s, len);
+        p = diana_get_string(&v);
+        EXPECT_EQ_SIZE_T(len, diana_get_string_length(&v));
+        EXPECT_TRUE(memcmp(p, s, len) == 0 && p[len] == '\0');
+        EXPECT_EQ_INT(len < DIANA_SHORT_STRING_SIZE, p >= (const char *)&v && p < (const char *)(&v + 1));
+        diana_copy(&copy, &v);
+        EXPECT_TRUE(diana_is_equal(&v, &copy));
+    }
+    diana_free(&copy);
+
+    /* 数组扩容移动元素后，值内的短字符串随之移动 */
+    diana_set_array(&v, 0);
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "%u", (unsigned)i);
+        diana_set_string(diana_pushback_array_element(&v), key, strlen(key));
+    }
+    EXPECT_EQ_SIZE_T(n, diana_get_array_size(&v));
+    EXPECT_TRUE(diana_get_array_capacity(&v) >= n);
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "%u", (unsigned)i);
+        e = diana_get_array_element(&v, i);
+        EXPECT_EQ_SIZE_T(strlen(key), diana_get_string_length(e));
+        EXPECT_TRUE(strcmp(key, diana_get_string(e)) == 0);
+    }
+    diana_shrink_array(&v);
+    EXPECT_EQ_SIZE_T(n, diana_get_array_capacity(&v));
+    diana_clear_array(&v);
+    diana_shrink_array(&v);
+    EXPECT_EQ_SIZE_T(0, diana_get_array_capacity(&v));
+
+    /* 对象容量与索引存放在成员之前的头部，清空后收缩至零容量 */
+    diana_set_object(&v, 0);
+    for (i = 0; i < n; i++)
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        diana_set_number(diana_set_object_value(&v, key, strlen(key)), (double)i);
+    }
+    EXPECT_EQ_SIZE_T(n, diana_get_object_size(&v));
+    EXPECT_EQ_SIZE_T(42, diana_find_object_index(&v, "k42", 3));
+    diana_clear_object(&v);
+    diana_shrink_object(&v);
+    EXPECT_EQ_SIZE_T(0, diana_get_object_capacity(&v));
+    EXPECT_EQ_SIZE_T(DIANA_KEY_NOT_EXIST, diana_find_object_index(&v, "k42", 3));
+    diana_free(&v);
+}
+
+static void test_copy_shared()
+{
+    const char *json = "{\"name\":\"a long string value\",\"list\":[1,2,{\"x\":\"another long string\"}],\"o\":{\"k\":true}}";
+    size_t live = 0, before, i, n = 20;
+    diana_allocator counter = {count_alloc, count_realloc, count_free, NULL};
+    diana_value v, c1, c2, *e;
+    char key[16], *out, *expect;
+    size_t length;
+
+    counter.user = &live;
+    diana_init(&v);
+    diana_init(&c1);
+    diana_init(&c2);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, &counter));
+    for (i = 0; i < n; i++) // 超过索引阈值
+    {
+        sprintf(key, "k%u", (unsigned)i);
+        diana_set_number_alloc(diana_set_object_value_alloc(&v, key, strlen(key), &counter), (double)i, &counter);
+    }
+    expect = diana_stringify(&v, NULL);
+
+    /* 共享复制不分配内存 */
+    before = live;
+    diana_copy_shared_alloc(&c1, &v, &counter);
+    diana_copy_shared_alloc(&c2, &c1, &counter);
+    EXPECT_EQ_SIZE_T(before, live);
+    EXPECT_TRUE(diana_is_equal(&v, &c1) && diana_is_equal(&c1, &c2));
+    EXPECT_TRUE(diana_get_string(diana_find_object_value_alloc(&c2, "name", 4, &counter)) ==
+                diana_get_string(diana_get_object_value(&v, 0)));
+
+    /* 写入时只复制被修改的节点，其余副本不变 */
+    diana_set_number_alloc(diana_find_object_value_alloc(&c1, "k7", 2, &counter), -1.0, &counter);
+    diana_set_null(diana_pushback_array_element_alloc(diana_find_object_value_alloc(&c1, "list", 4, &counter), &counter));
+    diana_remove_object_value_alloc(&c2, 0, &counter);
+    diana_set_boolean_alloc(diana_set_object_value_alloc(diana_find_object_value_alloc(&c2, "o", 1, &counter), "k", 1, &counter), 0, &counter);
+    EXPECT_EQ_SIZE_T(n + 3, diana_get_object_size(&v));
+    EXPECT_EQ_SIZE_T(3, diana_get_array_size(diana_find_object_value_alloc(&v, "list", 4, &counter)));
+    EXPECT_EQ_SIZE_T(4, diana_get_array_size(diana_find_object_value_alloc(&c1, "list", 4, &counter)));
+    EXPECT_EQ_SIZE_T(n + 2, diana_get_object_size(&c2));
+    EXPECT_EQ_SIZE_T(9, diana_find_object_index(&c2, "k7", 2)); // 删除首个成员后下标前移
+    EXPECT_EQ_DOUBLE(7.0, diana_get_number(diana_find_object_value_alloc(&c2, "k7", 2, &counter)));
+    EXPECT_EQ_DOUBLE(-1.0, diana_get_number(diana_find_object_value_alloc(&c1, "k7", 2, &counter)));
+    EXPECT_TRUE(diana_get_boolean(diana_find_object_value_alloc(diana_find_object_value_alloc(&c1, "o", 1, &counter), "k", 1, &counter)));
+    EXPECT_FALSE(diana_get_boolean(diana_find_object_value_alloc(diana_find_object_value_alloc(&c2, "o", 1, &counter), "k", 1, &counter)));
+
+    /* 经diana_get_array_element写入前先取得独占的容器 */
+    e = diana_find_object_value_alloc(&c2, "list", 4, &counter);
+    diana_unshare_alloc(e, &counter);
+    diana_set_string_alloc(diana_get_array_element(e, 0), "replaced", 8, &counter);
+    EXPECT_EQ_DOUBLE(1.0, diana_get_number(diana_get_array_element(diana_find_object_value_alloc(&v, "list", 4, &counter), 0)));
+
+    /* 原值先释放，副本依然有效 */
+    diana_free_alloc(&v, &counter);
+    out = diana_stringify(&c1, &length);
+    EXPECT_FALSE(strcmp(expect, out) == 0);
+    free(out);
+    diana_copy_shared_alloc(&c1, diana_get_object_value(&c1, 1), &counter); // src位于dst之内
+    EXPECT_EQ_INT(DIANA_ARRAY, diana_get_type(&c1));
+    EXPECT_EQ_SIZE_T(4, diana_get_array_size(&c1));
+    diana_free_alloc(&c1, &counter);
+    diana_free_alloc(&c2, &counter);
+    EXPECT_EQ_SIZE_T(0, live);
+    free(expect);
+}
+
+static void test_memory()
+{
+    const char *json = "{\"a\":[1,\"abc\",{\"b\":null}],\"s\":\"a long string value\",\"o\":{},\"t\":true,"
+                       "\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6}";
+    size_t live = 0;
+    diana_allocator counting = {count_alloc, count_realloc, count_free, NULL};
+    diana_alloc_counter counter;
+    const diana_allocator *a;
+    diana_arena *arena;
+    diana_memory usage;
+    diana_value v;
+
+    /* 与按字节统计的分配器逐字节一致（含对象的哈希索引） */
+    counting.user = &live;
+    diana_init(&v);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, &counting));
+    diana_memory_usage(&v, &usage);
+    EXPECT_EQ_SIZE_T(live, usage.bytes);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[DIANA_NULL]);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[DIANA_TRUE]);
+    EXPECT_EQ_SIZE_T(8, usage.nodes[DIANA_NUMBER]);
+    EXPECT_EQ_SIZE_T(2, usage.nodes[DIANA_STRING]);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[DIANA_ARRAY]);
+    EXPECT_EQ_SIZE_T(3, usage.nodes[DIANA_OBJECT]);
+    diana_free_alloc(&v, &counting);
+    EXPECT_EQ_SIZE_T(0, live);
+    diana_set_number(&v, 1.0);
+    diana_memory_usage(&v, &usage);
+    EXPECT_EQ_SIZE_T(0, usage.bytes);
+    EXPECT_EQ_SIZE_T(1, usage.nodes[DIANA_NUMBER]);
+
+    /* 分配统计 */
+    a = diana_alloc_counter_init(&counter, NULL);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, a));
+    diana_memory_usage(&v, &usage);
+    EXPECT_TRUE(counter.allocations > 0);
+    EXPECT_EQ_SIZE_T(usage.bytes, (size_t)counter.bytes);
+    EXPECT_TRUE(counter.peak >= counter.bytes);
+    diana_alloc_counter_reset(&counter);
+    diana_free_alloc(&v, a);
+    EXPECT_EQ_SIZE_T(0, counter.allocations);
+    EXPECT_TRUE(counter.frees > 0);
+    EXPECT_TRUE(counter.bytes == -(int64_t)usage.bytes);
+    EXPECT_TRUE(counter.peak == 0);
+
+    /* 包装arena时保持不逐个释放的语义 */
+    arena = diana_arena_create(0);
+    a = diana_alloc_counter_init(&counter, diana_arena_allocator(arena));
+    EXPECT_TRUE(a->free == NULL);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc(&v, json, a));
+    EXPECT_TRUE(counter.allocations > 0);
+    diana_free_alloc(&v, a);
+    EXPECT_EQ_SIZE_T(0, counter.frees);
+    diana_arena_destroy(arena);
+}
+
+static void test_depth()
+{
+    diana_value v, copy, *p;
+    size_t i, p_len, n = DIANA_PARSE_MAX_DEPTH, deep = 100000;
+    char *json = (char *)malloc(n * 16 + 16), *bin = (char *)malloc(n + 2);
+
+    /* 恰好达到上限时解析成功，超出一层即报错且不留下部分结果 */
+    for (i = 0; i < n; i++)
+        json[i] = '[', json[n + i] = ']';
+    json[n * 2] = '\0';
+    diana_init(&v);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse(&v, json));
+    EXPECT_EQ_INT(DIANA_ARRAY, diana_get_type(&v));
+    diana_free(&v);
+    json[0] = '{', json[1] = '"', json[2] = 'k', json[3] = '"', json[4] = ':';
+    for (i = 5; i < n + 6; i++)
+        json[i] = '[';
+    json[i] = '\0';
+    TEST_ERROR(DIANA_PARSE_DEPTH_EXCEEDED, json);
+    /* 中途出错时逐层释放已解析的元素与成员：数组与对象交替嵌套n层，每层先有一个元素（成员），最内层缺少右括号 */
+    for (i = 0, p_len = 0; i < n; i++)
+    {
+        const char *level = i % 2 == 0 ? "[\"x\"," : "{\"b\":true,\"a\":";
+        memcpy(json + p_len, level, strlen(level));
+        p_len += strlen(level);
+    }
+    memcpy(json + p_len, "null)", 6);
+    TEST_ERROR(n % 2 == 1 ? DIANA_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : DIANA_PARSE_MISS_COMMA_OR_CURLY_BRACKET, json);
+
+    /* 二进制解码同样受深度限制 */
+    for (i = 0; i < n; i++)
+        bin[i] = (char)0x81; /* CBOR单元素数组 */
+    bin[n] = (char)0xF6;
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_decode_cbor(&v, bin, n + 1));
+    diana_free(&v);
+    memset(bin, 0x91, n + 1); /* MessagePack单元素数组 */
+    bin[n + 1] = (char)0xC0;
+    EXPECT_EQ_INT(DIANA_PARSE_DEPTH_EXCEEDED, diana_decode_msgpack(&v, bin, n + 2));
+    EXPECT_EQ_INT(DIANA_NULL, diana_get_type(&v));
+
+    /* 远超调用栈承受能力的嵌套：复制、比较与释放均不递归 */
+    diana_init(&v);
+    for (p = &v, i = 0; i < deep; i++)
+    {
+        diana_set_array(p, 1);
+        p = diana_pushback_array_element(p);
+    }
+    diana_set_number(p, 1.0);
+    diana_init(&copy);
+    diana_copy(&copy, &v);
+    EXPECT_TRUE(diana_is_equal(&v, &copy));
+    /* 以DIANA_COPY_SHARED=1编译时两者共享整条链，经保留的指针写入前先沿路径取消共享 */
+    for (p = &v, i = 0; i < deep; i++)
+    {
+        diana_unshare(p);
+        p = diana_get_array_element(p, 0);
+    }
+    diana_set_number(p, 2.0);
+    EXPECT_FALSE(diana_is_equal(&v, &copy));
+    diana_free(&copy);
+    diana_free(&v);
+    free(json);
+    free(bin);
+}
+
+#if DIANA_PARSE_STATS
+static void test_parse_stats()
+{
+    const char *json = " {\"a\":[1,2,3,[]],\"s\\u00e9\":\"x\\ny\",\"p\":\"\\uD834\\uDD1E\",\"n\":null,\"t\":[true,false]} ";
+    diana_parse_stats stats;
+    diana_parser *p;
+    diana_value v;
+
+    diana_init(&v);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_alloc_stats(&v, json, NULL, &stats));
+    EXPECT_EQ_SIZE_T(strlen(json), stats.bytes);
+    EXPECT_EQ_SIZE_T(1, stats.values[DIANA_NULL]);
+    EXPECT_EQ_SIZE_T(1, stats.values[DIANA_FALSE]);
+    EXPECT_EQ_SIZE_T(1, stats.values[DIANA_TRUE]);
+    EXPECT_EQ_SIZE_T(3, stats.values[DIANA_NUMBER]);
+    EXPECT_EQ_SIZE_T(2, stats.values[DIANA_STRING]);
+    EXPECT_EQ_SIZE_T(3, stats.values[DIANA_ARRAY]);
+    EXPECT_EQ_SIZE_T(1, stats.values[DIANA_OBJECT]);
+    EXPECT_EQ_SIZE_T(5, stats.keys);
+    EXPECT_EQ_SIZE_T(7 + 3 + 4, stats.string_bytes); /* 五个键，值x\ny与U+1D11E */
+    EXPECT_EQ_SIZE_T(4, stats.escapes);
+    EXPECT_EQ_SIZE_T(3, stats.unicode_escapes);
+    EXPECT_EQ_SIZE_T(3, stats.max_depth);
+    EXPECT_EQ_SIZE_T(5, stats.largest_container);
+    EXPECT_TRUE(stats.seconds >= 0.0);
+    diana_free(&v);
+
+    /* 出错时bytes为出错的位置 */
+    EXPECT_EQ_INT(DIANA_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, diana_parse_alloc_stats(&v, "[1,2 3]", NULL, &stats));
+    EXPECT_EQ_SIZE_T(5, stats.bytes);
+    EXPECT_EQ_SIZE_T(2, stats.values[DIANA_NUMBER]);
+
+    /* 可复用的解析器保留最近一次的统计 */
+    p = diana_parser_create();
+    EXPECT_EQ_SIZE_T(0, diana_parser_stats(p)->bytes);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_with(p, &v, "[[[]]]"));
+    EXPECT_EQ_SIZE_T(3, diana_parser_stats(p)->max_depth);
+    EXPECT_EQ_SIZE_T(1, diana_parser_stats(p)->largest_container);
+    diana_free(&v);
+    EXPECT_EQ_INT(DIANA_PARSE_OK, diana_parse_with(p, &v, "\"abc\""));
+    EXPECT_EQ_SIZE_T(0, diana_parser_stats(p)->max_depth);
+    EXPECT_EQ_SIZE_T(3, diana_parser_stats(p)->string_bytes);
+    diana_free(&v);
+    diana_parser_destroy(p);
+}
+#endif
+
 int main()
 {
     test_parse();
@@ -765,6 +1589,18 @@ int main()
     test_copy();
     test_move();
     test_swap();
+    test_binary();
+    test_reuse();
+    test_allocator();
+    test_object_index();
+    test_mutation();
+    test_compact();
+    test_copy_shared();
+    test_memory();
+#if DIANA_PARSE_STATS
+    test_parse_stats();
+#endif
+    test_depth();
     test_access();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     return main_ret;
@@ -0,0 +1,755 @@
+// Benchmark：以确定性生成的语料比较C++（Json）与C（diana_value）两套实现
+// 每个（语料, 实现, 操作）先预热，再重复计时，结果以JSON Lines或CSV输出到标准输出
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "dianajson.h"
+#include "json.h"
+
+namespace {
+	using namespace DianaJSON;
+
+	// splitmix64：输出只取决于种子，不依赖标准库的分布实现，各平台生成的语料逐字节相同
+	class Random {
+	public:
+		explicit Random(uint64_t seed) : _state(seed) {}
+
+		uint64_t next() {
+			uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+		size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+		double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+		bool chance(unsigned percent) { return below(100) < percent; }
+
+	private:
+		uint64_t _state;
+	};
+
+	const char *const words[] = {
+			"diana", "json", "parse", "value", "array", "object", "string", "number", "true", "false",
+			"stream", "buffer", "event", "tweet", "user", "status", "photo", "media", "link", "reply",
+			"嘉然", "顿顿", "解馋", "café", "naïve", "über", "東京", "서울", "😀", "🚀"};
+
+	void appendString(std::string &out, const std::string &s) {
+		static const char hex[] = "0123456789abcdef";
+		out += '"';
+		for (unsigned char ch : s) {
+			switch (ch) {
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if (ch < 0x20) {
+						out += "\\u00";
+						out += hex[ch >> 4];
+						out += hex[ch & 15];
+					} else {
+						out += static_cast<char>(ch);
+					}
+			}
+		}
+		out += '"';
+	}
+
+	void appendKey(std::string &out, const char *key) {
+		out += '"';
+		out += key;
+		out += "\":";
+	}
+
+	void appendNumber(std::string &out, double n, int precision = 17) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.*g", precision, n);
+		out += buf;
+	}
+
+	void appendInteger(std::string &out, uint64_t n) {
+		out += std::to_string(n);
+	}
+
+	// 随机单词组成的文本，偶尔夹带需要转义的字符
+	std::string sentence(Random &r, size_t minWords, size_t maxWords) {
+		std::string s;
+		size_t n = minWords + r.below(maxWords - minWords + 1);
+		for (size_t i = 0; i < n; ++i) {
+			if (i) s += r.chance(3) ? (r.chance(50) ? "\n" : "\"") : " ";
+			s += words[r.below(std::size(words))];
+		}
+		return s;
+	}
+
+	// twitter.json：中等嵌套的对象数组，以字符串与整数为主，含大量非ASCII文本
+	std::string generateTwitter(Random &r, size_t target) {
+		std::string out = "{\"statuses\":[";
+		for (uint64_t i = 0; out.size() < target; ++i) {
+			uint64_t id = 505874924095815681ULL + i * 7919;
+			if (i) out += ',';
+			out += "{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":\"ja\"},";
+			appendKey(out, "created_at");
+			appendString(out, "Sun Aug 31 00:29:15 +0000 2014");
+			out += ",\"id\":";
+			appendInteger(out, id);
+			out += ",\"id_str\":";
+			appendString(out, std::to_string(id));
+			out += ",\"text\":";
+			appendString(out, sentence(r, 5, 25));
+			out += ",\"source\":\"<a href=\\\"https://example.com\\\" rel=\\\"nofollow\\\">client</a>\",\"truncated\":false,";
+			out += "\"in_reply_to_status_id\":null,\"user\":{\"id\":";
+			appendInteger(out, 1186275104 + r.below(1000000));
+			out += ",\"name\":";
+			appendString(out, sentence(r, 1, 3));
+			out += ",\"screen_name\":";
+			appendString(out, std::string("user_") + std::to_string(r.below(100000)));
+			out += ",\"description\":";
+			appendString(out, sentence(r, 0, 20));
+			out += ",\"followers_count\":";
+			appendInteger(out, r.below(100000));
+			out += ",\"friends_count\":";
+			appendInteger(out, r.below(5000));
+			out += ",\"verified\":";
+			out += r.chance(5) ? "true" : "false";
+			out += ",\"profile_background_color\":\"C0DEED\",\"default_profile\":true},\"geo\":null,\"coordinates\":null,";
+			out += "\"entities\":{\"hashtags\":[";
+			for (size_t h = 0, n = r.below(4); h < n; ++h) {
+				if (h) out += ',';
+				out += "{\"text\":";
+				appendString(out, words[r.below(std::size(words))]);
+				out += ",\"indices\":[";
+				appendInteger(out, h * 10);
+				out += ',';
+				appendInteger(out, h * 10 + 8);
+				out += "]}";
+			}
+			out += "],\"symbols\":[],\"urls\":[],\"user_mentions\":[]},\"retweet_count\":";
+			appendInteger(out, r.below(1000));
+			out += ",\"favorite_count\":";
+			appendInteger(out, r.below(1000));
+			out += ",\"favorited\":false,\"retweeted\":false,\"lang\":\"ja\"}";
+		}
+		out += "],\"search_metadata\":{\"completed_in\":0.087,\"count\":100}}";
+		return out;
+	}
+
+	// canada.json：一个多边形要素，坐标为大量高精度的浮点数对
+	std::string generateCanada(Random &r, size_t target) {
+		std::string out = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+						  "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+		double lon = -65.613616999999977, lat = 43.420273000000009;
+		for (size_t ring = 0; out.size() < target; ++ring) {
+			if (ring) out += ',';
+			out += '[';
+			for (size_t i = 0, n = 64 + r.below(1024); i < n && out.size() < target; ++i) {
+				lon += (r.uniform() - 0.5) * 0.01;
+				lat += (r.uniform() - 0.5) * 0.01;
+				if (i) out += ',';
+				out += '[';
+				appendNumber(out, lon);
+				out += ',';
+				appendNumber(out, lat);
+				out += ']';
+			}
+			out += ']';
+		}
+		out += "]}}]}";
+		return out;
+	}
+
+	// citm_catalog.json：以数字字符串为键的大对象，深度适中的嵌套对象与短整数数组
+	std::string generateCitm(Random &r, size_t target) {
+		std::string out = "{\"areaNames\":{";
+		for (size_t i = 0; i < 64; ++i) {
+			if (i) out += ',';
+			appendString(out, std::to_string(205705993 + i * 3));
+			out += ':';
+			appendString(out, sentence(r, 1, 4));
+		}
+		out += "},\"events\":{";
+		std::vector<uint64_t> events;
+		for (size_t i = 0; out.size() < target / 3; ++i) {
+			uint64_t id = 138586341 + i * 17;
+			events.push_back(id);
+			if (i) out += ',';
+			appendString(out, std::to_string(id));
+			out += ":{\"description\":null,\"id\":";
+			appendInteger(out, id);
+			out += ",\"logo\":";
+			if (r.chance(50)) appendString(out, "/images/UE0AAAAACEKo6QAAAAZDSVRN");
+			else out += "null";
+			out += ",\"name\":";
+			appendString(out, sentence(r, 1, 5));
+			out += ",\"subTopicIds\":[";
+			for (size_t t = 0, n = 1 + r.below(5); t < n; ++t) {
+				if (t) out += ',';
+				appendInteger(out, 337184262 + r.below(1000));
+			}
+			out += "],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":[";
+			appendInteger(out, 324846099 + r.below(100));
+			out += ",107888604]}";
+		}
+		out += "},\"performances\":[";
+		for (size_t i = 0; out.size() < target; ++i) {
+			if (i) out += ',';
+			out += "{\"eventId\":";
+			appendInteger(out, events[r.below(events.size())]);
+			out += ",\"id\":";
+			appendInteger(out, 339887544 + i);
+			out += ",\"logo\":null,\"name\":null,\"prices\":[";
+			for (size_t p = 0, n = 1 + r.below(4); p < n; ++p) {
+				if (p) out += ',';
+				out += "{\"amount\":";
+				appendInteger(out, 9500 + 1000 * r.below(20));
+				out += ",\"audienceSubCategoryId\":337100890,\"seatCategoryId\":";
+				appendInteger(out, 338937295 + p);
+				out += '}';
+			}
+			out += "],\"seatCategories\":[";
+			for (size_t s = 0, n = 1 + r.below(3); s < n; ++s) {
+				if (s) out += ',';
+				out += "{\"areas\":[";
+				for (size_t a = 0, m = 1 + r.below(6); a < m; ++a) {
+					if (a) out += ',';
+					out += "{\"areaId\":";
+					appendInteger(out, 205705993 + 3 * r.below(64));
+					out += ",\"blockIds\":[]}";
+				}
+				out += "],\"seatCategoryId\":";
+				appendInteger(out, 338937295 + s);
+				out += '}';
+			}
+			out += "],\"seatMapImage\":null,\"start\":";
+			appendInteger(out, 1372701600000ULL + 86400000ULL * r.below(365));
+			out += ",\"venueCode\":\"PLEYEL_PLEYEL\"}";
+		}
+		out += "]}";
+		return out;
+	}
+
+	// 长字符串：每个16KB至128KB，含转义与多字节字符
+	std::string generateLongStrings(Random &r, size_t target) {
+		std::string out = "[";
+		for (size_t i = 0; out.size() < target; ++i) {
+			std::string s;
+			for (size_t n = 16384 + r.below(114688); s.size() < n;) {
+				s += words[r.below(std::size(words))];
+				s += r.chance(2) ? "\t" : " ";
+			}
+			if (i) out += ',';
+			appendString(out, s);
+		}
+		out += ']';
+		return out;
+	}
+
+	// 深度嵌套：数组与对象交替嵌套512层的链，不超过两套实现的深度限制
+	std::string generateDeep(Random &r, size_t target) {
+		const size_t depth = 512;
+		std::string out = "[";
+		for (size_t i = 0; out.size() < target; ++i) {
+			if (i) out += ',';
+			std::string close;
+			for (size_t d = 0; d < depth; ++d) {
+				if (d & 1) {
+					out += "{\"k\":";
+					close += '}';
+				} else {
+					out += '[';
+					close += ']';
+				}
+			}
+			appendInteger(out, r.below(1000));
+			out.append(close.rbegin(), close.rend());
+		}
+		out += ']';
+		return out;
+	}
+
+	// 缩进的twitter.json：每个成员与元素独占一行，以两个空格缩进，白空格约占一半
+	std::string generateTwitterPretty(Random &r, size_t target) {
+		std::string compact = generateTwitter(r, target / 2), out;
+		size_t depth = 0;
+		auto newline = [&] {
+			out += '\n';
+			out.append(2 * depth, ' ');
+		};
+		for (size_t i = 0; i < compact.size(); ++i) {
+			char ch = compact[i];
+			if (ch == '"') {// 原样复制字符串
+				size_t j = i + 1;
+				while (compact[j] != '"') j += compact[j] == '\\' ? 2 : 1;
+				out.append(compact, i, j + 1 - i);
+				i = j;
+			} else if (ch == '{' || ch == '[') {
+				out += ch;
+				if (compact[i + 1] == '}' || compact[i + 1] == ']') {
+					out += compact[++i];
+				} else {
+					++depth;
+					newline();
+				}
+			} else if (ch == '}' || ch == ']') {
+				--depth;
+				newline();
+				out += ch;
+			} else if (ch == ',') {
+				out += ch;
+				newline();
+			} else if (ch == ':') {
+				out += ": ";
+			} else {
+				out += ch;
+			}
+		}
+		return out;
+	}
+
+	struct Corpus {
+		const char *name;
+		std::string (*generate)(Random &, size_t);
+		std::string text;
+		size_t nodes;// 值的个数（含数组元素与对象成员的值），两套实现相同
+	};
+
+	size_t countNodes(const diana_value *root) {
+		std::vector<const diana_value *> stack{root};
+		size_t nodes = 0;
+		while (!stack.empty()) {
+			const diana_value *v = stack.back();
+			stack.pop_back();
+			++nodes;
+			if (diana_get_type(v) == DIANA_ARRAY) {
+				for (size_t i = 0; i < diana_get_array_size(v); ++i) stack.push_back(diana_get_array_element(v, i));
+			} else if (diana_get_type(v) == DIANA_OBJECT) {
+				for (size_t i = 0; i < diana_get_object_size(v); ++i) stack.push_back(diana_get_object_value(v, i));
+			}
+		}
+		return nodes;
+	}
+
+	struct Options {
+		size_t size = 1 << 20;// 每份语料的近似字节数
+		unsigned warmup = 2, reps = 10;
+		uint64_t seed = 20200519;
+		std::string corpora, engines, ops;// 逗号分隔的过滤条件，空表示全部
+		std::string format = "jsonl";     // jsonl或csv
+		std::string dump;                 // 非空时把语料写入该目录
+		bool counters = true;             // 读取硬件性能计数器
+	};
+
+	bool selected(const std::string &filter, const char *name) {
+		if (filter.empty()) return true;
+		std::string list = "," + filter + ",";
+		return list.find(std::string(",") + name + ",") != std::string::npos;
+	}
+
+	// 防止被计时的操作被优化掉
+	volatile size_t sink;
+
+	// 硬件性能计数器：Linux上以perf_event_open逐个打开，只统计用户态
+	// 容器、虚拟机或权限不足（perf_event_paranoid）时打不开的计数器记为不可用，读数为NaN，计时不受影响
+	class PerfCounters {
+	public:
+		enum { Cycles, Instructions, BranchMisses, L1DMisses, LLCMisses, Count };
+		static constexpr const char *names[Count] = {"cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses"};
+		using Sample = std::array<double, Count>;
+
+		explicit PerfCounters(bool enabled) {
+			_fd.fill(-1);
+#ifdef __linux__
+			if (!enabled) return;
+			const uint64_t readMiss = uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8 | uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16;
+			const std::pair<uint32_t, uint64_t> events[Count] = {
+					{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+					{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+					{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+					{PERF_TYPE_HW_CACHE, readMiss | PERF_COUNT_HW_CACHE_L1D},
+					{PERF_TYPE_HW_CACHE, readMiss | PERF_COUNT_HW_CACHE_LL},
+			};
+			for (int i = 0; i < Count; ++i) {
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = events[i].first;
+				attr.config = events[i].second;
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				_fd[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+				if (_fd[i] < 0 && _error.empty()) _error = std::string(names[i]) + ": " + strerror(errno);
+			}
+#else
+			(void) enabled;
+			_error = "perf_event_open is only available on Linux";
+#endif
+		}
+		~PerfCounters() {
+#ifdef __linux__
+			for (int fd : _fd)
+				if (fd >= 0) close(fd);
+#endif
+		}
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters &operator=(const PerfCounters &) = delete;
+
+		bool any() const noexcept { return std::any_of(_fd.begin(), _fd.end(), [](int fd) { return fd >= 0; }); }
+		const std::string &error() const noexcept { return _error; }// 第一个打不开的计数器及原因
+
+		void start() {
+#ifdef __linux__
+			for (int fd : _fd) {
+				if (fd < 0) continue;
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		// 计数器被分时复用时按实际运行时间的比例折算
+		Sample stop() {
+			Sample sample;
+			sample.fill(std::nan(""));
+#ifdef __linux__
+			for (int fd : _fd)
+				if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			for (int i = 0; i < Count; ++i) {
+				uint64_t data[3];// value, time_enabled, time_running
+				if (_fd[i] < 0 || read(_fd[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+				sample[i] = static_cast<double>(data[0]) * (static_cast<double>(data[1]) / static_cast<double>(data[2]));
+			}
+#endif
+			return sample;
+		}
+
+	private:
+		std::array<int, Count> _fd;
+		std::string _error;
+	};
+
+	struct Measurement {
+		const char *corpus, *engine, *op;
+		size_t bytes, nodes;
+		unsigned warmup, reps;
+		double medianNs, minNs;
+		PerfCounters::Sample counters;// 各次重复的中位数，不可用时为NaN
+		// 以下来自计时之外单独执行的一次，不可用或不适用时为NaN
+		double allocations, frees, peakBytes;// 该操作的堆分配次数、释放次数与峰值占用
+		double memoryBytes;                  // parse与copy所得文档的内存占用
+	};
+
+	// 分配统计，不可用时各项为NaN
+	struct AllocationSample {
+		double allocations = std::nan(""), frees = std::nan(""), peakBytes = std::nan("");
+	};
+
+	double median(std::vector<double> &samples) {
+		std::sort(samples.begin(), samples.end());
+		size_t n = samples.size();
+		return n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+	}
+
+	class Reporter {
+	public:
+		explicit Reporter(const std::string &format) : _csv(format == "csv") {
+			if (!_csv) return;
+			std::cout << "corpus,engine,op,bytes,nodes,warmup,reps,median_ns,min_ns,mb_per_s,docs_per_s,ipc";
+			for (const char *name : PerfCounters::names) std::cout << ',' << name << "_per_byte," << name << "_per_node";
+			std::cout << ",allocations,allocations_per_node,frees,peak_bytes,memory_bytes,memory_per_byte\n";
+		}
+
+		// 计数器按输入字节数与节点数归一化；不可用的字段在JSON中为null，在CSV中为空
+		void report(const Measurement &m) {
+			double seconds = m.medianNs * 1e-9;
+			std::string line;
+			if (_csv) {
+				line = std::string(m.corpus) + ',' + m.engine + ',' + m.op;
+			} else {
+				line = std::string("{\"corpus\":\"") + m.corpus + "\",\"engine\":\"" + m.engine + "\",\"op\":\"" + m.op + '"';
+			}
+			field(line, "bytes", static_cast<double>(m.bytes), "%.0f");
+			field(line, "nodes", static_cast<double>(m.nodes), "%.0f");
+			field(line, "warmup", m.warmup, "%.0f");
+			field(line, "reps", m.reps, "%.0f");
+			field(line, "median_ns", m.medianNs, "%.0f");
+			field(line, "min_ns", m.minNs, "%.0f");
+			field(line, "mb_per_s", seconds > 0 ? m.bytes / 1e6 / seconds : 0, "%.3f");
+			field(line, "docs_per_s", seconds > 0 ? 1 / seconds : 0, "%.3f");
+			field(line, "ipc", m.counters[PerfCounters::Instructions] / m.counters[PerfCounters::Cycles], "%.3f");
+			for (int i = 0; i < PerfCounters::Count; ++i) {
+				std::string name = PerfCounters::names[i];
+				field(line, (name + "_per_byte").c_str(), m.counters[i] / m.bytes, "%.4f");
+				field(line, (name + "_per_node").c_str(), m.counters[i] / m.nodes, "%.4f");
+			}
+			field(line, "allocations", m.allocations, "%.0f");
+			field(line, "allocations_per_node", m.allocations / m.nodes, "%.4f");
+			field(line, "frees", m.frees, "%.0f");
+			field(line, "peak_bytes", m.peakBytes, "%.0f");
+			field(line, "memory_bytes", m.memoryBytes, "%.0f");
+			field(line, "memory_per_byte", m.memoryBytes / m.bytes, "%.4f");
+			line += _csv ? "\n" : "}\n";
+			std::cout << line << std::flush;
+		}
+
+	private:
+		void field(std::string &line, const char *name, double value, const char *format) const {
+			char buf[64] = "";
+			if (!std::isnan(value) && !std::isinf(value)) snprintf(buf, sizeof(buf), format, value);
+			else if (!_csv) strcpy(buf, "null");
+			if (_csv) {
+				line += ',';
+			} else {
+				line += ",\"";
+				line += name;
+				line += "\":";
+			}
+			line += buf;
+		}
+
+		bool _csv;
+	};
+
+	// 每次重复先执行setup（不计时），再对op单独计时并读取计数器；预热的结果丢弃
+	template<class Setup, class Op>
+	Measurement measure(const Options &options, PerfCounters &counters, Setup setup, Op op) {
+		std::vector<double> samples;
+		std::array<std::vector<double>, PerfCounters::Count> counts;
+		for (unsigned i = 0; i < options.warmup + options.reps; ++i) {
+			setup();
+			counters.start();
+			auto begin = std::chrono::steady_clock::now();
+			op();
+			auto end = std::chrono::steady_clock::now();
+			PerfCounters::Sample sample = counters.stop();
+			if (i < options.warmup) continue;
+			samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+			for (int c = 0; c < PerfCounters::Count; ++c)
+				if (!std::isnan(sample[c])) counts[c].push_back(sample[c]);
+		}
+		Measurement m{};
+		m.warmup = options.warmup;
+		m.reps = options.reps;
+		m.medianNs = median(samples);
+		m.minNs = samples.front();
+		for (int c = 0; c < PerfCounters::Count; ++c)
+			m.counters[c] = counts[c].empty() ? std::nan("") : median(counts[c]);
+		return m;
+	}
+
+	struct CppEngine {
+		static constexpr const char *name = "cpp";
+		using Document = std::optional<Json>;
+
+		static bool parse(const std::string &text, Document &doc) {
+			std::string errorText;
+			doc.emplace(Json::parse(text, errorText));
+			return errorText.empty();
+		}
+		static size_t serialize(const Document &doc) { return doc->serialize().size(); }
+		static void copy(const Document &src, Document &dst) { dst.emplace(*src); }
+		static bool equal(const Document &lhs, const Document &rhs) { return *lhs == *rhs; }
+		static void destroy(Document &doc) { doc.reset(); }
+		static double memory(const Document &doc) { return doc ? static_cast<double>(doc->memoryUsage().bytes) : 0; }
+
+		// 需要以DIANA_JSON_COUNT_ALLOCATIONS编译，否则为NaN
+		template<class Op>
+		static AllocationSample countAllocations(Op op) {
+			AllocationSample sample;
+			JsonAllocationCounter counter;
+			op();
+			if (!JsonAllocationCounter::enabled()) return sample;
+			const JsonAllocationStats &stats = counter.stats();
+			sample.allocations = static_cast<double>(stats.allocations);
+			sample.frees = static_cast<double>(stats.frees);
+			sample.peakBytes = static_cast<double>(stats.peak);
+			return sample;
+		}
+	};
+
+	// diana_value的RAII包装
+	class CDocument {
+	public:
+		CDocument() { diana_init(&_v); }
+		~CDocument() { diana_free(&_v); }
+		CDocument(const CDocument &) = delete;
+		CDocument &operator=(const CDocument &) = delete;
+
+		diana_value *get() noexcept { return &_v; }
+		const diana_value *get() const noexcept { return &_v; }
+
+	private:
+		diana_value _v;
+	};
+
+	// 计时时allocator为NULL，与不带_alloc后缀的接口相同；统计分配时换成计数分配器
+	struct CEngine {
+		static constexpr const char *name = "c";
+		using Document = CDocument;
+		static inline const diana_allocator *allocator = nullptr;
+
+		static bool parse(const std::string &text, Document &doc) { return diana_parse_alloc(doc.get(), text.c_str(), allocator) == DIANA_PARSE_OK; }
+		static size_t serialize(const Document &doc) {
+			size_t length = 0;
+			free(diana_stringify(doc.get(), &length));
+			return length;
+		}
+		static void copy(const Document &src, Document &dst) { diana_copy_alloc(dst.get(), src.get(), allocator); }
+		static bool equal(const Document &lhs, const Document &rhs) { return diana_is_equal(lhs.get(), rhs.get()) != 0; }
+		static void destroy(Document &doc) { diana_free_alloc(doc.get(), allocator); }
+		static double memory(const Document &doc) {
+			diana_memory usage;
+			diana_memory_usage(doc.get(), &usage);
+			return static_cast<double>(usage.bytes);
+		}
+
+		// 只统计值本身的分配，解析与生成的临时缓冲区直接使用malloc，不计入
+		template<class Op>
+		static AllocationSample countAllocations(Op op) {
+			diana_alloc_counter counter;
+			allocator = diana_alloc_counter_init(&counter, nullptr);
+			op();
+			allocator = nullptr;
+			AllocationSample sample;
+			sample.allocations = static_cast<double>(counter.allocations);
+			sample.frees = static_cast<double>(counter.frees);
+			sample.peakBytes = static_cast<double>(counter.peak);
+			return sample;
+		}
+	};
+
+	template<class Engine>
+	void runEngine(const Options &options, const Corpus &corpus, PerfCounters &counters, Reporter &reporter) {
+		using Document = typename Engine::Document;
+		if (!selected(options.engines, Engine::name)) return;
+		Document doc, other;
+		if (!Engine::parse(corpus.text, doc)) {
+			std::cerr << Engine::name << ": failed to parse corpus " << corpus.name << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		// result为操作产生的文档，报告其内存占用
+		auto run = [&](const char *op, auto setup, auto fn, const Document *result) {
+			if (!selected(options.ops, op)) return;
+			Measurement m = measure(options, counters, setup, fn);
+			setup();
+			AllocationSample allocations = Engine::countAllocations(fn);
+			m.allocations = allocations.allocations;
+			m.frees = allocations.frees;
+			m.peakBytes = allocations.peakBytes;
+			m.memoryBytes = result ? Engine::memory(*result) : std::nan("");
+			m.corpus = corpus.name;
+			m.engine = Engine::name;
+			m.op = op;
+			m.bytes = corpus.text.size();
+			m.nodes = corpus.nodes;
+			reporter.report(m);
+		};
+		auto none = [] {};
+		auto clear = [&] { Engine::destroy(other); };// 释放上一次的结果，不计入parse与copy
+		run("parse", clear, [&] { sink = Engine::parse(corpus.text, other); }, &other);
+		run("serialize", none, [&] { sink = Engine::serialize(doc); }, nullptr);
+		run("copy", clear, [&] { Engine::copy(doc, other); }, &other);
+		Engine::copy(doc, other);
+		run("equal", none, [&] { sink = Engine::equal(doc, other); }, nullptr);
+		run("destroy", [&] { Engine::copy(doc, other); }, [&] { Engine::destroy(other); }, nullptr);
+	}
+
+	bool parseOption(const char *arg, const char *name, std::string &value) {
+		size_t n = strlen(name);
+		if (strncmp(arg, name, n) != 0 || arg[n] != '=') return false;
+		value = arg + n + 1;
+		return true;
+	}
+
+	void usage(const char *program) {
+		std::cerr << "usage: " << program << " [options]\n"
+				  << "  --size=BYTES       approximate size of each corpus (default 1048576)\n"
+				  << "  --warmup=N         untimed runs before measuring (default 2)\n"
+				  << "  --reps=N           timed repetitions (default 10)\n"
+				  << "  --seed=N           corpus generator seed\n"
+				  << "  --corpus=LIST      twitter,canada,citm,long_strings,deep,twitter_pretty\n"
+				  << "  --engine=LIST      cpp,c\n"
+				  << "  --op=LIST          parse,serialize,copy,equal,destroy\n"
+				  << "  --format=FORMAT    jsonl (default) or csv\n"
+				  << "  --dump=DIR         write the generated corpora to DIR\n"
+				  << "  --counters=on|off  read hardware performance counters (default on, Linux only)\n";
+	}
+}// namespace
+
+int main(int argc, char *argv[]) {
+	Options options;
+	for (int i = 1; i < argc; ++i) {
+		std::string value;
+		if (parseOption(argv[i], "--size", value)) options.size = std::strtoull(value.c_str(), nullptr, 10);
+		else if (parseOption(argv[i], "--warmup", value)) options.warmup = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else if (parseOption(argv[i], "--reps", value)) options.reps = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else if (parseOption(argv[i], "--seed", value)) options.seed = std::strtoull(value.c_str(), nullptr, 10);
+		else if (parseOption(argv[i], "--corpus", options.corpora)) {
+		} else if (parseOption(argv[i], "--engine", options.engines)) {
+		} else if (parseOption(argv[i], "--op", options.ops)) {
+		} else if (parseOption(argv[i], "--format", options.format)) {
+		} else if (parseOption(argv[i], "--dump", options.dump)) {
+		} else if (parseOption(argv[i], "--counters", value) && (value == "on" || value == "off")) {
+			options.counters = value == "on";
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (options.reps == 0 || (options.format != "jsonl" && options.format != "csv")) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Corpus corpora[] = {
+			{"twitter", generateTwitter, {}, 0},
+			{"canada", generateCanada, {}, 0},
+			{"citm", generateCitm, {}, 0},
+			{"long_strings", generateLongStrings, {}, 0},
+			{"deep", generateDeep, {}, 0},
+			{"twitter_pretty", generateTwitterPretty, {}, 0},
+	};
+	PerfCounters counters(options.counters);
+	if (options.counters && !counters.error().empty()) {
+		std::cerr << "performance counters unavailable (" << counters.error() << ")"
+				  << (counters.any() ? ", reporting the rest" : ", reporting timings only") << std::endl;
+	}
+	Reporter reporter(options.format);
+	for (auto &corpus : corpora) {
+		if (!selected(options.corpora, corpus.name)) continue;
+		Random random(options.seed);
+		corpus.text = corpus.generate(random, options.size);
+		if (!options.dump.empty()) {
+			std::ofstream(options.dump + "/" + corpus.name + ".json", std::ios::binary) << corpus.text;
+		}
+		{
+			CDocument doc;
+			corpus.nodes = CEngine::parse(corpus.text, doc) ? countNodes(doc.get()) : 0;
+		}
+		runEngine<CppEngine>(options, corpus, counters, reporter);
+		runEngine<CEngine>(options, corpus, counters, reporter);
+		corpus.text.clear();
+		corpus.text.shrink_to_fit();
+	}
+	return EXIT_SUCCESS;
+}
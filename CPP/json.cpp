@@ -58,6 +58,7 @@ namespace DianaJSON {
 				break;
 			}
 		}
+		_value->copyHash(*rhs._value);
 	}
 
 	Json &Json::operator=(const Json &rhs) noexcept {
@@ -108,6 +109,19 @@ namespace DianaJSON {
 	const Json::_object &Json::toObject() const {
 		return _value->toObject();
 	}
+	Json::_array &Json::asArray() {
+		return _value->asArray();
+	}
+	Json::_object &Json::asObject() {
+		return _value->asObject();
+	}
+
+	uint64_t Json::hash() const noexcept {
+		return _value->hash();
+	}
+	uint64_t Json::cachedHash() const noexcept {
+		return _value->cachedHash();
+	}
 
 	size_t Json::size() const {
 		return _value->size();
@@ -135,92 +149,144 @@ namespace DianaJSON {
 		}
 	}
 
+#ifdef DIANA_JSON_PARSE_STATS
+	Json Json::parse(const std::string &context, std::string &errorText, JsonParseStats &stats) noexcept {
+		Parser p(context);
+		Json json(nullptr);
+		try {
+			json = p.parse();
+		} catch (JsonException &e) {
+			errorText = e.what();
+		}
+		stats = p.stats();
+		return json;
+	}
+#endif
+
+	Json Json::parse(const std::string &context, const std::vector<std::string> &paths, std::string &errorText) noexcept {
+		try {
+			Projection projection;
+			for (auto &path : paths) {
+				projection.add(path);
+			}
+			Parser p(context);
+			return p.parse(projection);
+		} catch (JsonException &e) {
+			errorText = e.what();
+			return Json(nullptr);
+		}
+	}
+
 	std::string Json::serialize() const noexcept {
+		std::string res;
+		serialize(res);
+		return res;
+	}
+	void Json::serialize(std::string &out) const noexcept {
 		switch (_value->getType()) {
 			case JsonValueType::Null:
-				return "null";
+				out += "null";
+				break;
 			case JsonValueType::Bool:
-				return _value->toBool() ? "true" : "false";
+				out += _value->toBool() ? "true" : "false";
+				break;
 			case JsonValueType::Number:
-				char buf[32];
-				snprintf(
-						buf, sizeof(buf), "%.17g",
-						_value->toDouble());
-				return std::string(buf);
-			case JsonValueType::String:
-				return serializeString();
+				writeNumber(out, _value->toDouble());
+				break;
+			case JsonValueType::String: {
+				auto &str = _value->toString();
+				writeString(out, str.data(), str.size());
+				break;
+			}
 			case JsonValueType::Array:
-				return serializeArray();
+				serializeArray(out);
+				break;
 			default:
-				return serializeObject();
+				serializeObject(out);
+				break;
 		}
 	}
-	std::string Json::serializeString() const noexcept {
-		std::string res = "\"";
-		for (auto e : _value->toString()) {
+	void Json::serializeArray(std::string &out) const noexcept {
+		out += "[ ";
+		for (size_t i = 0; i != _value->size(); ++i) {
+			if (i > 0) {
+				out += ", ";
+			}
+			(*this)[i].serialize(out);
+		}
+		out += " ]";
+	}
+	void Json::serializeObject(std::string &out) const noexcept {
+		out += "{ ";
+		bool first = true;
+		for (auto &&p : _value->toObject()) {
+			if (first) {
+				first = false;
+			} else {
+				out += ", ";
+			}
+			writeString(out, p.first.data(), p.first.size());
+			out += ": ";
+			p.second.serialize(out);
+		}
+		out += " }";
+	}
+
+	void writeString(std::string &out, const char *s, size_t len) {
+		out += '"';
+		for (size_t i = 0; i != len; ++i) {
+			char e = s[i];
 			switch (e) {
 				case '\"':
-					res += "\\\"";
+					out += "\\\"";
 					break;
 				case '\\':
-					res += "\\\\";
+					out += "\\\\";
 					break;
 				case '\b':
-					res += "\\b";
+					out += "\\b";
 					break;
 				case '\f':
-					res += "\\f";
+					out += "\\f";
 					break;
 				case '\n':
-					res += "\\n";
+					out += "\\n";
 					break;
 				case '\r':
-					res += "\\r";
+					out += "\\r";
 					break;
 				case '\t':
-					res += "\\t";
+					out += "\\t";
 					break;
 				default:
 					if (static_cast<unsigned char>(e) < 0x20) {
 						char buf[7];
-						sprintf(buf, "\\u%04X", e);
-						res += buf;
+						snprintf(buf, sizeof(buf), "\\u%04X", e);
+						out += buf;
 					} else
-						res += e;
+						out += e;
 			}
 		}
-		return res + '"';
+		out += '"';
 	}
-	std::string Json::serializeArray() const noexcept {
-		std::string res = "[ ";
-		for (size_t i = 0; i != _value->size(); ++i) {
-			if (i > 0) {
-				res += ", ";
-			}
-			res += (*this)[i].serialize();
-		}
-		return res + " ]";
-	}
-	std::string Json::serializeObject() const noexcept {
-		std::string res = "{ ";
-		bool first = true;
-		for (auto &&p : _value->toObject()) {
-			if (first) {
-				first = false;
-			} else {
-				res += ", ";
-			}
-			res += "\"" + p.first + "\"";
-			res += ": ";
-			res += p.second.serialize();
-		}
-		return res + " }";
+
+	void writeNumber(std::string &out, double n) {
+		char buf[32];
+		out.append(buf, snprintf(buf, sizeof(buf), "%.17g", n));
 	}
 
 	bool operator==(const Json &lhs, const Json &rhs) {
+		if (&lhs == &rhs) {
+			return true;
+		}
 		if (lhs.getType() != rhs.getType()) {
 			return false;
 		}
+		// 双方均已缓存哈希时O(1)排除不等
+		uint64_t lhsHash = lhs.cachedHash(), rhsHash = rhs.cachedHash();
+		if (lhsHash != 0 && rhsHash != 0 && lhsHash != rhsHash) {
+			return false;
+		}
 		switch (lhs.getType()) {
 			case JsonValueType::Null: {
 				return true;
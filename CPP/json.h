@@ -1,6 +1,8 @@
 #ifndef JSON_H
 #define JSON_H
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -20,11 +22,99 @@ namespace DianaJSON {
 	// 为JsonValue内部类前向声明（std::unique_ptr）
 	class JsonValue;
 
+	// 内存占用：Json树持有的堆内存字节数与各类型的节点数
+	// 字节数包含每个节点的JsonValue、数组的容量、对象的哈希桶与节点、超出短字符串优化的字符串，
+	// 其中unordered_map的节点大小按常见标准库的布局（next指针、键值对与缓存的哈希值）估算，不含分配器自身的开销
+	struct JsonMemoryUsage {
+		size_t bytes = 0;
+		size_t nodes[6] = {};// 以JsonValueType为下标
+	};
+
+	// 分配统计：以DIANA_JSON_COUNT_ALLOCATIONS编译时，统计计数器存活期间当前线程上Json树自身的分配（可以嵌套），
+	// 即JsonValue节点、数组的缓冲区与对象的节点和哈希桶；字符串与键的字符缓冲区以及程序其余部分的分配不计入，
+	// 也不替换全局operator new/delete；未开启时enabled()为false，各项始终为0
+	struct JsonAllocationStats {
+		size_t allocations = 0, frees = 0;
+		int64_t bytes = 0, peak = 0;// 占用相对开始（reset）时的变化及其最大值，释放此前分配的内存时可为负
+	};
+
+#ifdef DIANA_JSON_PARSE_STATS
+	// 解析统计：以DIANA_JSON_PARSE_STATS编译时由Parser::parse填写，未开启时统计代码不参与编译
+	struct JsonParseStats {
+		size_t bytes = 0;           // 消耗的字节数，出错时为出错的位置
+		size_t values[6] = {};      // 各类型的值的个数，以JsonValueType为下标，不含对象的键
+		size_t keys = 0;            // 对象键的个数
+		size_t stringBytes = 0;     // 字符串与键解码后的字节数
+		size_t escapes = 0;         // 转义序列数（含\u）
+		size_t unicodeEscapes = 0;  // \u转义数，代理对计为2
+		size_t maxDepth = 0;        // 数组与对象的最大嵌套深度
+		size_t largestContainer = 0;// 数组元素数与对象成员数的最大值
+		double seconds = 0;         // 解析所用的时间
+	};
+#endif
+
+	// 计数入口，由计数分配器与JsonValue的operator new/delete调用
+	struct JsonAllocationHook {
+		static void record(int64_t bytes) noexcept;
+	};
+
+#ifdef DIANA_JSON_COUNT_ALLOCATIONS
+	// 计数分配器：Json的数组与对象经此分配，统计后转交std::allocator
+	template<class T>
+	struct JsonCountingAllocator {
+		using value_type = T;
+
+		JsonCountingAllocator() noexcept = default;
+		template<class U>
+		JsonCountingAllocator(const JsonCountingAllocator<U> &) noexcept {}
+
+		T *allocate(size_t n) {
+			T *p = std::allocator<T>().allocate(n);
+			JsonAllocationHook::record(static_cast<int64_t>(n * sizeof(T)));
+			return p;
+		}
+		void deallocate(T *p, size_t n) noexcept {
+			JsonAllocationHook::record(-static_cast<int64_t>(n * sizeof(T)));
+			std::allocator<T>().deallocate(p, n);
+		}
+
+		template<class U>
+		bool operator==(const JsonCountingAllocator<U> &) const noexcept { return true; }
+		template<class U>
+		bool operator!=(const JsonCountingAllocator<U> &) const noexcept { return false; }
+	};
+#endif
+
+	class JsonAllocationCounter final {
+	public:
+		JsonAllocationCounter() noexcept;
+		~JsonAllocationCounter();
+
+		JsonAllocationCounter(const JsonAllocationCounter &) = delete;
+		JsonAllocationCounter &operator=(const JsonAllocationCounter &) = delete;
+
+	public:
+		const JsonAllocationStats &stats() const noexcept { return _stats; }
+		void reset() noexcept { _stats = JsonAllocationStats(); }
+		static bool enabled() noexcept;
+
+	private:
+		friend struct JsonAllocationHook;
+		JsonAllocationStats _stats;
+		JsonAllocationCounter *_outer;
+	};
+
 	class Json final {
 	public:
 		// 类型重名
+#ifdef DIANA_JSON_COUNT_ALLOCATIONS
+		using _array = std::vector<Json, JsonCountingAllocator<Json>>;
+		using _object = std::unordered_map<std::string, Json, std::hash<std::string>, std::equal_to<std::string>,
+										   JsonCountingAllocator<std::pair<const std::string, Json>>>;
+#else
 		using _array = std::vector<Json>;
 		using _object = std::unordered_map<std::string, Json>;
+#endif
 
 	public:
 		// 构造函数
@@ -96,10 +186,46 @@ namespace DianaJSON {
 		const _array &toArray() const;
 		const _object &toObject() const;
 
+	public:
+		// 可修改的数组与对象接口，类型不符时抛出异常
+		_array &asArray();
+		_object &asObject();
+
 	public:
 		// 解析与生成器接口
 		static Json parse(const std::string &context, std::string &errorText) noexcept;// 解析
+		// 投影解析：仅保留paths中以'.'分隔的路径（如"user.name"），其余子树跳过不解码
+		static Json parse(const std::string &context, const std::vector<std::string> &paths, std::string &errorText) noexcept;
+#ifdef DIANA_JSON_PARSE_STATS
+		static Json parse(const std::string &context, std::string &errorText, JsonParseStats &stats) noexcept;// 解析并填写统计
+#endif
 		std::string serialize() const noexcept;                                        // 生成器
+		void serialize(std::string &out) const noexcept;                               // 生成器，追加到out末尾
+
+	public:
+		// 二进制编解码（CBOR与MessagePack），数字以原生整数/浮点格式存储，字符串带长度前缀
+		// 解码时字节串（CBOR bytes、MessagePack bin）按字符串处理，对象键必须为字符串
+		static Json parseCBOR(const std::string &data, std::string &errorText) noexcept;
+		std::string serializeCBOR() const noexcept;
+		static Json parseMessagePack(const std::string &data, std::string &errorText) noexcept;
+		std::string serializeMessagePack() const noexcept;
+
+	public:
+		// JSON Patch（RFC 6902），原地修改；任一操作失败（含test不通过）时按撤销日志回滚并返回false
+		bool applyPatch(const Json &patch, std::string &errorText) noexcept;
+		// JSON Merge Patch（RFC 7396），原地修改
+		void applyMergePatch(const Json &patch);
+		// 结构化哈希，与operator==一致（相等的值哈希相同）；数组与对象惰性计算后缓存，
+		// 经可修改的访问接口（asArray、asObject、非const operator[]）访问过的节点可能被调用方持有的子节点引用修改，
+		// 因此清除缓存并从此每次重新计算
+		uint64_t hash() const noexcept;
+		uint64_t cachedHash() const noexcept;// 已缓存的哈希，未缓存或非容器时为0
+		// 内存占用，遍历整棵树
+		JsonMemoryUsage memoryUsage() const;
+
+		// 结构化差异，返回将from变为to的JSON Patch；数组按LCS对齐，
+		// 元素数之积超过lcsCostCap时退化为按下标逐一比较
+		static Json diff(const Json &from, const Json &to, size_t lcsCostCap = 1 << 20);
 
 	public:
 		// 数组和对象数据接口
@@ -112,14 +238,17 @@ namespace DianaJSON {
 		const Json &operator[](const std::string &) const;
 
 	private:
-		std::string serializeString() const noexcept;
-		std::string serializeArray() const noexcept;
-		std::string serializeObject() const noexcept;
+		void serializeArray(std::string &out) const noexcept;
+		void serializeObject(std::string &out) const noexcept;
 
 	private:
 		std::unique_ptr<JsonValue> _value;// PIMPL
 	};
 
+	// 生成器共享的字符串转义与数字格式化，追加到out末尾
+	void writeString(std::string &out, const char *s, size_t len);
+	void writeNumber(std::string &out, double n);
+
 	inline std::ostream &operator<<(std::ostream &os, const Json &json) {
 		return os << json.serialize();
 	}
@@ -129,4 +258,14 @@ namespace DianaJSON {
 	}
 }// namespace DianaJSON
 
+namespace std {
+	// 可将Json用作无序容器的键
+	template<>
+	struct hash<DianaJSON::Json> {
+		size_t operator()(const DianaJSON::Json &json) const noexcept {
+			return static_cast<size_t>(json.hash());
+		}
+	};
+}// namespace std
+
 #endif
\ No newline at end of file
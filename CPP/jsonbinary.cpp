@@ -0,0 +1,521 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "json.h"
+#include "jsonerror.h"
+
+namespace DianaJSON {
+	namespace {
+		// 以大端序追加整数
+		void putBigEndian(std::string &out, uint64_t u, int bytes) {
+			for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+				out += static_cast<char>((u >> shift) & 0xFF);
+			}
+		}
+
+		// 可无损表示为int64的整数值（-0除外）
+		bool isIntegral(double n) {
+			return n == std::floor(n) && n >= -9223372036854775808.0 && n < 9223372036854775808.0 && !(n == 0 && std::signbit(n));
+		}
+
+		bool fitsFloat(double n) {
+			return static_cast<double>(static_cast<float>(n)) == n;
+		}
+
+		uint32_t floatBits(double n) {
+			float f = static_cast<float>(n);
+			uint32_t u;
+			memcpy(&u, &f, sizeof(u));
+			return u;
+		}
+
+		uint64_t doubleBits(double n) {
+			uint64_t u;
+			memcpy(&u, &n, sizeof(u));
+			return u;
+		}
+
+		// 数组与对象的最大嵌套深度，解码时逐层递归，超过时报错而不是耗尽调用栈（与C版本的DIANA_PARSE_MAX_DEPTH相同）
+		constexpr size_t maxDepth = 1024;
+
+		// 二进制输入游标，越界时报错
+		class BinaryReader {
+		public:
+			explicit BinaryReader(const std::string &data) : _curr(data.data()), _end(data.data() + data.size()) {}
+
+			bool atEnd() const noexcept { return _curr == _end; }
+			uint8_t peek() const {
+				need(1);
+				return static_cast<uint8_t>(*_curr);
+			}
+			uint8_t byte() {
+				need(1);
+				return static_cast<uint8_t>(*_curr++);
+			}
+			uint64_t bigEndian(int bytes) {
+				need(bytes);
+				uint64_t u = 0;
+				for (int i = 0; i != bytes; ++i) {
+					u = (u << 8) | static_cast<uint8_t>(*_curr++);
+				}
+				return u;
+			}
+			std::string bytes(uint64_t len) {
+				need(len);
+				std::string res(_curr, len);
+				_curr += len;
+				return res;
+			}
+			void need(uint64_t len) const {
+				if (static_cast<uint64_t>(_end - _curr) < len) {
+					throw JsonException("INVALID BINARY: unexpected end of input");
+				}
+			}
+			// 进入与离开一层数组或对象；出错时整个解码中止，无需配对离开
+			void enter() {
+				if (++_depth > maxDepth) {
+					throw JsonException("DEPTH EXCEEDED");
+				}
+			}
+			void leave() noexcept { --_depth; }
+
+		private:
+			const char *_curr;
+			const char *_end;
+			size_t _depth = 0;
+		};
+
+		double toFloat(uint32_t u) {
+			float f;
+			memcpy(&f, &u, sizeof(f));
+			return f;
+		}
+
+		double toDouble(uint64_t u) {
+			double d;
+			memcpy(&d, &u, sizeof(d));
+			return d;
+		}
+
+		// CBOR（RFC 8949）
+		void cborHead(std::string &out, uint8_t major, uint64_t u) {
+			major <<= 5;
+			if (u < 24) {
+				out += static_cast<char>(major | u);
+			} else if (u <= 0xFF) {
+				out += static_cast<char>(major | 24);
+				putBigEndian(out, u, 1);
+			} else if (u <= 0xFFFF) {
+				out += static_cast<char>(major | 25);
+				putBigEndian(out, u, 2);
+			} else if (u <= 0xFFFFFFFF) {
+				out += static_cast<char>(major | 26);
+				putBigEndian(out, u, 4);
+			} else {
+				out += static_cast<char>(major | 27);
+				putBigEndian(out, u, 8);
+			}
+		}
+
+		void cborEncode(std::string &out, const Json &json) {
+			switch (json.getType()) {
+				case JsonValueType::Null:
+					out += static_cast<char>(0xF6);
+					break;
+				case JsonValueType::Bool:
+					out += static_cast<char>(json.toBool() ? 0xF5 : 0xF4);
+					break;
+				case JsonValueType::Number: {
+					double n = json.toDouble();
+					if (isIntegral(n)) {
+						auto i = static_cast<int64_t>(n);
+						if (i >= 0) {
+							cborHead(out, 0, static_cast<uint64_t>(i));
+						} else {
+							cborHead(out, 1, static_cast<uint64_t>(-1 - i));
+						}
+					} else if (fitsFloat(n)) {
+						out += static_cast<char>(0xFA);
+						putBigEndian(out, floatBits(n), 4);
+					} else {
+						out += static_cast<char>(0xFB);
+						putBigEndian(out, doubleBits(n), 8);
+					}
+					break;
+				}
+				case JsonValueType::String: {
+					auto &str = json.toString();
+					cborHead(out, 3, str.size());
+					out += str;
+					break;
+				}
+				case JsonValueType::Array: {
+					auto &arr = json.toArray();
+					cborHead(out, 4, arr.size());
+					for (auto &e : arr) cborEncode(out, e);
+					break;
+				}
+				case JsonValueType::Object: {
+					auto &obj = json.toObject();
+					cborHead(out, 5, obj.size());
+					for (auto &p : obj) {
+						cborHead(out, 3, p.first.size());
+						out += p.first;
+						cborEncode(out, p.second);
+					}
+					break;
+				}
+			}
+		}
+
+		// 读取首字节之后的参数，ai == 31（不定长）时返回false
+		bool cborArgument(BinaryReader &in, uint8_t ai, uint64_t &u) {
+			if (ai < 24) {
+				u = ai;
+			} else if (ai >= 24 && ai <= 27) {
+				u = in.bigEndian(1 << (ai - 24));
+			} else if (ai == 31) {
+				return false;
+			} else {
+				throw JsonException("INVALID BINARY: reserved additional information");
+			}
+			return true;
+		}
+
+		double halfToDouble(uint16_t h) {
+			int exp = (h >> 10) & 0x1F;
+			int mant = h & 0x3FF;
+			double val;
+			if (exp == 0)
+				val = std::ldexp(mant, -24);
+			else if (exp != 31)
+				val = std::ldexp(mant + 1024, exp - 25);
+			else
+				val = mant == 0 ? INFINITY : NAN;
+			return (h & 0x8000) ? -val : val;
+		}
+
+		std::string cborString(BinaryReader &in, uint8_t major, uint8_t ai) {
+			uint64_t len;
+			if (cborArgument(in, ai, len)) {
+				return in.bytes(len);
+			}
+			// 不定长字符串由同类型定长分块组成
+			std::string res;
+			while (in.peek() != 0xFF) {
+				uint8_t head = in.byte();
+				if ((head >> 5) != major || !cborArgument(in, head & 0x1F, len)) {
+					throw JsonException("INVALID BINARY: bad string chunk");
+				}
+				res += in.bytes(len);
+			}
+			in.byte();
+			return res;
+		}
+
+		Json cborDecode(BinaryReader &in) {
+			uint8_t head = in.byte();
+			uint8_t major = head >> 5, ai = head & 0x1F;
+			uint64_t u = 0;
+			while (major == 6) {// 忽略标签（可以连续多个），解码被标记的值
+				if (!cborArgument(in, ai, u)) throw JsonException("INVALID BINARY: indefinite tag");
+				head = in.byte();
+				major = head >> 5;
+				ai = head & 0x1F;
+			}
+			switch (major) {
+				case 0:
+					if (!cborArgument(in, ai, u)) throw JsonException("INVALID BINARY: indefinite integer");
+					return Json(static_cast<double>(u));
+				case 1:
+					if (!cborArgument(in, ai, u)) throw JsonException("INVALID BINARY: indefinite integer");
+					return Json(-1.0 - static_cast<double>(u));
+				case 2:// 字节串按字符串处理
+				case 3:
+					return Json(cborString(in, major, ai));
+				case 4: {
+					Json::_array arr;
+					in.enter();
+					if (cborArgument(in, ai, u)) {
+						in.need(u);// 每个元素至少一个字节
+						arr.reserve(u);
+						for (uint64_t i = 0; i != u; ++i) arr.push_back(cborDecode(in));
+					} else {
+						while (in.peek() != 0xFF) arr.push_back(cborDecode(in));
+						in.byte();
+					}
+					in.leave();
+					return Json(std::move(arr));
+				}
+				case 5: {
+					Json::_object obj;
+					in.enter();
+					bool definite = cborArgument(in, ai, u);
+					for (uint64_t i = 0; definite ? i != u : in.peek() != 0xFF; ++i) {
+						uint8_t keyHead = in.byte();
+						if ((keyHead >> 5) != 3) throw JsonException("INVALID BINARY: map key is not a text string");
+						std::string key = cborString(in, 3, keyHead & 0x1F);
+						obj[std::move(key)] = cborDecode(in);
+					}
+					if (!definite) in.byte();
+					in.leave();
+					return Json(std::move(obj));
+				}
+				default:
+					switch (ai) {
+						case 20:
+							return Json(false);
+						case 21:
+							return Json(true);
+						case 22:
+						case 23:
+							return Json(nullptr);
+						case 25:
+							return Json(halfToDouble(static_cast<uint16_t>(in.bigEndian(2))));
+						case 26:
+							return Json(toFloat(static_cast<uint32_t>(in.bigEndian(4))));
+						case 27:
+							return Json(toDouble(in.bigEndian(8)));
+						default:
+							throw JsonException("INVALID BINARY: unsupported simple value");
+					}
+			}
+		}
+
+		// MessagePack
+		void msgpackLength(std::string &out, uint64_t len, uint8_t fix, uint8_t fixMax, uint8_t base8, uint8_t base16) {
+			if (fix && len <= fixMax) {
+				out += static_cast<char>(fix | len);
+			} else if (base8 && len <= 0xFF) {
+				out += static_cast<char>(base8);
+				putBigEndian(out, len, 1);
+			} else if (len <= 0xFFFF) {
+				out += static_cast<char>(base16);
+				putBigEndian(out, len, 2);
+			} else {
+				out += static_cast<char>(base16 + 1);
+				putBigEndian(out, len, 4);
+			}
+		}
+
+		void msgpackEncode(std::string &out, const Json &json) {
+			switch (json.getType()) {
+				case JsonValueType::Null:
+					out += static_cast<char>(0xC0);
+					break;
+				case JsonValueType::Bool:
+					out += static_cast<char>(json.toBool() ? 0xC3 : 0xC2);
+					break;
+				case JsonValueType::Number: {
+					double n = json.toDouble();
+					if (isIntegral(n)) {
+						auto i = static_cast<int64_t>(n);
+						if (i >= 0) {
+							if (i <= 0x7F) {
+								out += static_cast<char>(i);
+							} else if (i <= 0xFF) {
+								out += static_cast<char>(0xCC);
+								putBigEndian(out, i, 1);
+							} else if (i <= 0xFFFF) {
+								out += static_cast<char>(0xCD);
+								putBigEndian(out, i, 2);
+							} else if (i <= 0xFFFFFFFF) {
+								out += static_cast<char>(0xCE);
+								putBigEndian(out, i, 4);
+							} else {
+								out += static_cast<char>(0xCF);
+								putBigEndian(out, i, 8);
+							}
+						} else if (i >= -32) {
+							out += static_cast<char>(i);
+						} else if (i >= INT8_MIN) {
+							out += static_cast<char>(0xD0);
+							putBigEndian(out, static_cast<uint64_t>(i), 1);
+						} else if (i >= INT16_MIN) {
+							out += static_cast<char>(0xD1);
+							putBigEndian(out, static_cast<uint64_t>(i), 2);
+						} else if (i >= INT32_MIN) {
+							out += static_cast<char>(0xD2);
+							putBigEndian(out, static_cast<uint64_t>(i), 4);
+						} else {
+							out += static_cast<char>(0xD3);
+							putBigEndian(out, static_cast<uint64_t>(i), 8);
+						}
+					} else if (fitsFloat(n)) {
+						out += static_cast<char>(0xCA);
+						putBigEndian(out, floatBits(n), 4);
+					} else {
+						out += static_cast<char>(0xCB);
+						putBigEndian(out, doubleBits(n), 8);
+					}
+					break;
+				}
+				case JsonValueType::String: {
+					auto &str = json.toString();
+					msgpackLength(out, str.size(), 0xA0, 31, 0xD9, 0xDA);
+					out += str;
+					break;
+				}
+				case JsonValueType::Array: {
+					auto &arr = json.toArray();
+					msgpackLength(out, arr.size(), 0x90, 15, 0, 0xDC);
+					for (auto &e : arr) msgpackEncode(out, e);
+					break;
+				}
+				case JsonValueType::Object: {
+					auto &obj = json.toObject();
+					msgpackLength(out, obj.size(), 0x80, 15, 0, 0xDE);
+					for (auto &p : obj) {
+						msgpackLength(out, p.first.size(), 0xA0, 31, 0xD9, 0xDA);
+						out += p.first;
+						msgpackEncode(out, p.second);
+					}
+					break;
+				}
+			}
+		}
+
+		int64_t signExtend(uint64_t u, int bytes) {
+			int shift = 64 - bytes * 8;
+			return static_cast<int64_t>(u << shift) >> shift;
+		}
+
+		std::string msgpackString(BinaryReader &in) {
+			uint8_t head = in.byte();
+			if ((head & 0xE0) == 0xA0) return in.bytes(head & 0x1F);
+			switch (head) {
+				case 0xC4:// bin按字符串处理
+				case 0xD9:
+					return in.bytes(in.bigEndian(1));
+				case 0xC5:
+				case 0xDA:
+					return in.bytes(in.bigEndian(2));
+				case 0xC6:
+				case 0xDB:
+					return in.bytes(in.bigEndian(4));
+				default:
+					throw JsonException("INVALID BINARY: map key is not a string");
+			}
+		}
+
+		Json msgpackArray(BinaryReader &in, uint64_t size);
+		Json msgpackMap(BinaryReader &in, uint64_t size);
+
+		Json msgpackDecode(BinaryReader &in) {
+			uint8_t head = in.peek();
+			if (head <= 0x7F) return Json(static_cast<double>(in.byte()));
+			if (head >= 0xE0) return Json(static_cast<double>(static_cast<int8_t>(in.byte())));
+			if ((head & 0xE0) == 0xA0) return Json(msgpackString(in));
+			in.byte();
+			if ((head & 0xF0) == 0x90) return msgpackArray(in, head & 0x0F);
+			if ((head & 0xF0) == 0x80) return msgpackMap(in, head & 0x0F);
+			switch (head) {
+				case 0xC0:
+					return Json(nullptr);
+				case 0xC2:
+					return Json(false);
+				case 0xC3:
+					return Json(true);
+				case 0xC4:
+				case 0xD9:
+					return Json(in.bytes(in.bigEndian(1)));
+				case 0xC5:
+				case 0xDA:
+					return Json(in.bytes(in.bigEndian(2)));
+				case 0xC6:
+				case 0xDB:
+					return Json(in.bytes(in.bigEndian(4)));
+				case 0xCA:
+					return Json(toFloat(static_cast<uint32_t>(in.bigEndian(4))));
+				case 0xCB:
+					return Json(toDouble(in.bigEndian(8)));
+				case 0xCC:
+					return Json(static_cast<double>(in.bigEndian(1)));
+				case 0xCD:
+					return Json(static_cast<double>(in.bigEndian(2)));
+				case 0xCE:
+					return Json(static_cast<double>(in.bigEndian(4)));
+				case 0xCF:
+					return Json(static_cast<double>(in.bigEndian(8)));
+				case 0xD0:
+					return Json(static_cast<double>(signExtend(in.bigEndian(1), 1)));
+				case 0xD1:
+					return Json(static_cast<double>(signExtend(in.bigEndian(2), 2)));
+				case 0xD2:
+					return Json(static_cast<double>(signExtend(in.bigEndian(4), 4)));
+				case 0xD3:
+					return Json(static_cast<double>(signExtend(in.bigEndian(8), 8)));
+				case 0xDC:
+					return msgpackArray(in, in.bigEndian(2));
+				case 0xDD:
+					return msgpackArray(in, in.bigEndian(4));
+				case 0xDE:
+					return msgpackMap(in, in.bigEndian(2));
+				case 0xDF:
+					return msgpackMap(in, in.bigEndian(4));
+				default:
+					throw JsonException("INVALID BINARY: unsupported type");
+			}
+		}
+
+		Json msgpackArray(BinaryReader &in, uint64_t size) {
+			in.need(size);// 每个元素至少一个字节
+			in.enter();
+			Json::_array arr;
+			arr.reserve(size);
+			for (uint64_t i = 0; i != size; ++i) arr.push_back(msgpackDecode(in));
+			in.leave();
+			return Json(std::move(arr));
+		}
+
+		Json msgpackMap(BinaryReader &in, uint64_t size) {
+			in.need(size * 2);
+			in.enter();
+			Json::_object obj;
+			obj.reserve(size);
+			for (uint64_t i = 0; i != size; ++i) {
+				std::string key = msgpackString(in);
+				obj[std::move(key)] = msgpackDecode(in);
+			}
+			in.leave();
+			return Json(std::move(obj));
+		}
+
+		template<class Decode>
+		Json decodeRoot(const std::string &data, std::string &errorText, Decode decode) noexcept {
+			try {
+				BinaryReader in(data);
+				Json json = decode(in);
+				if (!in.atEnd()) {
+					throw JsonException("INVALID BINARY: trailing bytes");
+				}
+				return json;
+			} catch (JsonException &e) {
+				errorText = e.what();
+				return Json(nullptr);
+			}
+		}
+	}// namespace
+
+	std::string Json::serializeCBOR() const noexcept {
+		std::string out;
+		cborEncode(out, *this);
+		return out;
+	}
+
+	Json Json::parseCBOR(const std::string &data, std::string &errorText) noexcept {
+		return decodeRoot(data, errorText, cborDecode);
+	}
+
+	std::string Json::serializeMessagePack() const noexcept {
+		std::string out;
+		msgpackEncode(out, *this);
+		return out;
+	}
+
+	Json Json::parseMessagePack(const std::string &data, std::string &errorText) noexcept {
+		return decodeRoot(data, errorText, msgpackDecode);
+	}
+
+}// namespace DianaJSON
@@ -0,0 +1,359 @@
+#ifndef JSONBIND_H
+#define JSONBIND_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+#include "parse.h"
+
+namespace DianaJSON {
+	// 结构体成员描述：JSON键名与成员指针，键长为编译期常量
+	template<class T, class M, size_t N>
+	struct JsonField {
+		using type = M;
+		static constexpr size_t length = N - 1;
+
+		const char *name;
+		M T::*member;
+	};
+
+	template<class T, class M, size_t N>
+	constexpr JsonField<T, M, N> makeJsonField(const char (&name)[N], M T::*member) {
+		return {name, member};
+	}
+
+	// 编译期生成的键前缀：加引号、转义并带有": "，转义规则与writeString()一致
+	template<size_t N>
+	struct JsonQuotedKey {
+		char data[N * 6 + 4] = {};
+		size_t size = 0;
+	};
+
+	template<size_t N>
+	constexpr JsonQuotedKey<N> quoteKey(const char *name) {
+		const char hex[] = "0123456789ABCDEF";
+		JsonQuotedKey<N> key;
+		key.data[key.size++] = '"';
+		for (size_t i = 0; i != N; ++i) {
+			char ch = name[i];
+			char escaped = 0;
+			switch (ch) {
+				case '"':
+				case '\\':
+					escaped = ch;
+					break;
+				case '\b':
+					escaped = 'b';
+					break;
+				case '\f':
+					escaped = 'f';
+					break;
+				case '\n':
+					escaped = 'n';
+					break;
+				case '\r':
+					escaped = 'r';
+					break;
+				case '\t':
+					escaped = 't';
+					break;
+				default:
+					break;
+			}
+			if (escaped) {
+				key.data[key.size++] = '\\';
+				key.data[key.size++] = escaped;
+			} else if (static_cast<unsigned char>(ch) < 0x20) {
+				key.data[key.size++] = '\\';
+				key.data[key.size++] = 'u';
+				key.data[key.size++] = '0';
+				key.data[key.size++] = '0';
+				key.data[key.size++] = hex[ch >> 4];
+				key.data[key.size++] = hex[ch & 15];
+			} else {
+				key.data[key.size++] = ch;
+			}
+		}
+		key.data[key.size++] = '"';
+		key.data[key.size++] = ':';
+		key.data[key.size++] = ' ';
+		return key;
+	}
+
+	// 类型绑定trait，由DIANA_JSON_BIND宏特化，fields为JsonField组成的std::tuple
+	template<class T>
+	struct JsonBinding;
+
+	namespace detail {
+		template<class T, class = void>
+		struct isBound : std::false_type {};
+		template<class T>
+		struct isBound<T, std::void_t<decltype(JsonBinding<T>::fields)>> : std::true_type {};
+
+		template<class T>
+		struct isOptional : std::false_type {};
+		template<class T>
+		struct isOptional<std::optional<T>> : std::true_type {};
+
+		template<class T>
+		struct isVector : std::false_type {};
+		template<class T, class A>
+		struct isVector<std::vector<T, A>> : std::true_type {};
+
+		template<class T>
+		using bindingFields = std::remove_cv_t<decltype(JsonBinding<T>::fields)>;
+
+		template<class T>
+		void read(Parser &p, T &value);
+
+		template<class T, size_t I>
+		void readMember(Parser &p, T &obj) {
+			read(p, obj.*(std::get<I>(JsonBinding<T>::fields).member));
+		}
+
+		// 编译期按键长分桶的成员表，相当于对键长做switch：
+		// order为按键长排序后的成员下标，键长为L的成员位于order[start[L]]到order[start[L + 1]]之间
+		template<class T, class = std::make_index_sequence<std::tuple_size_v<bindingFields<T>>>>
+		struct FieldTable;
+
+		template<class T, size_t... I>
+		struct FieldTable<T, std::index_sequence<I...>> {
+			static constexpr size_t count = sizeof...(I);
+			static constexpr size_t lengths[count + 1] = {std::tuple_element_t<I, bindingFields<T>>::length..., 0};
+			static constexpr const char *names[count + 1] = {std::get<I>(JsonBinding<T>::fields).name..., nullptr};
+			static constexpr void (*readers[count + 1])(Parser &, T &) = {&readMember<T, I>..., nullptr};
+
+			static constexpr size_t maxLength() {
+				size_t n = 0;
+				for (size_t i = 0; i != count; ++i) n = std::max(n, lengths[i]);
+				return n;
+			}
+
+			struct Buckets {
+				size_t order[count + 1] = {};
+				size_t start[maxLength() + 2] = {};
+			};
+
+			static constexpr Buckets buckets() {
+				Buckets b;
+				for (size_t i = 0; i != count; ++i) ++b.start[lengths[i] + 1];
+				for (size_t len = 0; len <= maxLength(); ++len) b.start[len + 1] += b.start[len];
+				size_t next[maxLength() + 1] = {};
+				for (size_t i = 0; i != count; ++i) b.order[b.start[lengths[i]] + next[lengths[i]]++] = i;
+				return b;
+			}
+
+			static constexpr Buckets table = buckets();
+		};
+
+		// 键匹配：按键长跳到对应的桶，只与键长相同的成员比较内容
+		template<class T>
+		bool readField(Parser &p, T &obj, const std::string &key) {
+			using Table = FieldTable<T>;
+			if (key.size() > Table::maxLength()) return false;
+			for (size_t i = Table::table.start[key.size()]; i != Table::table.start[key.size() + 1]; ++i) {
+				size_t field = Table::table.order[i];
+				if (memcmp(key.data(), Table::names[field], key.size()) == 0) {
+					Table::readers[field](p, obj);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// 直接从文本填充目标类型，不构建Json节点
+		template<class T>
+		void read(Parser &p, T &value) {
+			if constexpr (std::is_same_v<T, bool>) {
+				value = p.readBool();
+			} else if constexpr (std::is_integral_v<T>) {
+				if constexpr (std::is_unsigned_v<T>) {
+					unsigned long long n = p.readUnsigned();
+					if (n > std::numeric_limits<T>::max()) {
+						p.fail("NUMBER OUT OF RANGE");
+					}
+					value = static_cast<T>(n);
+				} else {
+					long long n = p.readInteger();
+					if (n < std::numeric_limits<T>::min() || n > std::numeric_limits<T>::max()) {
+						p.fail("NUMBER OUT OF RANGE");
+					}
+					value = static_cast<T>(n);
+				}
+			} else if constexpr (std::is_floating_point_v<T>) {
+				value = static_cast<T>(p.readNumber());
+			} else if constexpr (std::is_same_v<T, std::string>) {
+				value = p.readString();
+			} else if constexpr (std::is_same_v<T, Json>) {
+				value = p.readValue();
+			} else if constexpr (isOptional<T>::value) {
+				if (p.peek() == 'n') {
+					p.readNull();
+					value.reset();
+				} else {
+					read(p, value.emplace());
+				}
+			} else if constexpr (isVector<T>::value) {
+				value.clear();
+				p.expect('[', "EXPECT ARRAY");
+				if (p.consume(']')) return;
+				do {
+					typename T::value_type item{};
+					read(p, item);
+					value.push_back(std::move(item));
+				} while (p.consume(','));
+				p.expect(']', "MISS COMMA OR SQUARE BRACKET");
+			} else if constexpr (isBound<T>::value) {
+				p.expect('{', "EXPECT OBJECT");
+				if (p.consume('}')) return;
+				do {
+					std::string key = p.readString();
+					p.expect(':', "MISS COLON");
+					if (!readField(p, value, key)) {
+						p.skip();// 未绑定的成员
+					}
+				} while (p.consume(','));
+				p.expect('}', "MISS COMMA OR CURLY BRACKET");
+			} else {
+				static_assert(isBound<T>::value, "type is not bound to JSON, use DIANA_JSON_BIND");
+			}
+		}
+
+		template<class T, size_t I>
+		using fieldType = std::tuple_element_t<I, bindingFields<T>>;
+
+		template<class T, size_t I>
+		inline constexpr auto quotedKey = quoteKey<fieldType<T, I>::length>(std::get<I>(JsonBinding<T>::fields).name);
+
+		template<class T>
+		constexpr size_t staticSize();
+
+		template<class T, size_t... I>
+		constexpr size_t staticFieldsSize(std::index_sequence<I...>) {
+			return 4 + ((quotedKey<T, I>.size + 2 + staticSize<typename fieldType<T, I>::type>()) + ... + 0);
+		}
+
+		// 由静态成员数与键长估算的输出长度，用于预分配
+		template<class T>
+		constexpr size_t staticSize() {
+			if constexpr (std::is_same_v<T, bool>) {
+				return 5;
+			} else if constexpr (std::is_arithmetic_v<T>) {
+				return 8;
+			} else if constexpr (isBound<T>::value) {
+				return staticFieldsSize<T>(std::make_index_sequence<std::tuple_size_v<bindingFields<T>>>());
+			} else {
+				return 16;
+			}
+		}
+
+		template<class T>
+		void write(std::string &out, const T &value);
+
+		template<class T, size_t I>
+		void writeField(std::string &out, const T &obj) {
+			if constexpr (I > 0) {
+				out += ", ";
+			}
+			out.append(quotedKey<T, I>.data, quotedKey<T, I>.size);
+			write(out, obj.*(std::get<I>(JsonBinding<T>::fields).member));
+		}
+
+		template<class T, size_t... I>
+		void writeFields(std::string &out, const T &obj, std::index_sequence<I...>) {
+			(writeField<T, I>(out, obj), ...);
+		}
+
+		// 直接从类型生成文本，格式与Json::serialize()相同，不构建Json节点
+		template<class T>
+		void write(std::string &out, const T &value) {
+			if constexpr (std::is_same_v<T, bool>) {
+				out += value ? "true" : "false";
+			} else if constexpr (std::is_integral_v<T>) {
+				char buf[24];
+				out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+			} else if constexpr (std::is_floating_point_v<T>) {
+				writeNumber(out, static_cast<double>(value));
+			} else if constexpr (std::is_same_v<T, std::string>) {
+				writeString(out, value.data(), value.size());
+			} else if constexpr (std::is_same_v<T, Json>) {
+				value.serialize(out);
+			} else if constexpr (isOptional<T>::value) {
+				if (value) {
+					write(out, *value);
+				} else {
+					out += "null";
+				}
+			} else if constexpr (isVector<T>::value) {
+				out += "[ ";
+				for (size_t i = 0; i != value.size(); ++i) {
+					if (i > 0) {
+						out += ", ";
+					}
+					write(out, static_cast<const typename T::value_type &>(value[i]));
+				}
+				out += " ]";
+			} else if constexpr (isBound<T>::value) {
+				out += "{ ";
+				writeFields(out, value, std::make_index_sequence<std::tuple_size_v<bindingFields<T>>>());
+				out += " }";
+			} else {
+				static_assert(isBound<T>::value, "type is not bound to JSON, use DIANA_JSON_BIND");
+			}
+		}
+	}// namespace detail
+
+	// 类型化解析：直接将JSON文本解析到T中，缺失的成员保持原值，未绑定的成员被跳过
+	template<class T>
+	bool typedParse(const std::string &context, T &value, std::string &errorText) noexcept {
+		try {
+			Parser p(context);
+			detail::read(p, value);
+			p.finish();
+			return true;
+		} catch (JsonException &e) {
+			errorText = e.what();
+			return false;
+		}
+	}
+
+	// 类型化生成：按静态成员数预分配后追加到out末尾
+	template<class T>
+	void typedSerialize(const T &value, std::string &out) {
+		if constexpr (detail::isVector<T>::value) {
+			out.reserve(out.size() + 4 + value.size() * (detail::staticSize<typename T::value_type>() + 2));
+		} else {
+			out.reserve(out.size() + detail::staticSize<T>());
+		}
+		detail::write(out, value);
+	}
+
+	template<class T>
+	std::string typedSerialize(const T &value) {
+		std::string out;
+		typedSerialize(value, out);
+		return out;
+	}
+}// namespace DianaJSON
+
+// 在全局命名空间中描述结构体成员，例如：
+// DIANA_JSON_BIND(Point, DIANA_JSON_FIELD(x), DIANA_JSON_FIELD_NAMED(y, "Y"))
+#define DIANA_JSON_FIELD(member) ::DianaJSON::makeJsonField(#member, &type::member)
+#define DIANA_JSON_FIELD_NAMED(member, name) ::DianaJSON::makeJsonField(name, &type::member)
+#define DIANA_JSON_BIND(Type, ...)                                         \
+	template<>                                                             \
+	struct DianaJSON::JsonBinding<Type> {                                  \
+		using type = Type;                                                 \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__);       \
+	};
+
+#endif
@@ -0,0 +1,462 @@
+#ifndef JSONLITERAL_H
+#define JSONLITERAL_H
+
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "json.h"
+#include "jsonerror.h"
+
+namespace DianaJSON {
+	namespace literal {
+		// 扁平化的节点，子节点紧随父节点之后按前序排列
+		struct Node {
+			JsonValueType type = JsonValueType::Null;
+			bool boolean = false;
+			bool exact = true;// Number：编译期换算结果是否精确，否则运行时由raw重新换算
+			double number = 0;
+			std::string_view raw;        // Number：原始文本
+			size_t offset = 0, length = 0;// String：解码后内容在字符区中的位置
+			size_t keyOffset = 0, keyLength = 0;// 对象成员：解码后的键
+			size_t size = 0;             // Array/Object：子节点数
+			size_t next = 0;             // 下一个兄弟节点的下标
+		};
+
+		struct Counts {
+			size_t nodes = 0;
+			size_t chars = 0;
+		};
+
+		// 10^0 ~ 10^22 均可被double精确表示
+		constexpr double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+		// constexpr递归下降解析器，nodes/chars为空时只做校验与计数
+		// 非法文本在编译期求值时抛出异常，从而成为编译错误
+		class Reader {
+		public:
+			constexpr Reader(std::string_view text, Node *nodes, char *chars) : _text(text), _nodes(nodes), _chars(chars) {}
+
+			constexpr Counts parse() {
+				skipWhitespace();
+				parseValue(0, 0);
+				skipWhitespace();
+				if (_pos != _text.size()) fail("ROOT NOT SINGULAR");
+				return {_nodeCount, _charCount};
+			}
+
+		private:
+			constexpr char peek() const { return _pos < _text.size() ? _text[_pos] : '\0'; }
+			constexpr char next() { return _pos < _text.size() ? _text[_pos++] : '\0'; }
+
+			constexpr void skipWhitespace() {
+				while (peek() == ' ' || peek() == '\t' || peek() == '\r' || peek() == '\n') ++_pos;
+			}
+
+			constexpr void putChar(char ch) {
+				if (_chars) _chars[_charCount] = ch;
+				++_charCount;
+			}
+
+			constexpr void parseValue(size_t keyOffset, size_t keyLength) {
+				size_t index = _nodeCount++;
+				Node node;
+				node.keyOffset = keyOffset;
+				node.keyLength = keyLength;
+				switch (peek()) {
+					case 'n':
+						parseLiteral("null");
+						break;
+					case 't':
+						parseLiteral("true");
+						node.type = JsonValueType::Bool;
+						node.boolean = true;
+						break;
+					case 'f':
+						parseLiteral("false");
+						node.type = JsonValueType::Bool;
+						break;
+					case '"':
+						node.type = JsonValueType::String;
+						node.offset = _charCount;
+						parseString();
+						node.length = _charCount - node.offset;
+						break;
+					case '[':
+						node.type = JsonValueType::Array;
+						node.size = parseArray();
+						break;
+					case '{':
+						node.type = JsonValueType::Object;
+						node.size = parseObject();
+						break;
+					case '\0':
+						fail("EXPECT VALUE");
+					default:
+						node.type = JsonValueType::Number;
+						parseNumber(node);
+						break;
+				}
+				node.next = _nodeCount;
+				if (_nodes) _nodes[index] = node;
+			}
+
+			constexpr void parseLiteral(std::string_view literal) {
+				if (_text.substr(_pos, literal.size()) != literal) fail("INVALID VALUE");
+				_pos += literal.size();
+			}
+
+			constexpr void parseNumber(Node &node) {
+				size_t begin = _pos;
+				bool negative = peek() == '-';
+				if (negative) ++_pos;
+				unsigned long long mantissa = 0;
+				int digits = 0, exponent = 0;
+				auto digit = [&](int scale) {
+					if (mantissa == 0 && peek() == '0') {
+						exponent -= scale;// 有效数字前的零
+					} else if (digits < 19) {
+						mantissa = mantissa * 10 + (peek() - '0');
+						++digits;
+						exponent -= scale;
+					} else {
+						node.exact = false;
+						exponent += 1 - scale;
+					}
+					++_pos;
+				};
+				if (peek() == '0') {
+					++_pos;
+				} else {
+					if (peek() < '1' || peek() > '9') fail("INVALID VALUE");
+					while (peek() >= '0' && peek() <= '9') digit(0);
+				}
+				if (peek() == '.') {
+					++_pos;
+					if (peek() < '0' || peek() > '9') fail("INVALID VALUE");
+					while (peek() >= '0' && peek() <= '9') digit(1);
+				}
+				if (peek() == 'e' || peek() == 'E') {
+					++_pos;
+					bool negativeExp = false;
+					if (peek() == '-' || peek() == '+') negativeExp = next() == '-';
+					if (peek() < '0' || peek() > '9') fail("INVALID VALUE");
+					int e = 0;
+					while (peek() >= '0' && peek() <= '9') {
+						if (e < 100000) e = e * 10 + (next() - '0');
+						else
+							++_pos;
+					}
+					exponent += negativeExp ? -e : e;
+				}
+				node.raw = _text.substr(begin, _pos - begin);
+				// 快速路径：尾数可精确表示且10的幂不超过22时，一次乘除即得正确舍入的结果
+				double value = static_cast<double>(mantissa);
+				if (mantissa > (1ULL << 53) || exponent > 22 || exponent < -22) node.exact = false;
+				if (mantissa == 0) {
+					value = 0;
+					node.exact = true;
+				} else if (node.exact) {
+					value = exponent >= 0 ? value * pow10[exponent] : value / pow10[-exponent];
+				} else {
+					// 近似值，仅用于编译期比较，toDouble()会由raw重新换算
+					exponent = exponent > 400 ? 400 : (exponent < -400 ? -400 : exponent);
+					for (; exponent > 0; --exponent) value *= 10;
+					for (; exponent < 0; ++exponent) value /= 10;
+				}
+				node.number = negative ? -value : value;
+			}
+
+			constexpr unsigned parseHex4() {
+				unsigned u = 0;
+				for (int i = 0; i != 4; ++i) {
+					char ch = next();
+					u <<= 4;
+					if (ch >= '0' && ch <= '9')
+						u |= ch - '0';
+					else if (ch >= 'A' && ch <= 'F')
+						u |= ch - 'A' + 10;
+					else if (ch >= 'a' && ch <= 'f')
+						u |= ch - 'a' + 10;
+					else
+						fail("INVALID UNICODE HEX");
+				}
+				return u;
+			}
+
+			constexpr void encodeUTF8(unsigned u) {
+				if (u <= 0x7F) {
+					putChar(static_cast<char>(u));
+				} else if (u <= 0x7FF) {
+					putChar(static_cast<char>(0xC0 | (u >> 6)));
+					putChar(static_cast<char>(0x80 | (u & 0x3F)));
+				} else if (u <= 0xFFFF) {
+					putChar(static_cast<char>(0xE0 | (u >> 12)));
+					putChar(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+					putChar(static_cast<char>(0x80 | (u & 0x3F)));
+				} else {
+					putChar(static_cast<char>(0xF0 | (u >> 18)));
+					putChar(static_cast<char>(0x80 | ((u >> 12) & 0x3F)));
+					putChar(static_cast<char>(0x80 | ((u >> 6) & 0x3F)));
+					putChar(static_cast<char>(0x80 | (u & 0x3F)));
+				}
+			}
+
+			// 解码字符串到字符区
+			constexpr void parseString() {
+				++_pos;// 跳过'"'
+				while (true) {
+					char ch = next();
+					switch (ch) {
+						case '"':
+							return;
+						case '\0':
+							fail("MISS QUOTATION MARK");
+						case '\\':
+							switch (next()) {
+								case '"':
+									putChar('"');
+									break;
+								case '\\':
+									putChar('\\');
+									break;
+								case '/':
+									putChar('/');
+									break;
+								case 'b':
+									putChar('\b');
+									break;
+								case 'f':
+									putChar('\f');
+									break;
+								case 'n':
+									putChar('\n');
+									break;
+								case 'r':
+									putChar('\r');
+									break;
+								case 't':
+									putChar('\t');
+									break;
+								case 'u': {
+									unsigned u = parseHex4();
+									if (u >= 0xD800 && u <= 0xDBFF) {
+										if (next() != '\\' || next() != 'u') fail("INVALID UNICODE SURROGATE");
+										unsigned u2 = parseHex4();
+										if (u2 < 0xDC00 || u2 > 0xDFFF) fail("INVALID UNICODE SURROGATE");
+										u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+									}
+									encodeUTF8(u);
+									break;
+								}
+								default:
+									fail("INVALID STRING ESCAPE");
+							}
+							break;
+						default:
+							if (static_cast<unsigned char>(ch) < 0x20) fail("INVALID STRING CHAR");
+							putChar(ch);
+							break;
+					}
+				}
+			}
+
+			constexpr size_t parseArray() {
+				size_t size = 0;
+				++_pos;// 跳过'['
+				skipWhitespace();
+				if (peek() == ']') {
+					++_pos;
+					return size;
+				}
+				while (true) {
+					skipWhitespace();
+					parseValue(0, 0);
+					++size;
+					skipWhitespace();
+					char ch = next();
+					if (ch == ']') return size;
+					if (ch != ',') fail("MISS COMMA OR SQUARE BRACKET");
+				}
+			}
+
+			constexpr size_t parseObject() {
+				size_t size = 0;
+				++_pos;// 跳过'{'
+				skipWhitespace();
+				if (peek() == '}') {
+					++_pos;
+					return size;
+				}
+				while (true) {
+					skipWhitespace();
+					if (peek() != '"') fail("MISS KEY");
+					size_t keyOffset = _charCount;
+					parseString();
+					size_t keyLength = _charCount - keyOffset;
+					skipWhitespace();
+					if (next() != ':') fail("MISS COLON");
+					skipWhitespace();
+					parseValue(keyOffset, keyLength);
+					++size;
+					skipWhitespace();
+					char ch = next();
+					if (ch == '}') return size;
+					if (ch != ',') fail("MISS COMMA OR CURLY BRACKET");
+				}
+			}
+
+			[[noreturn]] void fail(const char *msg) const {
+				throw JsonException(std::string(msg) + ": " + std::string(_text.substr(_pos)));
+			}
+
+		private:
+			std::string_view _text;
+			size_t _pos = 0;
+			Node *_nodes;
+			char *_chars;
+			size_t _nodeCount = 0;
+			size_t _charCount = 0;
+		};
+
+		// 校验并统计所需的节点数与字符数
+		constexpr Counts measure(std::string_view text) {
+			return Reader(text, nullptr, nullptr).parse();
+		}
+	}// namespace literal
+
+	// 只读的字面量节点视图，所有访问均可在编译期求值
+	class JsonLiteralRef {
+	public:
+		constexpr JsonLiteralRef(const literal::Node *nodes, const char *chars, size_t index) : _nodes(nodes), _chars(chars), _index(index) {}
+
+	public:
+		constexpr JsonValueType getType() const noexcept { return node().type; }
+		constexpr bool isNull() const noexcept { return getType() == JsonValueType::Null; }
+		constexpr bool isBoolean() const noexcept { return getType() == JsonValueType::Bool; }
+		constexpr bool isNumber() const noexcept { return getType() == JsonValueType::Number; }
+		constexpr bool isString() const noexcept { return getType() == JsonValueType::String; }
+		constexpr bool isArray() const noexcept { return getType() == JsonValueType::Array; }
+		constexpr bool isObject() const noexcept { return getType() == JsonValueType::Object; }
+
+	public:
+		constexpr bool toBool() const {
+			if (!isBoolean()) throw JsonException("not a bool");
+			return node().boolean;
+		}
+		// 超出快速路径精度的数字在运行时由strtod换算
+		constexpr double toDouble() const {
+			if (!isNumber()) throw JsonException("not a double");
+			if (node().exact) return node().number;
+			return strtod(std::string(node().raw).c_str(), nullptr);
+		}
+		constexpr std::string_view toString() const {
+			if (!isString()) throw JsonException("not a string");
+			return std::string_view(_chars + node().offset, node().length);
+		}
+
+	public:
+		constexpr size_t size() const {
+			if (!isArray() && !isObject()) throw JsonException("not a array or object");
+			return node().size;
+		}
+		// 数组元素或对象的第index个成员值
+		constexpr JsonLiteralRef operator[](size_t index) const {
+			if (index >= size()) throw JsonException("index out of range");
+			size_t child = _index + 1;
+			for (; index; --index) child = _nodes[child].next;
+			return JsonLiteralRef(_nodes, _chars, child);
+		}
+		constexpr JsonLiteralRef operator[](std::string_view key) const {
+			if (!isObject()) throw JsonException("not a object");
+			for (size_t i = 0, child = _index + 1; i != node().size; ++i, child = _nodes[child].next) {
+				if (std::string_view(_chars + _nodes[child].keyOffset, _nodes[child].keyLength) == key) {
+					return JsonLiteralRef(_nodes, _chars, child);
+				}
+			}
+			throw JsonException("key not found");
+		}
+		constexpr bool contains(std::string_view key) const {
+			if (!isObject()) return false;
+			for (size_t i = 0, child = _index + 1; i != node().size; ++i, child = _nodes[child].next) {
+				if (std::string_view(_chars + _nodes[child].keyOffset, _nodes[child].keyLength) == key) return true;
+			}
+			return false;
+		}
+		// 对象成员的键
+		constexpr std::string_view key() const noexcept {
+			return std::string_view(_chars + node().keyOffset, node().keyLength);
+		}
+
+	public:
+		// 转换为Json
+		Json toJson() const {
+			switch (getType()) {
+				case JsonValueType::Null:
+					return Json(nullptr);
+				case JsonValueType::Bool:
+					return Json(toBool());
+				case JsonValueType::Number:
+					return Json(toDouble());
+				case JsonValueType::String:
+					return Json(std::string(toString()));
+				case JsonValueType::Array: {
+					Json::_array arr;
+					arr.reserve(size());
+					for (size_t i = 0; i != size(); ++i) arr.push_back((*this)[i].toJson());
+					return Json(std::move(arr));
+				}
+				default: {
+					Json::_object obj;
+					for (size_t i = 0, child = _index + 1; i != size(); ++i, child = _nodes[child].next) {
+						JsonLiteralRef member(_nodes, _chars, child);
+						obj.emplace(std::string(member.key()), member.toJson());
+					}
+					return Json(std::move(obj));
+				}
+			}
+		}
+
+	private:
+		constexpr const literal::Node &node() const noexcept { return _nodes[_index]; }
+
+	private:
+		const literal::Node *_nodes;
+		const char *_chars;
+		size_t _index;
+	};
+
+	// 编译期解析得到的静态只读JSON，节点与解码后的字符串均内嵌在对象中
+	template<size_t Nodes, size_t Chars>
+	class JsonLiteral {
+	public:
+		constexpr explicit JsonLiteral(std::string_view text) : _nodes{}, _chars{} {
+			literal::Reader(text, _nodes.data(), _chars.data()).parse();
+		}
+
+	public:
+		constexpr JsonLiteralRef root() const noexcept { return JsonLiteralRef(_nodes.data(), _chars.data(), 0); }
+		constexpr JsonValueType getType() const noexcept { return root().getType(); }
+		constexpr size_t size() const { return root().size(); }
+		constexpr JsonLiteralRef operator[](size_t index) const { return root()[index]; }
+		constexpr JsonLiteralRef operator[](std::string_view key) const { return root()[key]; }
+		Json toJson() const { return root().toJson(); }
+
+	private:
+		std::array<literal::Node, Nodes> _nodes;
+		std::array<char, Chars + 1> _chars;// 至少一个字节，避免零长数组
+	};
+}// namespace DianaJSON
+
+// 编译期解析JSON字面量，非法JSON成为编译错误
+// static constexpr auto config = DIANA_JSON_LITERAL(R"({"port": 8080})");
+#define DIANA_JSON_LITERAL(text)                                                       \
+	([]() constexpr {                                                                  \
+		constexpr std::string_view text_{text};                                        \
+		constexpr ::DianaJSON::literal::Counts counts_ = ::DianaJSON::literal::measure(text_); \
+		return ::DianaJSON::JsonLiteral<counts_.nodes, counts_.chars>(text_);          \
+	}())
+
+#endif
@@ -0,0 +1,87 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "jsonvalue.h"
+
+namespace DianaJSON {
+	namespace {
+		// 字符位于std::string对象内部（短字符串优化）时不占用堆内存
+		size_t stringHeapBytes(const std::string &s) {
+			const char *data = s.data(), *self = reinterpret_cast<const char *>(&s);
+			return data >= self && data < self + sizeof(s) ? 0 : s.capacity() + 1;
+		}
+
+		// unordered_map的节点：next指针、键值对与缓存的哈希值
+		constexpr size_t objectNodeBytes = sizeof(void *) + sizeof(Json::_object::value_type) + sizeof(size_t);
+
+		thread_local JsonAllocationCounter *currentCounter = nullptr;
+	}// namespace
+
+	JsonMemoryUsage Json::memoryUsage() const {
+		JsonMemoryUsage usage;
+		std::vector<const Json *> stack{this};
+		while (!stack.empty()) {
+			const Json *json = stack.back();
+			stack.pop_back();
+			usage.bytes += sizeof(JsonValue);
+			++usage.nodes[static_cast<size_t>(json->getType())];
+			switch (json->getType()) {
+				case JsonValueType::String:
+					usage.bytes += stringHeapBytes(json->toString());
+					break;
+				case JsonValueType::Array: {
+					auto &arr = json->toArray();
+					usage.bytes += arr.capacity() * sizeof(Json);
+					for (auto &e : arr) stack.push_back(&e);
+					break;
+				}
+				case JsonValueType::Object: {
+					auto &obj = json->toObject();
+					if (obj.bucket_count() > 1) usage.bytes += obj.bucket_count() * sizeof(void *);// 单个桶存放在容器内部
+					usage.bytes += obj.size() * objectNodeBytes;
+					for (auto &p : obj) {
+						usage.bytes += stringHeapBytes(p.first);
+						stack.push_back(&p.second);
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+		return usage;
+	}
+
+	// 计数器按构造顺序串成链，一次分配计入链上的每个计数器
+	JsonAllocationCounter::JsonAllocationCounter() noexcept : _outer(currentCounter) {
+		currentCounter = this;
+	}
+
+	JsonAllocationCounter::~JsonAllocationCounter() {
+		currentCounter = _outer;
+	}
+
+	bool JsonAllocationCounter::enabled() noexcept {
+#ifdef DIANA_JSON_COUNT_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void JsonAllocationHook::record(int64_t bytes) noexcept {
+		for (JsonAllocationCounter *counter = currentCounter; counter != nullptr; counter = counter->_outer) {
+			JsonAllocationStats &stats = counter->_stats;
+			if (bytes >= 0) {
+				++stats.allocations;
+			} else {
+				++stats.frees;
+			}
+			stats.bytes += bytes;
+			if (stats.bytes > stats.peak) stats.peak = stats.bytes;
+		}
+	}
+}// namespace DianaJSON
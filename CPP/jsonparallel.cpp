@@ -0,0 +1,133 @@
+#include "jsonparallel.h"
+
+#include <deque>
+#include <exception>
+
+namespace DianaJSON {
+	struct JsonThreadPool::Batch {
+		Task task;
+		void *context;
+		std::atomic<size_t> remaining;
+		std::mutex errorMutex;
+		std::exception_ptr error;
+	};
+
+	struct JsonThreadPool::Worker {
+		std::thread thread;
+		std::mutex mutex;
+		std::deque<Chunk> queue;
+	};
+
+	JsonThreadPool::JsonThreadPool(size_t threads) {
+		// 调用线程也参与执行，只需额外创建threads - 1个工作线程
+		size_t workers = threads > 1 ? threads - 1 : 0;
+		for (size_t i = 0; i != workers; ++i) {
+			_workers.push_back(std::make_unique<Worker>());
+		}
+		for (size_t i = 0; i != workers; ++i) {
+			_workers[i]->thread = std::thread(&JsonThreadPool::workerLoop, this, i);
+		}
+	}
+
+	JsonThreadPool::~JsonThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for (auto &worker : _workers) {
+			worker->thread.join();
+		}
+	}
+
+	JsonThreadPool &JsonThreadPool::shared() {
+		static JsonThreadPool pool;
+		return pool;
+	}
+
+	size_t JsonThreadPool::chunkSize(size_t n) const noexcept {
+		return std::max(minChunk, n / (concurrency() * 8) + 1);
+	}
+
+	void JsonThreadPool::parallelFor(size_t n, size_t chunk, Task task, void *context) {
+		if (n == 0) return;
+		chunk = std::max<size_t>(chunk, 1);
+		size_t count = (n + chunk - 1) / chunk;
+		if (_workers.empty() || count == 1) {
+			task(context, 0, n);
+			return;
+		}
+		Batch batch{task, context, {count}, {}, nullptr};
+		// 按轮转分配到各工作线程的队列
+		for (size_t i = 0; i != _workers.size(); ++i) {
+			std::lock_guard<std::mutex> lock(_workers[i]->mutex);
+			for (size_t c = i; c < count; c += _workers.size()) {
+				_workers[i]->queue.push_back({&batch, c * chunk, std::min(n, (c + 1) * chunk)});
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_queued += count;
+		}
+		_wake.notify_all();
+		// 等待期间参与执行（可能执行其他批次的任务）
+		while (batch.remaining.load(std::memory_order_acquire) != 0) {
+			if (!runOne(_workers.size())) {
+				std::this_thread::yield();
+			}
+		}
+		if (batch.error) {
+			std::rethrow_exception(batch.error);
+		}
+	}
+
+	void JsonThreadPool::workerLoop(size_t self) {
+		for (;;) {
+			if (runOne(self)) continue;
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			_wake.wait(lock, [this] { return _stop || _queued.load() != 0; });
+			if (_stop) return;
+		}
+	}
+
+	bool JsonThreadPool::runOne(size_t self) {
+		Chunk chunk;
+		bool found = false;
+		if (self < _workers.size()) {
+			Worker &own = *_workers[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.queue.empty()) {
+				chunk = own.queue.back();
+				own.queue.pop_back();
+				found = true;
+			}
+		}
+		for (size_t i = 1; !found && i <= _workers.size(); ++i) {
+			Worker &victim = *_workers[(self + i) % _workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.queue.empty()) {
+				chunk = victim.queue.front();
+				victim.queue.pop_front();
+				found = true;
+			}
+		}
+		if (!found) return false;
+		--_queued;
+		execute(chunk);
+		return true;
+	}
+
+	void JsonThreadPool::execute(const Chunk &chunk) noexcept {
+		Batch &batch = *chunk.batch;
+		try {
+			batch.task(batch.context, chunk.begin, chunk.end);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(batch.errorMutex);
+			if (!batch.error) {
+				batch.error = std::current_exception();
+			}
+		}
+		// 计数归零后批次随时可能被调用线程销毁，此后不得再访问
+		batch.remaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}// namespace DianaJSON
@@ -0,0 +1,241 @@
+#ifndef JSONPARALLEL_H
+#define JSONPARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+#include "jsonerror.h"
+
+namespace DianaJSON {
+	// 工作窃取线程池：每个工作线程持有自己的任务队列，从队尾取任务，空闲时从其他队列队首窃取
+	// 提交任务的线程在等待期间同样参与执行，因此可以在任务内部嵌套调用
+	class JsonThreadPool final {
+	public:
+		using Task = void (*)(void *context, size_t begin, size_t end);
+
+	public:
+		explicit JsonThreadPool(size_t threads = std::thread::hardware_concurrency());
+		~JsonThreadPool();
+
+		JsonThreadPool(const JsonThreadPool &) = delete;
+		JsonThreadPool &operator=(const JsonThreadPool &) = delete;
+
+	public:
+		// 进程内共享的线程池
+		static JsonThreadPool &shared();
+		// 可同时执行任务的线程数（含调用线程）
+		size_t concurrency() const noexcept { return _workers.size() + 1; }
+		// 按元素数选择分块大小：每个线程约8块以均衡负载，每块不少于minChunk个元素
+		size_t chunkSize(size_t n) const noexcept;
+
+		// 将[0, n)按chunk切分后并行执行task，全部完成后返回；任务抛出的首个异常在此重新抛出
+		void parallelFor(size_t n, size_t chunk, Task task, void *context);
+		template<class F>
+		void parallelFor(size_t n, size_t chunk, F &&fn) {
+			using Fn = std::remove_reference_t<F>;
+			parallelFor(
+					n, chunk, [](void *context, size_t begin, size_t end) { (*static_cast<Fn *>(context))(begin, end); },
+					const_cast<void *>(static_cast<const void *>(std::addressof(fn))));
+		}
+
+	public:
+		static constexpr size_t minChunk = 256;
+
+	private:
+		struct Batch;
+		struct Chunk {
+			Batch *batch;
+			size_t begin, end;
+		};
+		struct Worker;
+
+		void workerLoop(size_t self);
+		bool runOne(size_t self);// self为工作线程下标，调用线程为_workers.size()
+		static void execute(const Chunk &chunk) noexcept;
+
+	private:
+		std::vector<std::unique_ptr<Worker>> _workers;
+		std::mutex _sleepMutex;
+		std::condition_variable _wake;
+		std::atomic<size_t> _queued{0};
+		bool _stop = false;
+	};
+
+	// 并行算法：作用于数组元素或对象成员，回调只获得const引用，执行期间json不得被修改
+	// 对象成员的回调既可接受(const std::string &key, const Json &value)，也可只接受(const Json &value)
+	namespace detail {
+		template<class F>
+		decltype(auto) invokeMember(F &fn, const std::string &key, const Json &value) {
+			if constexpr (std::is_invocable_v<F &, const std::string &, const Json &>) {
+				return fn(key, value);
+			} else {
+				return fn(value);
+			}
+		}
+
+		using MemberList = std::vector<const Json::_object::value_type *>;
+
+		// unordered_map不支持随机访问，先收集成员指针
+		inline MemberList collectMembers(const Json::_object &obj) {
+			MemberList members;
+			members.reserve(obj.size());
+			for (auto &p : obj) members.push_back(&p);
+			return members;
+		}
+
+		// 回调可直接作用于数组元素
+		template<class F, class... Prefix>
+		inline constexpr bool elementCallable = std::is_invocable_v<F &, Prefix..., const Json &>;
+
+		// 只接受(key, value)的回调只能作用于对象，json是否为数组在运行时才能确定
+		[[noreturn]] inline void memberOnlyCallback() {
+			throw JsonException("callback takes (key, value) and cannot visit array elements");
+		}
+
+		// 元素较少时直接在调用线程执行
+		template<class F>
+		void runChunks(JsonThreadPool &pool, size_t n, size_t chunk, F &&fn) {
+			if (n <= chunk) {
+				if (n > 0) fn(size_t(0), n);
+			} else {
+				pool.parallelFor(n, chunk, fn);
+			}
+		}
+	}// namespace detail
+
+	// 对每个元素（或成员）调用fn
+	template<class F>
+	void parallelForEach(const Json &json, F fn, JsonThreadPool &pool = JsonThreadPool::shared()) {
+		if (json.isArray()) {
+			if constexpr (!detail::elementCallable<F>) {
+				detail::memberOnlyCallback();
+			} else {
+				auto &arr = json.toArray();
+				detail::runChunks(pool, arr.size(), pool.chunkSize(arr.size()), [&](size_t begin, size_t end) {
+					for (size_t i = begin; i != end; ++i) fn(arr[i]);
+				});
+			}
+		} else {
+			auto members = detail::collectMembers(json.toObject());
+			detail::runChunks(pool, members.size(), pool.chunkSize(members.size()), [&](size_t begin, size_t end) {
+				for (size_t i = begin; i != end; ++i) detail::invokeMember(fn, members[i]->first, members[i]->second);
+			});
+		}
+	}
+
+	// 映射：数组得到等长数组，对象得到键相同的对象；结果直接写入预分配的位置，不经合并
+	template<class F>
+	Json parallelTransform(const Json &json, F fn, JsonThreadPool &pool = JsonThreadPool::shared()) {
+		if (json.isArray()) {
+			if constexpr (!detail::elementCallable<F>) {
+				detail::memberOnlyCallback();
+			} else {
+				auto &arr = json.toArray();
+				Json::_array out(arr.size());
+				detail::runChunks(pool, arr.size(), pool.chunkSize(arr.size()), [&](size_t begin, size_t end) {
+					for (size_t i = begin; i != end; ++i) out[i] = Json(fn(arr[i]));
+				});
+				return Json(std::move(out));
+			}
+		}
+		auto members = detail::collectMembers(json.toObject());
+		std::vector<Json> values(members.size());
+		detail::runChunks(pool, members.size(), pool.chunkSize(members.size()), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i != end; ++i) values[i] = Json(detail::invokeMember(fn, members[i]->first, members[i]->second));
+		});
+		Json::_object out;
+		out.reserve(members.size());
+		for (size_t i = 0; i != members.size(); ++i) out.emplace(members[i]->first, std::move(values[i]));
+		return Json(std::move(out));
+	}
+
+	// 过滤：保留pred为真的元素（或成员），数组保持原有顺序
+	// 每块写入各自的缓冲区，最后按块顺序移动合并
+	template<class F>
+	Json parallelFilter(const Json &json, F pred, JsonThreadPool &pool = JsonThreadPool::shared()) {
+		if (json.isArray()) {
+			if constexpr (!detail::elementCallable<F>) {
+				detail::memberOnlyCallback();
+			} else {
+				auto &arr = json.toArray();
+				size_t chunk = pool.chunkSize(arr.size());
+				std::vector<Json::_array> parts((arr.size() + chunk - 1) / chunk);
+				detail::runChunks(pool, arr.size(), chunk, [&](size_t begin, size_t end) {
+					auto &local = parts[begin / chunk];
+					for (size_t i = begin; i != end; ++i) {
+						if (pred(arr[i])) local.push_back(arr[i]);
+					}
+				});
+				if (parts.size() == 1) return Json(std::move(parts[0]));
+				size_t total = 0;
+				for (auto &part : parts) total += part.size();
+				Json::_array out;
+				out.reserve(total);
+				for (auto &part : parts) out.insert(out.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+				return Json(std::move(out));
+			}
+		}
+		auto members = detail::collectMembers(json.toObject());
+		std::vector<char> keep(members.size());
+		detail::runChunks(pool, members.size(), pool.chunkSize(members.size()), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i != end; ++i) keep[i] = static_cast<bool>(detail::invokeMember(pred, members[i]->first, members[i]->second));
+		});
+		Json::_object out;
+		for (size_t i = 0; i != members.size(); ++i) {
+			if (keep[i]) out.emplace(*members[i]);
+		}
+		return Json(std::move(out));
+	}
+
+	// 归约：每块从identity开始以reduce(acc, 元素)累积，各块结果按块顺序以combine(acc, part)合并
+	// 对象成员的reduce可接受(acc, key, value)或(acc, value)
+	template<class T, class Reduce, class Combine>
+	T parallelReduce(const Json &json, T identity, Reduce reduce, Combine combine, JsonThreadPool &pool = JsonThreadPool::shared()) {
+		struct Part {
+			T value;// 包装一层，避免std::vector<bool>按位存储导致各块写入冲突
+		};
+		std::vector<Part> parts;
+		auto run = [&](size_t n, auto visit) {
+			size_t chunk = pool.chunkSize(n);
+			parts.assign((n + chunk - 1) / chunk, Part{identity});
+			detail::runChunks(pool, n, chunk, [&](size_t begin, size_t end) {
+				T acc = std::move(parts[begin / chunk].value);
+				for (size_t i = begin; i != end; ++i) acc = visit(std::move(acc), i);
+				parts[begin / chunk].value = std::move(acc);
+			});
+		};
+		if (json.isArray()) {
+			if constexpr (!detail::elementCallable<Reduce, T>) {
+				detail::memberOnlyCallback();
+			} else {
+				auto &arr = json.toArray();
+				run(arr.size(), [&](T acc, size_t i) { return reduce(std::move(acc), arr[i]); });
+			}
+		} else {
+			auto members = detail::collectMembers(json.toObject());
+			run(members.size(), [&](T acc, size_t i) {
+				if constexpr (std::is_invocable_v<Reduce &, T, const std::string &, const Json &>) {
+					return reduce(std::move(acc), members[i]->first, members[i]->second);
+				} else {
+					return reduce(std::move(acc), members[i]->second);
+				}
+			});
+		}
+		T result = std::move(identity);
+		for (auto &part : parts) result = combine(std::move(result), std::move(part.value));
+		return result;
+	}
+}// namespace DianaJSON
+
+#endif
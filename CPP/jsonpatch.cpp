@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+#include "jsonerror.h"
+
+namespace DianaJSON {
+	namespace {
+		// JSON Pointer（RFC 6901），text仅用于错误信息
+		struct Pointer {
+			std::string text;
+			std::vector<std::string> tokens;
+		};
+
+		Pointer parsePointer(const std::string &text) {
+			Pointer ptr{text, {}};
+			if (text.empty()) return ptr;
+			if (text[0] != '/') {
+				throw JsonException("INVALID POINTER: " + text);
+			}
+			for (size_t i = 0; i != text.size(); ++i) {
+				if (text[i] == '/') {
+					ptr.tokens.emplace_back();
+				} else if (text[i] == '~') {
+					if (i + 1 == text.size() || (text[i + 1] != '0' && text[i + 1] != '1')) {
+						throw JsonException("INVALID POINTER: " + text);
+					}
+					ptr.tokens.back() += text[++i] == '0' ? '~' : '/';
+				} else {
+					ptr.tokens.back() += text[i];
+				}
+			}
+			return ptr;
+		}
+
+		// 数组下标：无前导零的十进制数，allowEnd时允许"-"与size（末尾追加）
+		size_t parseIndex(const std::string &token, size_t size, bool allowEnd, const Pointer &ptr) {
+			if (allowEnd && token == "-") return size;
+			if (token.empty() || token.size() > 19 || (token.size() > 1 && token[0] == '0')) {
+				throw JsonException("INVALID INDEX: " + ptr.text);
+			}
+			size_t index = 0;
+			for (char ch : token) {
+				if (ch < '0' || ch > '9') {
+					throw JsonException("INVALID INDEX: " + ptr.text);
+				}
+				index = index * 10 + (ch - '0');
+			}
+			if (index > size || (index == size && !allowEnd)) {
+				throw JsonException("INDEX OUT OF RANGE: " + ptr.text);
+			}
+			return index;
+		}
+
+		const Json &member(const Json &op, const char *name) {
+			auto &obj = op.toObject();
+			auto it = obj.find(name);
+			if (it == obj.end()) {
+				throw JsonException(std::string("INVALID PATCH: missing \"") + name + "\"");
+			}
+			return it->second;
+		}
+
+		const std::string &memberString(const Json &op, const char *name) {
+			const Json &value = member(op, name);
+			if (!value.isString()) {
+				throw JsonException(std::string("INVALID PATCH: \"") + name + "\" is not a string");
+			}
+			return value.toString();
+		}
+
+		// 原地执行JSON Patch，每个修改都在撤销日志中记录其逆操作，
+		// 回滚时逆序执行，代价与补丁规模成正比，不需要预先拷贝文档
+		class Patcher {
+		public:
+			explicit Patcher(Json &root) noexcept : _root(root) {}
+
+			void apply(const Json &op) {
+				if (!op.isObject()) {
+					throw JsonException("INVALID PATCH: operation is not an object");
+				}
+				const std::string &name = memberString(op, "op");
+				Pointer path = parsePointer(memberString(op, "path"));
+				if (name == "add") {
+					add(path, member(op, "value"));
+				} else if (name == "remove") {
+					_log.push_back({Undo::Insert, path, take(path)});
+				} else if (name == "replace") {
+					Json &target = at(path);
+					_log.push_back({Undo::Restore, path, std::exchange(target, member(op, "value"))});
+				} else if (name == "move") {
+					move(parsePointer(memberString(op, "from")), path);
+				} else if (name == "copy") {
+					add(path, at(parsePointer(memberString(op, "from"))));
+				} else if (name == "test") {
+					if (at(path) != member(op, "value")) {
+						throw JsonException("TEST FAILED: " + path.text);
+					}
+				} else {
+					throw JsonException("INVALID PATCH: unknown op \"" + name + "\"");
+				}
+			}
+
+			// 逆操作失败说明撤销日志有缺陷，文档可能处于中间状态，错误追加到errorText中而不是静默丢弃
+			bool rollback(std::string &errorText) noexcept {
+				try {
+					while (!_log.empty()) {
+						Entry &e = _log.back();
+						switch (e.kind) {
+							case Undo::Erase:
+								take(e.path);
+								break;
+							case Undo::Insert:
+								put(e.path, std::move(e.value));
+								break;
+							case Undo::Restore:
+								at(e.path) = std::move(e.value);
+								break;
+							case Undo::MoveBack:
+								put(e.from, take(e.path));
+								break;
+							case Undo::MoveBackRestore: {
+								// 先取出移入的值并插回被覆盖的值，目标为根节点时也不会经过null
+								Json moved = take(e.path);
+								put(e.path, std::move(e.value));
+								put(e.from, std::move(moved));
+								break;
+							}
+						}
+						_log.pop_back();
+					}
+					return true;
+				} catch (JsonException &e) {
+					errorText += std::string("; ROLLBACK FAILED: ") + e.what();
+					return false;
+				}
+			}
+
+		private:
+			enum class Undo {
+				Erase,   // 删除path处新增的值
+				Insert,  // 在path处插回value
+				Restore, // 将path处的值恢复为value
+				MoveBack,       // 将path处的值移回from
+				MoveBackRestore,// 将path处的值移回from，并在path处插回被覆盖的value
+			};
+			struct Entry {
+				Entry(Undo kind, Pointer path, Json value = Json(nullptr), Pointer from = {})
+					: kind(kind), path(std::move(path)), value(std::move(value)), from(std::move(from)) {}
+
+				Undo kind;
+				Pointer path;
+				Json value;
+				Pointer from;// 仅MoveBack与MoveBackRestore使用
+			};
+
+			Json &at(const Pointer &ptr, size_t depth) {
+				Json *node = &_root;
+				for (size_t i = 0; i != depth; ++i) {
+					const std::string &token = ptr.tokens[i];
+					if (node->isObject()) {
+						auto &obj = node->asObject();
+						auto it = obj.find(token);
+						if (it == obj.end()) {
+							throw JsonException("PATH NOT FOUND: " + ptr.text);
+						}
+						node = &it->second;
+					} else if (node->isArray()) {
+						auto &arr = node->asArray();
+						node = &arr[parseIndex(token, arr.size(), false, ptr)];
+					} else {
+						throw JsonException("PATH NOT FOUND: " + ptr.text);
+					}
+				}
+				return *node;
+			}
+
+			Json &at(const Pointer &ptr) {
+				return at(ptr, ptr.tokens.size());
+			}
+
+			// 移出path处的值，根节点置为null
+			Json take(const Pointer &ptr) {
+				if (ptr.tokens.empty()) {
+					return std::exchange(_root, Json(nullptr));
+				}
+				Json &parent = at(ptr, ptr.tokens.size() - 1);
+				const std::string &token = ptr.tokens.back();
+				if (parent.isObject()) {
+					auto &obj = parent.asObject();
+					auto it = obj.find(token);
+					if (it == obj.end()) {
+						throw JsonException("PATH NOT FOUND: " + ptr.text);
+					}
+					Json value = std::move(it->second);
+					obj.erase(it);
+					return value;
+				}
+				if (parent.isArray()) {
+					auto &arr = parent.asArray();
+					auto it = arr.begin() + parseIndex(token, arr.size(), false, ptr);
+					Json value = std::move(*it);
+					arr.erase(it);
+					return value;
+				}
+				throw JsonException("PATH NOT FOUND: " + ptr.text);
+			}
+
+			// 在path处放入新值（对象键不存在、数组插入或根节点），返回实际下标确定后的路径
+			// 路径非法时抛出异常且value保持不变
+			Pointer put(const Pointer &ptr, Json &&value) {
+				if (ptr.tokens.empty()) {
+					_root = std::move(value);
+					return ptr;
+				}
+				Json &parent = at(ptr, ptr.tokens.size() - 1);
+				const std::string &token = ptr.tokens.back();
+				if (parent.isObject()) {
+					parent.asObject().emplace(token, std::move(value));
+					return ptr;
+				}
+				if (parent.isArray()) {
+					auto &arr = parent.asArray();
+					size_t index = parseIndex(token, arr.size(), true, ptr);
+					arr.insert(arr.begin() + index, std::move(value));
+					Pointer concrete = ptr;
+					concrete.tokens.back() = std::to_string(index);
+					return concrete;
+				}
+				throw JsonException("PATH NOT FOUND: " + ptr.text);
+			}
+
+			// 目标为已有的对象成员或根节点时替换，否则插入
+			bool replaces(const Pointer &ptr) {
+				if (ptr.tokens.empty()) return true;
+				Json &parent = at(ptr, ptr.tokens.size() - 1);
+				return parent.isObject() && parent.toObject().count(ptr.tokens.back()) != 0;
+			}
+
+			void add(const Pointer &ptr, Json value) {
+				if (replaces(ptr)) {
+					Json &target = at(ptr);
+					_log.push_back({Undo::Restore, ptr, std::exchange(target, std::move(value))});
+				} else {
+					_log.push_back({Undo::Erase, put(ptr, std::move(value))});
+				}
+			}
+
+			void move(const Pointer &from, const Pointer &ptr) {
+				if (from.tokens == ptr.tokens) {
+					at(from);// 仅检查存在性
+					return;
+				}
+				if (from.tokens.size() < ptr.tokens.size() &&
+					std::equal(from.tokens.begin(), from.tokens.end(), ptr.tokens.begin())) {
+					throw JsonException("INVALID PATCH: cannot move into own child " + ptr.text);
+				}
+				Json value = take(from);
+				try {
+					// 覆盖的值与移动记为同一条日志，避免回滚时先把根节点移走再向null中插回
+					if (replaces(ptr)) {
+						Json displaced = take(ptr);
+						put(ptr, std::move(value));
+						_log.push_back({Undo::MoveBackRestore, ptr, std::move(displaced), from});
+						return;
+					}
+					Pointer concrete = put(ptr, std::move(value));
+					_log.push_back({Undo::MoveBack, concrete, Json(nullptr), from});
+				} catch (JsonException &) {
+					put(from, std::move(value));// 目标路径非法，value未被移走
+					throw;
+				}
+			}
+
+		private:
+			Json &_root;
+			std::vector<Entry> _log;
+		};
+
+		std::string escapeToken(const std::string &token) {
+			std::string res;
+			res.reserve(token.size());
+			for (char ch : token) {
+				if (ch == '~') {
+					res += "~0";
+				} else if (ch == '/') {
+					res += "~1";
+				} else {
+					res += ch;
+				}
+			}
+			return res;
+		}
+
+		// splitmix64的终结函数
+		uint64_t mix(uint64_t h) noexcept {
+			h ^= h >> 30;
+			h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27;
+			h *= 0x94D049BB133111EBull;
+			return h ^ (h >> 31);
+		}
+
+		// 生成JSON Patch，对象成员按键哈希查找匹配，数组按LCS对齐
+		// 相同的子树先由哈希筛选再深度比较后整体跳过，不再递归
+		class Differ {
+		public:
+			Differ(Json::_array &ops, size_t lcsCostCap) noexcept : _ops(ops), _lcsCostCap(lcsCostCap) {}
+
+			void diff(const Json &a, const Json &b, const std::string &path) {
+				if (&a == &b) return;// 同一子树
+				if (a.getType() != b.getType()) {
+					op("replace", path, &b);
+					return;
+				}
+				bool container = a.isArray() || a.isObject();
+				if (container && maybeEqual(a, b) && a == b) return;
+				switch (a.getType()) {
+					case JsonValueType::Array:
+						diffArray(a.toArray(), b.toArray(), path);
+						break;
+					case JsonValueType::Object:
+						diffObject(a.toObject(), b.toObject(), path);
+						break;
+					default:
+						if (a != b) {
+							op("replace", path, &b);
+						}
+						break;
+				}
+			}
+
+		private:
+			// 双方都已缓存哈希时直接比较缓存，否则比较本次diff内记忆的结构哈希，两者不混用
+			bool maybeEqual(const Json &a, const Json &b) {
+				uint64_t ha = a.cachedHash(), hb = b.cachedHash();
+				if (ha != 0 && hb != 0) return ha == hb;
+				return structuralHash(a) == structuralHash(b);
+			}
+
+			// 与Json::hash()同样与operator==一致，但容器的结果记在_hashes中：
+			// 经可修改接口访问过的节点不缓存哈希，逐层调用hash()会重复遍历子树，代价为O(深度×规模)
+			uint64_t structuralHash(const Json &json) {
+				if (!json.isArray() && !json.isObject()) return json.hash();
+				auto it = _hashes.find(&json);
+				if (it != _hashes.end()) return it->second;
+				uint64_t h;
+				if (json.isArray()) {
+					h = 5;// 与顺序相关
+					for (auto &e : json.toArray()) h = mix(h + structuralHash(e));
+				} else {
+					h = 0;// 与成员顺序无关
+					for (auto &p : json.toObject()) h += mix(std::hash<std::string>{}(p.first) + mix(structuralHash(p.second)));
+					h = mix(h ^ 6);
+				}
+				_hashes.emplace(&json, h);
+				return h;
+			}
+
+			void op(const char *name, const std::string &path, const Json *value) {
+				Json::_object o{{"op", Json(name)}, {"path", Json(path)}};
+				if (value) {
+					o.emplace("value", *value);
+				}
+				_ops.emplace_back(std::move(o));
+			}
+
+			void diffObject(const Json::_object &a, const Json::_object &b, const std::string &path) {
+				for (auto &p : a) {
+					auto it = b.find(p.first);
+					if (it == b.end()) {
+						op("remove", path + '/' + escapeToken(p.first), nullptr);
+					} else {
+						diff(p.second, it->second, path + '/' + escapeToken(p.first));
+					}
+				}
+				for (auto &p : b) {
+					if (a.find(p.first) == a.end()) {
+						op("add", path + '/' + escapeToken(p.first), &p.second);
+					}
+				}
+			}
+
+			void diffArray(const Json::_array &a, const Json::_array &b, const std::string &path) {
+				// 先比较哈希，相同时才深度比较；所有元素都已缓存时用缓存，否则都用记忆的结构哈希
+				bool cached = std::all_of(a.begin(), a.end(), [](const Json &e) { return e.cachedHash() != 0 || (!e.isArray() && !e.isObject()); }) &&
+							  std::all_of(b.begin(), b.end(), [](const Json &e) { return e.cachedHash() != 0 || (!e.isArray() && !e.isObject()); });
+				std::vector<uint64_t> hashA(a.size()), hashB(b.size());
+				for (size_t i = 0; i != a.size(); ++i) hashA[i] = cached ? a[i].hash() : structuralHash(a[i]);
+				for (size_t j = 0; j != b.size(); ++j) hashB[j] = cached ? b[j].hash() : structuralHash(b[j]);
+				auto same = [&](size_t i, size_t j) { return hashA[i] == hashB[j] && a[i] == b[j]; };
+				// 去掉公共前缀与后缀
+				size_t begin = 0, endA = a.size(), endB = b.size();
+				while (begin < endA && begin < endB && same(begin, begin)) ++begin;
+				while (endA > begin && endB > begin && same(endA - 1, endB - 1)) --endA, --endB;
+				size_t n = endA - begin, m = endB - begin;
+				if (n != 0 && m != 0 && n > _lcsCostCap / m) {
+					diffByIndex(a, b, begin, endA, endB, path);
+					return;
+				}
+				// lcs[i][j]为a[begin+i..endA)与b[begin+j..endB)的LCS长度
+				std::vector<uint32_t> lcs((n + 1) * (m + 1), 0);
+				auto L = [&](size_t i, size_t j) -> uint32_t & { return lcs[i * (m + 1) + j]; };
+				for (size_t i = n; i-- > 0;) {
+					for (size_t j = m; j-- > 0;) {
+						L(i, j) = same(begin + i, begin + j) ? L(i + 1, j + 1) + 1 : std::max(L(i + 1, j), L(i, j + 1));
+					}
+				}
+				// 正向生成操作，pos为目标数组中的当前下标
+				size_t i = 0, j = 0, pos = begin;
+				while (i < n || j < m) {
+					if (i < n && j < m && same(begin + i, begin + j)) {
+						++i, ++j, ++pos;
+					} else if (i < n && j < m && L(i + 1, j + 1) == L(i, j)) {
+						// 替换不损失公共子序列，视为原位修改并递归比较
+						diff(a[begin + i], b[begin + j], path + '/' + std::to_string(pos));
+						++i, ++j, ++pos;
+					} else if (j == m || (i < n && L(i + 1, j) >= L(i, j + 1))) {
+						op("remove", path + '/' + std::to_string(pos), nullptr);
+						++i;
+					} else {
+						op("add", path + '/' + std::to_string(pos), &b[begin + j]);
+						++j, ++pos;
+					}
+				}
+			}
+
+			// 超出代价上限：公共下标逐一比较，多余元素从末尾删除或追加
+			void diffByIndex(const Json::_array &a, const Json::_array &b, size_t begin, size_t endA, size_t endB, const std::string &path) {
+				size_t common = std::min(endA, endB);
+				for (size_t i = begin; i != common; ++i) {
+					diff(a[i], b[i], path + '/' + std::to_string(i));
+				}
+				for (size_t i = endA; i-- > common;) {
+					op("remove", path + '/' + std::to_string(i), nullptr);
+				}
+				for (size_t i = common; i != endB; ++i) {
+					op("add", path + '/' + std::to_string(i), &b[i]);
+				}
+			}
+
+		private:
+			Json::_array &_ops;
+			size_t _lcsCostCap;
+			std::unordered_map<const Json *, uint64_t> _hashes;
+		};
+	}// namespace
+
+	bool Json::applyPatch(const Json &patch, std::string &errorText) noexcept {
+		Patcher patcher(*this);
+		try {
+			if (!patch.isArray()) {
+				throw JsonException("INVALID PATCH: not an array");
+			}
+			for (auto &op : patch.toArray()) {
+				patcher.apply(op);
+			}
+			return true;
+		} catch (JsonException &e) {
+			errorText = e.what();
+			patcher.rollback(errorText);
+			return false;
+		}
+	}
+
+	void Json::applyMergePatch(const Json &patch) {
+		if (!patch.isObject()) {
+			*this = patch;
+			return;
+		}
+		if (!isObject()) {
+			*this = Json(_object());
+		}
+		auto &obj = asObject();
+		for (auto &p : patch.toObject()) {
+			if (p.second.isNull()) {
+				obj.erase(p.first);
+				continue;
+			}
+			auto it = obj.find(p.first);
+			if (it == obj.end()) {
+				it = obj.emplace(p.first, Json(nullptr)).first;
+			}
+			it->second.applyMergePatch(p.second);
+		}
+	}
+
+	Json Json::diff(const Json &from, const Json &to, size_t lcsCostCap) {
+		_array ops;
+		Differ(ops, lcsCostCap).diff(from, to, "");
+		return Json(std::move(ops));
+	}
+}// namespace DianaJSON
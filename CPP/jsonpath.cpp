@@ -0,0 +1,559 @@
+#include "jsonpath.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "jsonerror.h"
+#include "jsonparallel.h"
+#include "parse.h"
+
+namespace DianaJSON {
+	namespace {
+		// 过滤器表达式节点
+		struct Expr {
+			enum class Kind {
+				Or,
+				And,
+				Not,
+				Path,   // @.a.b 或 $.a.b
+				Literal,// 字面量
+				Compare
+			};
+			enum class Op {
+				Eq,
+				Ne,
+				Lt,
+				Le,
+				Gt,
+				Ge
+			};
+
+			Kind kind = Kind::Literal;
+			Op op = Op::Eq;
+			bool fromRoot = false;         // Path：以$开头
+			std::vector<std::string> keys; // Path：逐级成员名
+			std::vector<long> indices;     // Path：与keys对应，>=0 表示数组下标
+			Json literal;                  // Literal
+			std::unique_ptr<Expr> lhs, rhs;// Or/And/Compare，Not只使用lhs
+		};
+
+		// 路径求值，keys[i]为空且indices[i] >= 0 时为数组下标
+		const Json *resolve(const Expr &path, const Json *node) {
+			for (size_t i = 0; node && i != path.keys.size(); ++i) {
+				if (path.indices[i] >= 0) {
+					if (!node->isArray() || static_cast<size_t>(path.indices[i]) >= node->size()) return nullptr;
+					node = &node->toArray()[path.indices[i]];
+				} else {
+					if (!node->isObject()) return nullptr;
+					auto &obj = node->toObject();
+					auto it = obj.find(path.keys[i]);
+					node = it == obj.end() ? nullptr : &it->second;
+				}
+			}
+			return node;
+		}
+
+		const Json *operand(const Expr &e, const Json &current, const Json &root) {
+			switch (e.kind) {
+				case Expr::Kind::Path:
+					return resolve(e, e.fromRoot ? &root : &current);
+				case Expr::Kind::Literal:
+					return &e.literal;
+				default:
+					return nullptr;
+			}
+		}
+
+		bool compare(Expr::Op op, const Json &a, const Json &b) {
+			if (op == Expr::Op::Eq) return a == b;
+			if (op == Expr::Op::Ne) return a != b;
+			int cmp;
+			if (a.isNumber() && b.isNumber()) {
+				double x = a.toDouble(), y = b.toDouble();
+				if (x != x || y != y) return false;
+				cmp = x < y ? -1 : (x > y ? 1 : 0);
+			} else if (a.isString() && b.isString()) {
+				cmp = a.toString().compare(b.toString());
+			} else {
+				return false;// 不同类型之间无序
+			}
+			switch (op) {
+				case Expr::Op::Lt:
+					return cmp < 0;
+				case Expr::Op::Le:
+					return cmp <= 0;
+				case Expr::Op::Gt:
+					return cmp > 0;
+				default:
+					return cmp >= 0;
+			}
+		}
+
+		bool evaluate(const Expr &e, const Json &current, const Json &root) {
+			switch (e.kind) {
+				case Expr::Kind::Or:
+					return evaluate(*e.lhs, current, root) || evaluate(*e.rhs, current, root);
+				case Expr::Kind::And:
+					return evaluate(*e.lhs, current, root) && evaluate(*e.rhs, current, root);
+				case Expr::Kind::Not:
+					return !evaluate(*e.lhs, current, root);
+				case Expr::Kind::Path:
+					return resolve(e, e.fromRoot ? &root : &current) != nullptr;// 存在性测试
+				case Expr::Kind::Literal:
+					return !(e.literal.isNull() || (e.literal.isBoolean() && !e.literal.toBool()));
+				default: {
+					const Json *a = operand(*e.lhs, current, root);
+					const Json *b = operand(*e.rhs, current, root);
+					return a && b && compare(e.op, *a, *b);
+				}
+			}
+		}
+	}// namespace
+
+	struct JsonPath::Step {
+		enum class Kind {
+			Name,    // .name 或 ['a','b']
+			Index,   // [0] 或 [0,-1]
+			Wildcard,// * 或 [*]
+			Slice,   // [start:end:step]
+			Filter   // [?(expr)]
+		};
+
+		Kind kind = Kind::Wildcard;
+		bool descendant = false;       // 前缀为..，作用于当前节点及其全部后代
+		std::vector<std::string> names;// Name
+		std::vector<long> indices;     // Index
+		long start = 0, end = 0, step = 1;
+		bool hasStart = false, hasEnd = false;
+		std::shared_ptr<const Expr> filter;// Filter，执行计划拷贝时共享
+	};
+
+	namespace {
+		// 路径编译器，与Parser相同的游标风格
+		class PathCompiler {
+		public:
+			explicit PathCompiler(const std::string &expr) : _begin(expr.c_str()), _curr(expr.c_str()) {}
+
+			std::vector<JsonPath::Step> compile() {
+				std::vector<JsonPath::Step> plan;
+				skipWhitespace();
+				if (*_curr != '$') error("EXPECT ROOT");
+				++_curr;
+				while (true) {
+					skipWhitespace();
+					if (*_curr == '\0') break;
+					JsonPath::Step step;
+					if (_curr[0] == '.' && _curr[1] == '.') {
+						_curr += 2;
+						step.descendant = true;
+						if (*_curr == '[') {
+							parseBracket(step);
+						} else {
+							parseDotted(step);
+						}
+					} else if (*_curr == '.') {
+						++_curr;
+						parseDotted(step);
+					} else if (*_curr == '[') {
+						parseBracket(step);
+					} else {
+						error("INVALID PATH");
+					}
+					plan.push_back(std::move(step));
+				}
+				return plan;
+			}
+
+		private:
+			void skipWhitespace() noexcept {
+				while (*_curr == ' ' || *_curr == '\t' || *_curr == '\r' || *_curr == '\n') ++_curr;
+			}
+
+			static bool isNameChar(char ch) {
+				return ch != '\0' && !strchr(".[]()@$!=<>&|,:'\" \t\r\n", ch);
+			}
+
+			std::string parseName() {
+				const char *begin = _curr;
+				while (isNameChar(*_curr)) ++_curr;
+				if (begin == _curr) error("EXPECT NAME");
+				return std::string(begin, _curr);
+			}
+
+			// 单引号或双引号字符串，支持JSON转义
+			std::string parseQuoted() {
+				char quote = *_curr;
+				std::string raw = "\"";
+				while (*++_curr != quote) {
+					if (*_curr == '\0') error("MISS QUOTATION MARK");
+					if (*_curr == '\\') {
+						if (_curr[1] == '\0') error("MISS QUOTATION MARK");
+						if (_curr[1] == '\'') {
+							raw += '\'';
+							++_curr;
+							continue;
+						}
+						raw += *_curr++;
+					} else if (*_curr == '"') {
+						raw += '\\';
+					}
+					raw += *_curr;
+				}
+				++_curr;
+				raw += '"';
+				Parser p(raw);
+				return p.parse().toString();
+			}
+
+			long parseInteger() {
+				char *end;
+				long n = strtol(_curr, &end, 10);
+				if (end == _curr) error("EXPECT INTEGER");
+				_curr = end;
+				return n;
+			}
+
+			void parseDotted(JsonPath::Step &step) {
+				if (*_curr == '*') {
+					++_curr;
+					step.kind = JsonPath::Step::Kind::Wildcard;
+				} else {
+					step.kind = JsonPath::Step::Kind::Name;
+					step.names.push_back(parseName());
+				}
+			}
+
+			void parseBracket(JsonPath::Step &step) {
+				++_curr;// 跳过'['
+				skipWhitespace();
+				if (*_curr == '*') {
+					++_curr;
+					step.kind = JsonPath::Step::Kind::Wildcard;
+				} else if (*_curr == '?') {
+					++_curr;
+					skipWhitespace();
+					expect('(', "EXPECT PARENTHESIS");
+					step.kind = JsonPath::Step::Kind::Filter;
+					step.filter = parseOr();
+					skipWhitespace();
+					expect(')', "EXPECT PARENTHESIS");
+				} else if (*_curr == '\'' || *_curr == '"') {
+					step.kind = JsonPath::Step::Kind::Name;
+					while (true) {
+						skipWhitespace();
+						if (*_curr != '\'' && *_curr != '"') error("EXPECT NAME");
+						step.names.push_back(parseQuoted());
+						skipWhitespace();
+						if (*_curr != ',') break;
+						++_curr;
+					}
+				} else {
+					parseIndexOrSlice(step);
+				}
+				skipWhitespace();
+				expect(']', "MISS SQUARE BRACKET");
+			}
+
+			void parseIndexOrSlice(JsonPath::Step &step) {
+				long values[3] = {0, 0, 1};
+				bool present[3] = {false, false, false};
+				int part = 0;
+				while (true) {
+					skipWhitespace();
+					if (*_curr == '-' || is0to9(*_curr)) {
+						values[part] = parseInteger();
+						present[part] = true;
+						skipWhitespace();
+					}
+					if (*_curr != ':') break;
+					if (++part > 2) error("INVALID SLICE");
+					++_curr;
+				}
+				if (part == 0) {
+					// 下标或下标列表
+					if (!present[0]) error("EXPECT INDEX");
+					step.kind = JsonPath::Step::Kind::Index;
+					step.indices.push_back(values[0]);
+					while (*_curr == ',') {
+						++_curr;
+						skipWhitespace();
+						step.indices.push_back(parseInteger());
+						skipWhitespace();
+					}
+					return;
+				}
+				step.kind = JsonPath::Step::Kind::Slice;
+				step.start = values[0];
+				step.hasStart = present[0];
+				step.end = values[1];
+				step.hasEnd = present[1];
+				step.step = present[2] ? values[2] : 1;
+				if (step.step == 0) error("INVALID SLICE STEP");
+			}
+
+			// expr := and ('||' and)*
+			std::unique_ptr<Expr> parseOr() {
+				auto lhs = parseAnd();
+				skipWhitespace();
+				while (_curr[0] == '|' && _curr[1] == '|') {
+					_curr += 2;
+					auto e = std::make_unique<Expr>();
+					e->kind = Expr::Kind::Or;
+					e->lhs = std::move(lhs);
+					e->rhs = parseAnd();
+					lhs = std::move(e);
+					skipWhitespace();
+				}
+				return lhs;
+			}
+
+			// and := unary ('&&' unary)*
+			std::unique_ptr<Expr> parseAnd() {
+				auto lhs = parseUnary();
+				skipWhitespace();
+				while (_curr[0] == '&' && _curr[1] == '&') {
+					_curr += 2;
+					auto e = std::make_unique<Expr>();
+					e->kind = Expr::Kind::And;
+					e->lhs = std::move(lhs);
+					e->rhs = parseUnary();
+					lhs = std::move(e);
+					skipWhitespace();
+				}
+				return lhs;
+			}
+
+			// unary := '!' unary | '(' expr ')' | comparison
+			std::unique_ptr<Expr> parseUnary() {
+				skipWhitespace();
+				if (*_curr == '!' && _curr[1] != '=') {
+					++_curr;
+					auto e = std::make_unique<Expr>();
+					e->kind = Expr::Kind::Not;
+					e->lhs = parseUnary();
+					return e;
+				}
+				if (*_curr == '(') {
+					++_curr;
+					auto e = parseOr();
+					skipWhitespace();
+					expect(')', "EXPECT PARENTHESIS");
+					return e;
+				}
+				auto lhs = parseOperand();
+				skipWhitespace();
+				Expr::Op op;
+				if (_curr[0] == '=' && _curr[1] == '=') {
+					op = Expr::Op::Eq;
+				} else if (_curr[0] == '!' && _curr[1] == '=') {
+					op = Expr::Op::Ne;
+				} else if (_curr[0] == '<') {
+					op = _curr[1] == '=' ? Expr::Op::Le : Expr::Op::Lt;
+				} else if (_curr[0] == '>') {
+					op = _curr[1] == '=' ? Expr::Op::Ge : Expr::Op::Gt;
+				} else {
+					return lhs;
+				}
+				_curr += (op == Expr::Op::Lt || op == Expr::Op::Gt) ? 1 : 2;
+				auto e = std::make_unique<Expr>();
+				e->kind = Expr::Kind::Compare;
+				e->op = op;
+				e->lhs = std::move(lhs);
+				e->rhs = parseOperand();
+				return e;
+			}
+
+			std::unique_ptr<Expr> parseOperand() {
+				skipWhitespace();
+				auto e = std::make_unique<Expr>();
+				if (*_curr == '@' || *_curr == '$') {
+					e->kind = Expr::Kind::Path;
+					e->fromRoot = *_curr++ == '$';
+					while (true) {
+						if (*_curr == '.') {
+							++_curr;
+							e->keys.push_back(parseName());
+							e->indices.push_back(-1);
+						} else if (*_curr == '[') {
+							++_curr;
+							skipWhitespace();
+							if (*_curr == '\'' || *_curr == '"') {
+								e->keys.push_back(parseQuoted());
+								e->indices.push_back(-1);
+							} else {
+								long index = parseInteger();
+								if (index < 0) error("INVALID INDEX");
+								e->keys.emplace_back();
+								e->indices.push_back(index);
+							}
+							skipWhitespace();
+							expect(']', "MISS SQUARE BRACKET");
+						} else {
+							break;
+						}
+					}
+					return e;
+				}
+				e->kind = Expr::Kind::Literal;
+				if (*_curr == '\'' || *_curr == '"') {
+					e->literal = Json(parseQuoted());
+				} else if (strncmp(_curr, "true", 4) == 0) {
+					_curr += 4;
+					e->literal = Json(true);
+				} else if (strncmp(_curr, "false", 5) == 0) {
+					_curr += 5;
+					e->literal = Json(false);
+				} else if (strncmp(_curr, "null", 4) == 0) {
+					_curr += 4;
+					e->literal = Json(nullptr);
+				} else {
+					char *end;
+					double n = strtod(_curr, &end);
+					if (end == _curr) error("INVALID OPERAND");
+					_curr = end;
+					e->literal = Json(n);
+				}
+				return e;
+			}
+
+			void expect(char ch, const char *msg) {
+				if (*_curr != ch) error(msg);
+				++_curr;
+			}
+
+			[[noreturn]] void error(const std::string &msg) const {
+				throw JsonException(msg + ": " + _curr + " (at " + std::to_string(_curr - _begin) + ")");
+			}
+
+		private:
+			const char *_begin;
+			const char *_curr;
+		};
+
+		// 前序收集节点及其全部后代
+		void collectDescendants(const Json *node, std::vector<const Json *> &out) {
+			out.push_back(node);
+			if (node->isArray()) {
+				for (auto &e : node->toArray()) collectDescendants(&e, out);
+			} else if (node->isObject()) {
+				for (auto &p : node->toObject()) collectDescendants(&p.second, out);
+			}
+		}
+
+		// 对数组元素求值过滤器，大数组交由共享线程池分块求值，结果保持原有顺序
+		void filterArray(const Json::_array &arr, const Expr &filter, const Json &root, std::vector<const Json *> &out) {
+			size_t n = arr.size();
+			JsonThreadPool &pool = JsonThreadPool::shared();
+			if (n < JsonPath::parallelThreshold || pool.concurrency() < 2) {
+				for (auto &e : arr) {
+					if (evaluate(filter, e, root)) out.push_back(&e);
+				}
+				return;
+			}
+			std::vector<char> keep(n);
+			pool.parallelFor(n, pool.chunkSize(n), [&](size_t begin, size_t end) {
+				for (size_t i = begin; i != end; ++i) keep[i] = evaluate(filter, arr[i], root);
+			});
+			for (size_t i = 0; i != n; ++i) {
+				if (keep[i]) out.push_back(&arr[i]);
+			}
+		}
+
+		// 将单步操作作用于一个节点
+		void applyStep(const JsonPath::Step &step, const Json &node, const Json &root, std::vector<const Json *> &out) {
+			using Kind = JsonPath::Step::Kind;
+			switch (step.kind) {
+				case Kind::Name: {
+					if (!node.isObject()) return;
+					auto &obj = node.toObject();
+					for (auto &name : step.names) {
+						auto it = obj.find(name);
+						if (it != obj.end()) out.push_back(&it->second);
+					}
+					return;
+				}
+				case Kind::Index: {
+					if (!node.isArray()) return;
+					auto &arr = node.toArray();
+					long n = static_cast<long>(arr.size());
+					for (long i : step.indices) {
+						if (i < 0) i += n;
+						if (i >= 0 && i < n) out.push_back(&arr[i]);
+					}
+					return;
+				}
+				case Kind::Wildcard: {
+					if (node.isArray()) {
+						for (auto &e : node.toArray()) out.push_back(&e);
+					} else if (node.isObject()) {
+						for (auto &p : node.toObject()) out.push_back(&p.second);
+					}
+					return;
+				}
+				case Kind::Slice: {
+					if (!node.isArray()) return;
+					auto &arr = node.toArray();
+					long n = static_cast<long>(arr.size());
+					auto normalize = [n](long i) { return i < 0 ? std::max(i + n, -1L) : std::min(i, n); };
+					if (step.step > 0) {
+						long begin = step.hasStart ? std::max(normalize(step.start), 0L) : 0;
+						long end = step.hasEnd ? normalize(step.end) : n;
+						for (long i = begin; i < end; i += step.step) out.push_back(&arr[i]);
+					} else {
+						long begin = step.hasStart ? std::min(normalize(step.start), n - 1) : n - 1;
+						long end = step.hasEnd ? normalize(step.end) : -1;
+						for (long i = begin; i > end; i += step.step) out.push_back(&arr[i]);
+					}
+					return;
+				}
+				case Kind::Filter: {
+					if (node.isArray()) {
+						filterArray(node.toArray(), *step.filter, root, out);
+					} else if (node.isObject()) {
+						for (auto &p : node.toObject()) {
+							if (evaluate(*step.filter, p.second, root)) out.push_back(&p.second);
+						}
+					}
+					return;
+				}
+			}
+		}
+	}// namespace
+
+	JsonPath::JsonPath(const std::string &expr) : _expr(expr) {
+		PathCompiler compiler(_expr);
+		_plan = compiler.compile();
+	}
+
+	JsonPath::~JsonPath() = default;
+	JsonPath::JsonPath(const JsonPath &) = default;
+	JsonPath &JsonPath::operator=(const JsonPath &) = default;
+	JsonPath::JsonPath(JsonPath &&) noexcept = default;
+	JsonPath &JsonPath::operator=(JsonPath &&) noexcept = default;
+
+	std::vector<const Json *> JsonPath::query(const Json &root) const {
+		std::vector<const Json *> current{&root}, next, scope;
+		for (auto &step : _plan) {
+			next.clear();
+			for (const Json *node : current) {
+				if (step.descendant) {
+					scope.clear();
+					collectDescendants(node, scope);
+					for (const Json *n : scope) applyStep(step, *n, root, next);
+				} else {
+					applyStep(step, *node, root, next);
+				}
+			}
+			current.swap(next);
+			if (current.empty()) break;
+		}
+		return current;
+	}
+
+	const Json *JsonPath::first(const Json &root) const {
+		auto res = query(root);
+		return res.empty() ? nullptr : res.front();
+	}
+
+}// namespace DianaJSON
@@ -0,0 +1,48 @@
+#ifndef JSONPATH_H
+#define JSONPATH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+namespace DianaJSON {
+	// JSONPath子集查询引擎
+	// 支持：$、.name、['name']、[n]、[a,b]、*、..（递归下降）、[start:end:step]（切片）、[?(expr)]（过滤器）
+	// 过滤器表达式支持：@.a.b、$.a、字面量（数字、字符串、true、false、null）、
+	// 比较运算（== != < <= > >=）、逻辑运算（&& || !）及括号
+	// 路径只编译一次为执行计划，查询时直接遍历Json树，返回节点指针而非拷贝
+	class JsonPath final {
+	public:
+		// 编译，表达式非法时抛出JsonException
+		explicit JsonPath(const std::string &expr);
+
+		~JsonPath();
+		JsonPath(const JsonPath &);
+		JsonPath &operator=(const JsonPath &);
+		JsonPath(JsonPath &&) noexcept;
+		JsonPath &operator=(JsonPath &&) noexcept;
+
+	public:
+		// 查询，返回的指针指向root内部节点，root修改或析构后失效
+		std::vector<const Json *> query(const Json &root) const;
+		// 返回首个匹配节点，无匹配时返回nullptr
+		const Json *first(const Json &root) const;
+
+		const std::string &expression() const noexcept { return _expr; }
+
+	public:
+		// 数组元素数超过该阈值时，过滤器并行求值
+		static constexpr size_t parallelThreshold = 4096;
+
+	public:
+		struct Step;// 执行计划中的单步操作（实现细节）
+
+	private:
+		std::string _expr;
+		std::vector<Step> _plan;
+	};
+}// namespace DianaJSON
+
+#endif
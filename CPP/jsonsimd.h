@@ -0,0 +1,310 @@
+#ifndef JSONSIMD_H
+#define JSONSIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 解析时校验字符串的UTF-8编码，可在编译选项中设置为0关闭
+#ifndef DIANA_JSON_VALIDATE_UTF8
+#define DIANA_JSON_VALIDATE_UTF8 1
+#endif
+
+// 按编译目标选择字符串与白空格扫描的实现：AVX2、SSSE3、SSE2（x86-64的基线）或逐字节
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DIANA_JSON_SIMD_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#define DIANA_JSON_SIMD_WIDTH 16
+#endif
+#if defined(DIANA_JSON_SIMD_WIDTH) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if DIANA_JSON_VALIDATE_UTF8 && (defined(__AVX2__) || defined(__SSSE3__))
+#define DIANA_JSON_UTF8_SIMD 1// 以查表法向量化校验，否则逐字节校验含非ASCII字节的段
+#endif
+
+// 对齐的块不会跨越内存页，读到'\0'之后的块尾是安全的，但AddressSanitizer会报告越界
+#if defined(__GNUC__) || defined(__clang__)
+#define DIANA_JSON_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define DIANA_JSON_NO_SANITIZE_ADDRESS
+#endif
+
+namespace DianaJSON {
+	namespace simd {
+		// 校验[p, end)为合法的UTF-8：拒绝过长编码、代理项、超出U+10FFFF的码点与截断的序列
+		inline bool validateUTF8(const unsigned char *p, const unsigned char *end) noexcept {
+			while (p < end) {
+				unsigned char ch = *p, lo = 0x80, hi = 0xBF;
+				if (ch < 0x80) {
+					++p;
+					continue;
+				}
+				size_t n;
+				if (ch >= 0xC2 && ch <= 0xDF) {
+					n = 1;
+				} else if (ch >= 0xE0 && ch <= 0xEF) {
+					n = 2;
+				} else if (ch >= 0xF0 && ch <= 0xF4) {
+					n = 3;
+				} else {
+					return false;
+				}
+				if (static_cast<size_t>(end - p) <= n) return false;
+				if (ch == 0xE0) {
+					lo = 0xA0;
+				} else if (ch == 0xED) {
+					hi = 0x9F;
+				} else if (ch == 0xF0) {
+					lo = 0x90;
+				} else if (ch == 0xF4) {
+					hi = 0x8F;
+				}
+				if (p[1] < lo || p[1] > hi) return false;
+				for (size_t i = 2; i <= n; ++i) {
+					if ((p[i] & 0xC0) != 0x80) return false;
+				}
+				p += n + 1;
+			}
+			return true;
+		}
+
+#ifdef DIANA_JSON_SIMD_WIDTH
+		inline unsigned ctz(unsigned mask) noexcept {
+#ifdef _MSC_VER
+			unsigned long i;
+			_BitScanForward(&i, mask);
+			return static_cast<unsigned>(i);
+#else
+			return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+		}
+
+#if DIANA_JSON_SIMD_WIDTH == 32
+		using Block = __m256i;
+		DIANA_JSON_NO_SANITIZE_ADDRESS inline Block load(const char *p) noexcept { return _mm256_load_si256(reinterpret_cast<const __m256i *>(p)); }
+		DIANA_JSON_NO_SANITIZE_ADDRESS inline Block loadu(const char *p) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+		inline Block set1(int ch) noexcept { return _mm256_set1_epi8(static_cast<char>(ch)); }
+		inline Block zero() noexcept { return _mm256_setzero_si256(); }
+		inline Block bitAnd(Block a, Block b) noexcept { return _mm256_and_si256(a, b); }
+		inline Block bitOr(Block a, Block b) noexcept { return _mm256_or_si256(a, b); }
+		inline Block eq(Block a, Block b) noexcept { return _mm256_cmpeq_epi8(a, b); }
+		inline Block lt(Block a, Block b) noexcept { return _mm256_cmpgt_epi8(b, a); }
+		inline Block min(Block a, Block b) noexcept { return _mm256_min_epu8(a, b); }
+		inline unsigned mask(Block a) noexcept { return static_cast<unsigned>(_mm256_movemask_epi8(a)); }
+		inline Block index() noexcept {
+			return _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+									16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+		}
+#else
+		using Block = __m128i;
+		DIANA_JSON_NO_SANITIZE_ADDRESS inline Block load(const char *p) noexcept { return _mm_load_si128(reinterpret_cast<const __m128i *>(p)); }
+		DIANA_JSON_NO_SANITIZE_ADDRESS inline Block loadu(const char *p) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+		inline Block set1(int ch) noexcept { return _mm_set1_epi8(static_cast<char>(ch)); }
+		inline Block zero() noexcept { return _mm_setzero_si128(); }
+		inline Block bitAnd(Block a, Block b) noexcept { return _mm_and_si128(a, b); }
+		inline Block bitOr(Block a, Block b) noexcept { return _mm_or_si128(a, b); }
+		inline Block eq(Block a, Block b) noexcept { return _mm_cmpeq_epi8(a, b); }
+		inline Block lt(Block a, Block b) noexcept { return _mm_cmplt_epi8(a, b); }
+		inline Block min(Block a, Block b) noexcept { return _mm_min_epu8(a, b); }
+		inline unsigned mask(Block a) noexcept { return static_cast<unsigned>(_mm_movemask_epi8(a)); }
+		inline Block index() noexcept { return _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+#endif
+		constexpr unsigned width = DIANA_JSON_SIMD_WIDTH;
+		constexpr unsigned allBits = width == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+
+#ifdef DIANA_JSON_UTF8_SIMD
+		// 查表法校验UTF-8（Keiser & Lemire）：以前一字节的高、低4位与当前字节的高4位查三张表，三者相与得到两字节间的错误
+		// 三、四字节序列的后续字节另以前两、三字节判断；非ASCII的块与前一块相接，块尾未完成的序列留待下一块检查
+		namespace utf8 {
+			constexpr uint8_t tooShort = 1 << 0;    // 11______ 0_______ 或 11______ 11______
+			constexpr uint8_t tooLong = 1 << 1;     // 0_______ 10______
+			constexpr uint8_t overlong3 = 1 << 2;   // 11100000 100_____
+			constexpr uint8_t tooLarge = 1 << 3;    // 11110100 1001____ 及更大
+			constexpr uint8_t surrogate = 1 << 4;   // 11101101 101_____
+			constexpr uint8_t overlong2 = 1 << 5;   // 1100000_ 10______
+			constexpr uint8_t tooLarge1000 = 1 << 6;// 11110101 1000____ 及更大
+			constexpr uint8_t overlong4 = 1 << 6;   // 11110000 1000____
+			constexpr uint8_t twoConts = 1 << 7;    // 10______ 10______
+			constexpr uint8_t carry = tooShort | tooLong | twoConts;
+			constexpr uint8_t large = carry | tooLarge | tooLarge1000;
+
+			alignas(16) constexpr uint8_t byte1High[16] = {
+					tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+					twoConts, twoConts, twoConts, twoConts,
+					tooShort | overlong2,
+					tooShort,
+					tooShort | overlong3 | surrogate,
+					tooShort | tooLarge | tooLarge1000 | overlong4};
+			alignas(16) constexpr uint8_t byte1Low[16] = {
+					carry | overlong3 | overlong2 | overlong4,
+					carry | overlong2,
+					carry, carry,
+					carry | tooLarge,
+					large, large, large, large, large, large, large, large,
+					large | surrogate,
+					large, large};
+			alignas(16) constexpr uint8_t byte2High[16] = {
+					tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+					tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4,
+					tooLong | overlong2 | twoConts | overlong3 | tooLarge,
+					tooLong | overlong2 | twoConts | surrogate | tooLarge,
+					tooLong | overlong2 | twoConts | surrogate | tooLarge,
+					tooShort, tooShort, tooShort, tooShort};
+
+#if DIANA_JSON_SIMD_WIDTH == 32
+			inline Block table(const uint8_t *t) noexcept { return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(t))); }
+			inline Block lookup(Block t, Block i) noexcept { return _mm256_shuffle_epi8(t, i); }
+			inline Block high4(Block a) noexcept { return _mm256_and_si256(_mm256_srli_epi16(a, 4), set1(0x0F)); }
+			inline Block subs(Block a, Block b) noexcept { return _mm256_subs_epu8(a, b); }
+			inline Block bitXor(Block a, Block b) noexcept { return _mm256_xor_si256(a, b); }
+			// 当前块整体后移N字节，空出的位置由前一块的末尾填补
+			template<int N>
+			inline Block prev(Block input, Block previous) noexcept {
+				return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+			}
+			// 块尾的最后三个字节若是未完成序列的首字节则非零
+			inline Block incomplete(Block a) noexcept {
+				return subs(a, _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+												-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+												static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1)));
+			}
+#else
+			inline Block table(const uint8_t *t) noexcept { return _mm_load_si128(reinterpret_cast<const __m128i *>(t)); }
+			inline Block lookup(Block t, Block i) noexcept { return _mm_shuffle_epi8(t, i); }
+			inline Block high4(Block a) noexcept { return _mm_and_si128(_mm_srli_epi16(a, 4), set1(0x0F)); }
+			inline Block subs(Block a, Block b) noexcept { return _mm_subs_epu8(a, b); }
+			inline Block bitXor(Block a, Block b) noexcept { return _mm_xor_si128(a, b); }
+			template<int N>
+			inline Block prev(Block input, Block previous) noexcept { return _mm_alignr_epi8(input, previous, 16 - N); }
+			inline Block incomplete(Block a) noexcept {
+				return subs(a, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+											 static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1)));
+			}
+#endif
+
+			// 返回input中每个字节处的错误（非零即不合法），previous为前一块
+			inline Block check(Block input, Block previous) noexcept {
+				Block prev1 = prev<1>(input, previous);
+				Block special = bitAnd(bitAnd(lookup(table(byte1High), high4(prev1)), lookup(table(byte1Low), bitAnd(prev1, set1(0x0F)))),
+									   lookup(table(byte2High), high4(input)));
+				// 前两字节为111_____或前三字节为1111____时，当前字节必须是后续字节
+				Block must23 = bitOr(subs(prev<2>(input, previous), set1(0xE0 - 0x80)), subs(prev<3>(input, previous), set1(0xF0 - 0x80)));
+				return bitXor(bitAnd(must23, set1(0x80)), special);
+			}
+		}// namespace utf8
+#endif
+
+		// 返回从p起第一个'"'、'\\'或控制字符（含'\0'）的位置，其间的字节可以整段复制
+		// 开启DIANA_JSON_VALIDATE_UTF8时同时校验这段字节，不合法时返回nullptr
+		DIANA_JSON_NO_SANITIZE_ADDRESS
+		inline const char *scanString(const char *p) noexcept {
+			const Block quote = set1('"'), backslash = set1('\\'), control = set1(0x1F);
+			const char *block = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(p) & ~static_cast<uintptr_t>(width - 1));
+			unsigned skip = static_cast<unsigned>(p - block), bits, end;
+#if DIANA_JSON_VALIDATE_UTF8
+			const Block idx = index();
+			Block error = zero();
+#ifdef DIANA_JSON_UTF8_SIMD
+			Block previous = zero(), incomplete = zero();
+#endif
+#endif
+			while (true) {
+				Block input = load(block);
+				bits = mask(bitOr(bitOr(eq(input, quote), eq(input, backslash)), eq(min(input, control), input))) >> skip << skip;// 首块中p之前的字节不属于本段
+				end = bits != 0 ? ctz(bits) : width;
+#if DIANA_JSON_VALIDATE_UTF8
+				// 本段以外的字节清零，视为ASCII；段前是ASCII的引号或转义，段后的零使截断的序列报错
+				Block v = bitAnd(input, bitAnd(lt(set1(static_cast<int>(skip) - 1), idx), lt(idx, set1(static_cast<int>(end)))));
+#ifdef DIANA_JSON_UTF8_SIMD
+				if (mask(v) != 0) {
+					error = bitOr(error, utf8::check(v, previous));
+					incomplete = utf8::incomplete(v);
+				} else {
+					error = bitOr(error, incomplete);
+				}
+				previous = v;
+#else
+				error = bitOr(error, v);// 没有查表指令时只记录是否含非ASCII字节，最后逐字节校验
+#endif
+#endif
+				if (bits != 0) break;
+				block += width;
+				skip = 0;
+			}
+#if DIANA_JSON_VALIDATE_UTF8
+#ifdef DIANA_JSON_UTF8_SIMD
+			if (mask(eq(error, zero())) != allBits) return nullptr;
+#else
+			if (mask(error) != 0 && !validateUTF8(reinterpret_cast<const unsigned char *>(p), reinterpret_cast<const unsigned char *>(block + end))) {
+				return nullptr;
+			}
+#endif
+#endif
+			return block + end;
+		}
+
+		// 白空格多为几个到十几个字节，从p起不对齐地读取一块，通常一次即可跳过；块不跨越内存页时读取是安全的，跨页时逐字节处理
+		constexpr uintptr_t pageSize = 4096;
+		inline bool inPage(const char *p) noexcept { return (reinterpret_cast<uintptr_t>(p) & (pageSize - 1)) <= pageSize - width; }
+
+		// 返回从p起第一个不是空格的位置，每块只比较一次
+		DIANA_JSON_NO_SANITIZE_ADDRESS
+		inline const char *skipSpaces(const char *p) noexcept {
+			const Block space = set1(' ');
+			while (inPage(p)) {
+				unsigned bits = ~mask(eq(loadu(p), space)) & allBits;
+				if (bits != 0) return p + ctz(bits);
+				p += width;
+			}
+			while (*p == ' ') ++p;
+			return p;
+		}
+
+		// 返回从p起第一个不是白空格的位置
+		DIANA_JSON_NO_SANITIZE_ADDRESS
+		inline const char *skipWhitespace(const char *p) noexcept {
+			const Block space = set1(' '), tab = set1('\t'), lf = set1('\n'), cr = set1('\r');
+			while (inPage(p)) {
+				Block input = loadu(p);
+				unsigned bits = ~mask(bitOr(bitOr(eq(input, space), eq(input, tab)), bitOr(eq(input, lf), eq(input, cr)))) & allBits;
+				if (bits != 0) return p + ctz(bits);
+				p += width;
+			}
+			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+			return p;
+		}
+#else
+		inline const char *scanString(const char *p) noexcept {
+			auto s = reinterpret_cast<const unsigned char *>(p);
+			unsigned char high = 0;
+			while (*s != '"' && *s != '\\' && *s >= 0x20) {
+				high |= *s++;
+			}
+#if DIANA_JSON_VALIDATE_UTF8
+			if ((high & 0x80) != 0 && !validateUTF8(reinterpret_cast<const unsigned char *>(p), s)) return nullptr;
+#else
+			(void) high;
+#endif
+			return reinterpret_cast<const char *>(s);
+		}
+
+		inline const char *skipSpaces(const char *p) noexcept {
+			while (*p == ' ') ++p;
+			return p;
+		}
+
+		inline const char *skipWhitespace(const char *p) noexcept {
+			while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+			return p;
+		}
+#endif
+	}// namespace simd
+}// namespace DianaJSON
+
+#endif
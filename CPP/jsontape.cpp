@@ -0,0 +1,502 @@
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "jsonerror.h"
+#include "jsontape.h"
+#include "parse.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DIANA_TAPE_MMAP
+#endif
+
+namespace DianaJSON {
+	namespace {
+		constexpr char tapeMagic[8] = {'D', 'I', 'A', 'N', 'A', 'T', 'P', '1'};
+		constexpr uint64_t byteOrderMark = 0x0102030405060708ull;
+		constexpr size_t headerWords = 4;// 魔数、字节序标记、字数、字符串区字节数
+		constexpr uint64_t payloadMask = 0x00FFFFFFFFFFFFFFull;
+
+		constexpr uint64_t makeWord(char tag, uint64_t payload) {
+			return (static_cast<uint64_t>(static_cast<uint8_t>(tag)) << 56) | payload;
+		}
+
+		constexpr size_t alignWords(size_t bytes) {
+			return (bytes + 7) / 8;
+		}
+
+		// 构建磁带：字序列与字符串区分开追加，finish()时拼接为完整映像
+		class TapeBuilder {
+		public:
+			void value(const Json &json) {
+				switch (json.getType()) {
+					case JsonValueType::Null:
+						_words.push_back(makeWord('n', 0));
+						break;
+					case JsonValueType::Bool:
+						_words.push_back(makeWord(json.toBool() ? 't' : 'f', 0));
+						break;
+					case JsonValueType::Number:
+						number(json.toDouble());
+						break;
+					case JsonValueType::String:
+						string(json.toString());
+						break;
+					case JsonValueType::Array: {
+						size_t at = open('[');
+						for (auto &e : json.toArray()) value(e);
+						close(at, json.size());
+						break;
+					}
+					case JsonValueType::Object: {
+						size_t at = open('{');
+						for (auto &p : json.toObject()) {
+							key(p.first);
+							value(p.second);
+						}
+						close(at, json.size());
+						break;
+					}
+				}
+			}
+
+			// 由Parser的流式读取接口驱动，不构建Json节点
+			void value(Parser &p) {
+				switch (p.peek()) {
+					case 'n':
+						p.readNull();
+						_words.push_back(makeWord('n', 0));
+						break;
+					case 't':
+					case 'f':
+						_words.push_back(makeWord(p.readBool() ? 't' : 'f', 0));
+						break;
+					case '"':
+						string(p.readString());
+						break;
+					case '[': {
+						p.consume('[');
+						size_t at = open('['), count = 0;
+						if (!p.consume(']')) {
+							do {
+								value(p);
+								++count;
+							} while (p.consume(','));
+							p.expect(']', "MISS COMMA OR SQUARE BRACKET");
+						}
+						close(at, count);
+						break;
+					}
+					case '{': {
+						p.consume('{');
+						size_t at = open('{'), count = 0;
+						if (!p.consume('}')) {
+							do {
+								key(p.readString());
+								p.expect(':', "MISS COLON");
+								value(p);
+								++count;
+							} while (p.consume(','));
+							p.expect('}', "MISS COMMA OR CURLY BRACKET");
+						}
+						close(at, count);
+						break;
+					}
+					case '\0':
+						p.fail("EXPECT VALUE");
+					default:
+						number(p.readNumber());
+						break;
+				}
+			}
+
+			std::vector<uint64_t> finish() {
+				std::vector<uint64_t> image(headerWords + _words.size() + alignWords(_strings.size()), 0);
+				memcpy(&image[0], tapeMagic, sizeof(tapeMagic));
+				image[1] = byteOrderMark;
+				image[2] = _words.size();
+				image[3] = _strings.size();
+				memcpy(&image[headerWords], _words.data(), _words.size() * sizeof(uint64_t));
+				memcpy(&image[headerWords + _words.size()], _strings.data(), _strings.size());
+				return image;
+			}
+
+		private:
+			size_t open(char tag) {
+				size_t at = _words.size();
+				_words.push_back(makeWord(tag, 0));
+				_words.push_back(0);
+				return at;
+			}
+
+			void close(size_t at, size_t count) {
+				_words[at] |= _words.size();
+				_words[at + 1] = count;
+			}
+
+			void number(double n) {
+				uint64_t bits;
+				memcpy(&bits, &n, sizeof(bits));
+				_words.push_back(makeWord('d', 0));
+				_words.push_back(bits);
+			}
+
+			uint64_t append(const std::string &s) {
+				uint64_t offset = _strings.size();
+				if (s.size() > UINT32_MAX || offset > payloadMask) {
+					throw JsonException("TAPE TOO LARGE");
+				}
+				uint32_t len = static_cast<uint32_t>(s.size());
+				_strings.append(reinterpret_cast<const char *>(&len), sizeof(len));
+				_strings.append(s);
+				_strings += '\0';
+				return offset;
+			}
+
+			void string(const std::string &s) {
+				_words.push_back(makeWord('"', append(s)));
+			}
+
+			// 对象键大量重复，只存一份
+			void key(const std::string &s) {
+				auto it = _keys.find(s);
+				if (it == _keys.end()) {
+					it = _keys.emplace(s, append(s)).first;
+				}
+				_words.push_back(makeWord('"', it->second));
+			}
+
+		private:
+			std::vector<uint64_t> _words;
+			std::string _strings;
+			std::unordered_map<std::string, uint64_t> _keys;
+		};
+	}// namespace
+
+	JsonTape::JsonTape() noexcept = default;
+
+	JsonTape::~JsonTape() {
+		release();
+	}
+
+	JsonTape::JsonTape(JsonTape &&rhs) noexcept {
+		*this = std::move(rhs);
+	}
+
+	JsonTape &JsonTape::operator=(JsonTape &&rhs) noexcept {
+		if (this != &rhs) {
+			release();
+			_image = std::move(rhs._image);
+			_map = rhs._map;
+			_byteSize = rhs._byteSize;
+			_words = rhs._words;
+			_count = rhs._count;
+			_strings = rhs._strings;
+			_stringSize = rhs._stringSize;
+			rhs._map = nullptr;
+			rhs._image.clear();
+			rhs._byteSize = rhs._count = rhs._stringSize = 0;
+			rhs._words = nullptr;
+			rhs._strings = nullptr;
+		}
+		return *this;
+	}
+
+	JsonTape JsonTape::fromJson(const Json &json) {
+		TapeBuilder builder;
+		builder.value(json);
+		JsonTape tape;
+		tape.adopt(builder.finish());
+		return tape;
+	}
+
+	JsonTape JsonTape::parse(const std::string &context, std::string &errorText) noexcept {
+		JsonTape tape;
+		try {
+			Parser p(context);
+			TapeBuilder builder;
+			builder.value(p);
+			p.finish();
+			tape.adopt(builder.finish());
+		} catch (JsonException &e) {
+			errorText = e.what();
+		}
+		return tape;
+	}
+
+	JsonTape JsonTape::load(const std::string &path, std::string &errorText) noexcept {
+		JsonTape tape;
+#ifdef DIANA_TAPE_MMAP
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			errorText = "CANNOT OPEN FILE: " + path;
+			return tape;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			errorText = "INVALID TAPE: " + path;
+			return tape;
+		}
+		void *map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED) {
+			errorText = "CANNOT MAP FILE: " + path;
+			return tape;
+		}
+		tape._map = map;
+		tape._byteSize = static_cast<size_t>(st.st_size);
+		if (!tape.attach(map, tape._byteSize, errorText)) {
+			tape.release();
+		}
+#else
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in) {
+			errorText = "CANNOT OPEN FILE: " + path;
+			return tape;
+		}
+		size_t size = static_cast<size_t>(in.tellg());
+		std::vector<uint64_t> image(alignWords(size));
+		in.seekg(0);
+		if (!in.read(reinterpret_cast<char *>(image.data()), size)) {
+			errorText = "CANNOT READ FILE: " + path;
+			return tape;
+		}
+		tape._image = std::move(image);
+		tape._byteSize = size;
+		if (!tape.attach(tape._image.data(), size, errorText)) {
+			tape.release();
+		}
+#endif
+		return tape;
+	}
+
+	bool JsonTape::save(const std::string &path, std::string &errorText) const noexcept {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			errorText = "CANNOT OPEN FILE: " + path;
+			return false;
+		}
+		const void *image = _map ? _map : static_cast<const void *>(_image.data());
+		if (!out.write(static_cast<const char *>(image), static_cast<std::streamsize>(_byteSize))) {
+			errorText = "CANNOT WRITE FILE: " + path;
+			return false;
+		}
+		return true;
+	}
+
+	JsonTapeRef JsonTape::root() const {
+		if (empty()) {
+			throw JsonException("empty tape");
+		}
+		return JsonTapeRef(this, 0);
+	}
+
+	void JsonTape::adopt(std::vector<uint64_t> &&image) noexcept {
+		release();
+		_image = std::move(image);
+		_byteSize = _image.size() * sizeof(uint64_t);
+		std::string errorText;
+		attach(_image.data(), _byteSize, errorText);
+	}
+
+	bool JsonTape::attach(const void *image, size_t byteSize, std::string &errorText) noexcept {
+		auto header = static_cast<const uint64_t *>(image);
+		if (byteSize < headerWords * sizeof(uint64_t) || memcmp(header, tapeMagic, sizeof(tapeMagic)) != 0) {
+			errorText = "INVALID TAPE: bad magic";
+			return false;
+		}
+		if (header[1] != byteOrderMark) {
+			errorText = "INVALID TAPE: byte order mismatch";
+			return false;
+		}
+		uint64_t count = header[2], stringSize = header[3];
+		uint64_t available = byteSize / sizeof(uint64_t) - headerWords;
+		if (count == 0 || count > available || alignWords(stringSize) > available - count) {
+			errorText = "INVALID TAPE: truncated";
+			return false;
+		}
+		_words = header + headerWords;
+		_count = static_cast<size_t>(count);
+		_strings = reinterpret_cast<const char *>(_words + _count);
+		_stringSize = static_cast<size_t>(stringSize);
+		return true;
+	}
+
+	void JsonTape::release() noexcept {
+#ifdef DIANA_TAPE_MMAP
+		if (_map) {
+			munmap(_map, _byteSize);
+		}
+#endif
+		_map = nullptr;
+		_image.clear();
+		_byteSize = _count = _stringSize = 0;
+		_words = nullptr;
+		_strings = nullptr;
+	}
+
+	JsonValueType JsonTapeRef::getType() const {
+		switch (tag()) {
+			case 'n':
+				return JsonValueType::Null;
+			case 't':
+			case 'f':
+				return JsonValueType::Bool;
+			case 'd':
+				return JsonValueType::Number;
+			case '"':
+				return JsonValueType::String;
+			case '[':
+				return JsonValueType::Array;
+			case '{':
+				return JsonValueType::Object;
+			default:
+				throw JsonException("corrupt tape");
+		}
+	}
+
+	bool JsonTapeRef::toBool() const {
+		if (!isBoolean()) throw JsonException("not a bool");
+		return tag() == 't';
+	}
+
+	double JsonTapeRef::toDouble() const {
+		if (!isNumber()) throw JsonException("not a double");
+		uint64_t bits = word(_index + 1);
+		double n;
+		memcpy(&n, &bits, sizeof(n));
+		return n;
+	}
+
+	std::string_view JsonTapeRef::toString() const {
+		if (!isString()) throw JsonException("not a string");
+		uint64_t offset = payload();
+		uint32_t len;
+		if (offset > _tape->_stringSize || _tape->_stringSize - offset < sizeof(len)) throw JsonException("corrupt tape");
+		memcpy(&len, _tape->_strings + offset, sizeof(len));
+		if (_tape->_stringSize - offset - sizeof(len) < len) throw JsonException("corrupt tape");
+		return std::string_view(_tape->_strings + offset + sizeof(len), len);
+	}
+
+	size_t JsonTapeRef::size() const {
+		if (!isArray() && !isObject()) throw JsonException("not a array or object");
+		uint64_t count = word(_index + 1), words = containerEnd() - _index - 2;
+		// 每个元素至少占一个字，对象成员至少占两个字
+		if (count > (isObject() ? words / 2 : words)) corrupt();
+		return static_cast<size_t>(count);
+	}
+
+	size_t JsonTapeRef::containerEnd() const {
+		uint64_t end = payload();
+		if (end < _index + 2 || end > _tape->_count) corrupt();
+		return static_cast<size_t>(end);
+	}
+
+	void JsonTapeRef::corrupt() {
+		throw JsonException("corrupt tape");
+	}
+
+	size_t JsonTapeRef::next() const {
+		size_t index;
+		switch (tag()) {
+			case '[':
+			case '{':
+				index = containerEnd();
+				break;
+			case 'd':
+				index = _index + 2;
+				break;
+			default:
+				index = _index + 1;
+				break;
+		}
+		if (index <= _index || index > _tape->_count) throw JsonException("corrupt tape");
+		return index;
+	}
+
+	JsonTapeRef JsonTapeRef::operator[](size_t index) const {
+		if (!isArray()) throw JsonException("not a array");
+		if (index >= size()) throw JsonException("index out of range");
+		JsonTapeRef e(_tape, _index + 2);
+		while (index-- > 0) e._index = e.next();
+		return e;
+	}
+
+	size_t JsonTapeRef::find(std::string_view key) const {
+		if (!isObject()) throw JsonException("not a object");
+		size_t end = containerEnd();
+		for (JsonTapeRef k(_tape, _index + 2); k._index < end;) {
+			JsonTapeRef v(_tape, k._index + 1);
+			if (k.toString() == key) return v._index;
+			k._index = v.next();
+		}
+		return 0;// 根节点不可能是成员值
+	}
+
+	JsonTapeRef JsonTapeRef::operator[](std::string_view key) const {
+		size_t index = find(key);
+		if (index == 0) throw JsonException("key not found");
+		return JsonTapeRef(_tape, index);
+	}
+
+	bool JsonTapeRef::contains(std::string_view key) const {
+		return find(key) != 0;
+	}
+
+	JsonTapeRef::iterator JsonTapeRef::begin() const {
+		if (!isArray() && !isObject()) throw JsonException("not a array or object");
+		return iterator(_tape, _index + 2, isObject());
+	}
+
+	JsonTapeRef::iterator JsonTapeRef::end() const {
+		if (!isArray() && !isObject()) throw JsonException("not a array or object");
+		return iterator(_tape, containerEnd(), isObject());
+	}
+
+	Json JsonTapeRef::toJson() const {
+		switch (tag()) {
+			case 'n':
+				return Json(nullptr);
+			case 't':
+			case 'f':
+				return Json(toBool());
+			case 'd':
+				return Json(toDouble());
+			case '"':
+				return Json(std::string(toString()));
+			case '[': {
+				Json::_array arr;
+				arr.reserve(size());
+				for (auto it = begin(); it != end(); ++it) arr.push_back((*it).toJson());
+				return Json(std::move(arr));
+			}
+			case '{': {
+				Json::_object obj;
+				obj.reserve(size());
+				for (auto it = begin(); it != end(); ++it) obj.emplace(std::string(it.key()), (*it).toJson());
+				return Json(std::move(obj));
+			}
+			default:
+				throw JsonException("corrupt tape");
+		}
+	}
+
+	JsonTapeRef JsonTapeRef::iterator::operator*() const {
+		return JsonTapeRef(_tape, _object ? _index + 1 : _index);
+	}
+
+	std::string_view JsonTapeRef::iterator::key() const {
+		if (!_object) throw JsonException("not a object");
+		return JsonTapeRef(_tape, _index).toString();
+	}
+
+	JsonTapeRef::iterator &JsonTapeRef::iterator::operator++() {
+		_index = (**this).next();
+		return *this;
+	}
+}// namespace DianaJSON
@@ -0,0 +1,139 @@
+#ifndef JSONTAPE_H
+#define JSONTAPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.h"
+
+namespace DianaJSON {
+	class JsonTapeRef;
+
+	// 只读的磁带（tape）格式文档：一段连续的64位字序列
+	// 每个字高8位为类型标记，低56位为负载：
+	//   'n' 't' 'f'：单字
+	//   'd'：其后一个字为double的位模式
+	//   '"'：负载为字符串区偏移，字符串区内依次存放uint32长度、字符与'\0'
+	//   '[' '{'：负载为容器之后第一个字的下标（跳转偏移），其后一个字为元素数，对象的元素为键、值交替
+	// 内存中的表示与文件格式完全相同，save()直接写出，load()在POSIX系统上直接mmap，无需反序列化
+	// 文件按本机字节序存储，头部的字节序标记不匹配时load()失败
+	class JsonTape final {
+	public:
+		JsonTape() noexcept;
+		~JsonTape();
+
+		JsonTape(const JsonTape &) = delete;
+		JsonTape &operator=(const JsonTape &) = delete;
+		JsonTape(JsonTape &&) noexcept;
+		JsonTape &operator=(JsonTape &&) noexcept;
+
+	public:
+		// 从Json树构建
+		static JsonTape fromJson(const Json &json);
+		// 直接从JSON文本构建，不经过Json树
+		static JsonTape parse(const std::string &context, std::string &errorText) noexcept;
+		// 映射文件，仅校验头部，文件须由save()生成
+		static JsonTape load(const std::string &path, std::string &errorText) noexcept;
+		bool save(const std::string &path, std::string &errorText) const noexcept;
+
+	public:
+		bool empty() const noexcept { return _count == 0; }
+		JsonTapeRef root() const;
+		size_t byteSize() const noexcept { return _byteSize; }// 完整映像（含头部）的字节数
+
+	private:
+		void adopt(std::vector<uint64_t> &&image) noexcept;
+		bool attach(const void *image, size_t byteSize, std::string &errorText) noexcept;
+		void release() noexcept;
+
+	private:
+		std::vector<uint64_t> _image;// 自行构建或非POSIX系统读入的映像
+		void *_map = nullptr;        // mmap得到的映像
+		size_t _byteSize = 0;
+
+		const uint64_t *_words = nullptr;
+		size_t _count = 0;
+		const char *_strings = nullptr;
+		size_t _stringSize = 0;
+
+		friend class JsonTapeRef;
+	};
+
+	// 指向磁带中一个值的轻量引用，所属JsonTape析构或移动后失效
+	class JsonTapeRef final {
+	public:
+		class iterator;
+
+	public:
+		JsonValueType getType() const;
+		bool isNull() const { return tag() == 'n'; }
+		bool isBoolean() const { return tag() == 't' || tag() == 'f'; }
+		bool isNumber() const { return tag() == 'd'; }
+		bool isString() const { return tag() == '"'; }
+		bool isArray() const { return tag() == '['; }
+		bool isObject() const { return tag() == '{'; }
+
+	public:
+		bool toBool() const;
+		double toDouble() const;
+		std::string_view toString() const;// 指向磁带内部，不拷贝
+
+	public:
+		size_t size() const;
+		JsonTapeRef operator[](size_t index) const;// 数组按下标访问，线性跳转
+		JsonTapeRef operator[](std::string_view key) const;
+		bool contains(std::string_view key) const;
+		iterator begin() const;
+		iterator end() const;
+
+	public:
+		Json toJson() const;
+
+	private:
+		JsonTapeRef(const JsonTape *tape, size_t index) noexcept : _tape(tape), _index(index) {}
+
+		// load()只校验头部，访问任何字之前都要检查下标，越界时抛出corrupt tape
+		uint64_t word(size_t index) const {
+			if (index >= _tape->_count) corrupt();
+			return _tape->_words[index];
+		}
+		uint8_t tag() const { return static_cast<uint8_t>(word(_index) >> 56); }
+		uint64_t payload() const { return word(_index) & 0x00FFFFFFFFFFFFFFull; }
+		size_t containerEnd() const;// 容器的跳转偏移，校验其不早于首个元素且不越界
+		size_t next() const;        // 下一个兄弟值的下标
+		[[noreturn]] static void corrupt();
+		size_t find(std::string_view key) const;
+
+	private:
+		const JsonTape *_tape;
+		size_t _index;
+
+		friend class JsonTape;
+		friend class iterator;
+	};
+
+	// 遍历数组元素或对象成员，对象成员可通过key()取得键
+	class JsonTapeRef::iterator final {
+	public:
+		JsonTapeRef operator*() const;
+		std::string_view key() const;// 仅对象成员
+		iterator &operator++();
+		bool operator==(const iterator &rhs) const noexcept { return _index == rhs._index; }
+		bool operator!=(const iterator &rhs) const noexcept { return _index != rhs._index; }
+
+	private:
+		iterator(const JsonTape *tape, size_t index, bool object) noexcept : _tape(tape), _index(index), _object(object) {}
+
+	private:
+		const JsonTape *_tape;
+		size_t _index;// 数组为元素下标，对象为键的下标
+		bool _object;
+
+		friend class JsonTapeRef;
+	};
+}// namespace DianaJSON
+
+#endif
@@ -1,6 +1,20 @@
 #include "jsonvalue.h"
 
+#include <cstring>
+#include <functional>
+
 namespace DianaJSON {
+	namespace {
+		// splitmix64的终结函数
+		uint64_t mix(uint64_t h) noexcept {
+			h ^= h >> 30;
+			h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27;
+			h *= 0x94D049BB133111EBull;
+			return h ^ (h >> 31);
+		}
+	}// namespace
+
 	JsonValueType JsonValue::getType() const noexcept {
 		if (std::holds_alternative<std::nullptr_t>(_val))
 			return JsonValueType::Null;
@@ -64,6 +78,57 @@ namespace DianaJSON {
 		}
 	}
 
+	Json::_array &JsonValue::asArray() {
+		disableHashCache();
+		return const_cast<Json::_array &>(toArray());
+	}
+
+	Json::_object &JsonValue::asObject() {
+		disableHashCache();
+		return const_cast<Json::_object &>(toObject());
+	}
+
+	uint64_t JsonValue::hash() const noexcept {
+		uint64_t h = _hash.load(std::memory_order_relaxed);
+		if (h != 0 && h != uncached) {
+			return h;
+		}
+		switch (_val.index()) {
+			case 0:// null
+				return mix(1);
+			case 1:// bool
+				return mix(2 + std::get<bool>(_val));
+			case 2: {
+				double n = std::get<double>(_val);
+				uint64_t bits;
+				n = n == 0 ? 0.0 : n;// -0 == 0
+				memcpy(&bits, &n, sizeof(bits));
+				return mix(bits ^ 3);
+			}
+			case 3:
+				return mix(std::hash<std::string>{}(std::get<std::string>(_val)) ^ 4);
+			case 4: {
+				h = 5;// 与顺序相关
+				for (auto &e : std::get<Json::_array>(_val)) {
+					h = mix(h + e.hash());
+				}
+				break;
+			}
+			default: {
+				h = 0;// 与成员顺序无关
+				for (auto &p : std::get<Json::_object>(_val)) {
+					h += mix(std::hash<std::string>{}(p.first) + mix(p.second.hash()));
+				}
+				h = mix(h ^ 6);
+				break;
+			}
+		}
+		h = h == 0 || h == uncached ? 1 : h;
+		uint64_t expected = 0;// 已禁用缓存的节点保持禁用
+		_hash.compare_exchange_strong(expected, h, std::memory_order_relaxed);
+		return h;
+	}
+
 	size_t JsonValue::size() const {
 		if (std::holds_alternative<Json::_array>(_val))
 			return std::get<Json::_array>(_val).size();
@@ -83,6 +148,7 @@ namespace DianaJSON {
 	}
 
 	Json &JsonValue::operator[](size_t index) {
+		disableHashCache();
 		return const_cast<Json &>(static_cast<const JsonValue &>(*this)[index]);
 	}
 
@@ -95,6 +161,7 @@ namespace DianaJSON {
 	}
 
 	Json &JsonValue::operator[](const std::string &key) {
+		disableHashCache();
 		return const_cast<Json &>(static_cast<const JsonValue &>(*this)[key]);
 	}
 
@@ -1,6 +1,8 @@
 #ifndef JSONVALUE_H
 #define JSONVALUE_H
 
+#include <atomic>
+#include <cstdint>
 #include <variant>
 
 #include "json.h"
@@ -28,6 +30,20 @@ namespace DianaJSON {
 		// 析构函数
 		~JsonValue() = default;
 
+#ifdef DIANA_JSON_COUNT_ALLOCATIONS
+	public:
+		// 节点本身的分配计入JsonAllocationCounter
+		static void *operator new(size_t size) {
+			void *p = ::operator new(size);
+			JsonAllocationHook::record(static_cast<int64_t>(size));
+			return p;
+		}
+		static void operator delete(void *p, size_t size) noexcept {
+			JsonAllocationHook::record(-static_cast<int64_t>(size));
+			::operator delete(p);
+		}
+#endif
+
 	public:
 		// Array与Object类的访问接口
 		size_t size() const;// 返回数组或对象成员数
@@ -53,10 +69,34 @@ namespace DianaJSON {
 		const Json::_array &toArray() const;
 		const Json::_object &toObject() const;
 
+	public:
+		// 可修改的数组与对象接口，类型不符时抛出异常
+		Json::_array &asArray();
+		Json::_object &asObject();
+
+	public:
+		// 结构化哈希：数组与对象在首次计算后缓存
+		// 上述可修改的访问接口交出了内部的引用，之后经该引用的修改无法通知本节点，因此节点从此不再缓存哈希
+		// 限制：非const的Json上json["k"]这类常见写法同样会关闭缓存，即缓存在首次可修改访问后失效而不是在修改时失效；
+		// 没有父指针，也无法拦截经引用的修改（如asArray().push_back()），代次计数同样无法安全地恢复缓存。
+		// 需要缓存时经const引用（std::as_const）访问，或拷贝一份（副本重新缓存）
+		// 代价：_hash使每个节点（包括标量）增加8字节
+		uint64_t hash() const noexcept;
+		uint64_t cachedHash() const noexcept {// 0表示未缓存
+			uint64_t h = _hash.load(std::memory_order_relaxed);
+			return h == uncached ? 0 : h;
+		}
+		void copyHash(const JsonValue &rhs) noexcept { _hash.store(rhs.cachedHash(), std::memory_order_relaxed); }// 副本的子节点未被引用，可以缓存
+
+	private:
+		static constexpr uint64_t uncached = ~static_cast<uint64_t>(0);
+		void disableHashCache() noexcept { _hash.store(uncached, std::memory_order_relaxed); }
+
 	private:
 		std::variant<std::nullptr_t, bool, double, std::string, Json::_array,
 					 Json::_object>
 				_val;// 使用variant储存多元类型，节省空间
+		mutable std::atomic<uint64_t> _hash{0};
 	};
 }// namespace DianaJSON
 
@@ -1,16 +1,81 @@
 #include "parse.h"
+#include "jsonsimd.h"
 
 #include <cassert>
+#include <cerrno>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#ifdef DIANA_JSON_PARSE_STATS
+#include <chrono>
+#endif
 
 namespace DianaJSON {
+#ifdef DIANA_JSON_PARSE_STATS
+	namespace {
+		// 离开parse()时（包括抛出异常）记录消耗的字节数与耗时
+		class StatsScope {
+		public:
+			StatsScope(JsonParseStats &stats, const char *const &curr) noexcept : _stats(stats), _curr(curr), _begin(curr),
+																				   _start(std::chrono::steady_clock::now()) {
+				_stats = JsonParseStats();
+			}
+			~StatsScope() {
+				_stats.bytes = static_cast<size_t>(_curr - _begin);
+				_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+			}
+
+		private:
+			JsonParseStats &_stats;
+			const char *const &_curr;
+			const char *_begin;
+			std::chrono::steady_clock::time_point _start;
+		};
+	}// namespace
+
+	void Parser::countValue(JsonValueType type) noexcept {
+		++_stats.values[static_cast<size_t>(type)];
+	}
+	void Parser::countString(size_t bytes) noexcept {
+		_stats.stringBytes += bytes;
+	}
+	void Parser::countKey() noexcept {
+		++_stats.keys;
+	}
+	void Parser::countEscape(bool unicode) noexcept {
+		++_stats.escapes;
+		if (unicode) ++_stats.unicodeEscapes;
+	}
+	void Parser::enterContainer() noexcept {
+		if (++_depth > _stats.maxDepth) _stats.maxDepth = _depth;
+	}
+	void Parser::leaveContainer(JsonValueType type, size_t size) noexcept {
+		--_depth;
+		if (size > _stats.largestContainer) _stats.largestContainer = size;
+		countValue(type);
+	}
+#else
+	void Parser::countValue(JsonValueType) noexcept {}
+	void Parser::countString(size_t) noexcept {}
+	void Parser::countKey() noexcept {}
+	void Parser::countEscape(bool) noexcept {}
+	void Parser::enterContainer() noexcept {}
+	void Parser::leaveContainer(JsonValueType, size_t) noexcept {}
+#endif
 
 	// 跳过所有白空格
+	// 紧凑文本只比较一次；缩进多为换行后接若干空格，只需比较空格；其余情况按块跳过
 	void Parser::parseWhitespace() noexcept {
-		while (*_curr == ' ' || *_curr == '\t' || *_curr == '\r' || *_curr == '\n') {
-			++_curr;
+		if (static_cast<unsigned char>(*_curr) <= ' ') {// 白空格都不大于' '
+			if (*_curr == ' ' && static_cast<unsigned char>(_curr[1]) > ' ') {// ", "与": "
+				++_curr;
+			} else {
+				if (*_curr == '\r' && _curr[1] == '\n') ++_curr;
+				if (*_curr == '\n') _curr = simd::skipSpaces(_curr + 1);
+				if (*_curr == ' ' || *_curr == '\t' || *_curr == '\r' || *_curr == '\n') {
+					_curr = simd::skipWhitespace(_curr);
+				}
+			}
 		}
 		_start = _curr;
 	}
@@ -55,19 +120,24 @@ namespace DianaJSON {
 	std::string Parser::parseRawString() {
 		std::string str;
 		while (true) {
+			// 整段追加不需要转义的字节，同时校验UTF-8
+			const char *run = _curr + 1, *end = simd::scanString(run);
+			if (end == nullptr) {
+				error("INVALID UTF8");
+			}
+			str.append(run, end);
+			_curr = end - 1;
 			switch (*++_curr) {
 				case '\"':// 到达字符串末尾
 					_start = ++_curr;
+					countString(str.size());
 					return str;
 				case '\0':
 					error("MISS QUOTATION MARK");
-				default:
-					if (static_cast<unsigned char>(*_curr) < 0x20) {
-						error("INVALID STRING CHAR");
-					}
-					str.push_back(*_curr);
-					break;
+				default:// scanString只停在控制字符上
+					error("INVALID STRING CHAR");
 				case '\\':// 转义字符
+					countEscape(_curr[1] == 'u');
 					switch (*++_curr) {
 						case '\"':
 							str.push_back('\"');
@@ -102,6 +172,7 @@ namespace DianaJSON {
 								if (*++_curr != 'u') {
 									error("INVALID UNICODE SURROGATE");
 								}
+								countEscape(true);
 								unsigned u2 = parse4hex();// 低代理区
 								if (u2 < 0xdc00 || u2 > 0xdfff) {
 									error("INVALID UNICODE SURROGATE");
@@ -151,15 +222,20 @@ namespace DianaJSON {
 		_start = _curr;
 		switch (literal[0]) {
 			case 't':
+				countValue(JsonValueType::Bool);
 				return Json(true);
 			case 'f':
+				countValue(JsonValueType::Bool);
 				return Json(false);
 			default:
+				countValue(JsonValueType::Null);
 				return Json(nullptr);
 		}
 	}
 
-	Json Parser::parseNumber() {
+	// 校验数字语法并将_curr移到数字末尾，返回是否为整数（不含小数与指数部分）
+	bool Parser::scanNumber() {
+		bool integer = true;
 		if (*_curr == '-') ++_curr;// 负数
 		if (*_curr == '0')         // 前导零
 			++_curr;
@@ -171,6 +247,7 @@ namespace DianaJSON {
 				;// 通过所有合法数字
 		}
 		if (*_curr == '.') {
+			integer = false;
 			// 小数点后必须是数字
 			if (!is0to9(*++_curr)) {
 				error("INVALID VALUE");
@@ -179,6 +256,7 @@ namespace DianaJSON {
 				;
 		}
 		if (toupper(*_curr) == 'E') {
+			integer = false;
 			++_curr;
 			if (*_curr == '-' || *_curr == '+') ++_curr;
 			if (!is0to9(*_curr)) {
@@ -187,25 +265,41 @@ namespace DianaJSON {
 			while (is0to9(*++_curr))
 				;
 		}
+		return integer;
+	}
+
+	double Parser::parseRawNumber() {
+		scanNumber();
 		// 经过以上步骤后便可确认该数字合法
 		double val = strtod(_start, nullptr);
 		if (fabs(val) == HUGE_VAL) {
 			error("NUMBER TOO BIG");
 		}
 		_start = _curr;
+		return val;
+	}
+
+	// 解析成功之后才计数，出错时统计不含出错的值
+	Json Parser::parseNumber() {
+		double val = parseRawNumber();
+		countValue(JsonValueType::Number);
 		return Json(val);
 	}
 
 	Json Parser::parseString() {
-		return Json(parseRawString());
+		std::string str = parseRawString();
+		countValue(JsonValueType::String);
+		return Json(std::move(str));
 	}
 
 	Json Parser::parseArray() {
 		Json::_array arr;
 		++_curr;// 跳过'['
+		enterContainer();
 		parseWhitespace();
 		if (*_curr == ']') {
 			_start = ++_curr;
+			leaveContainer(JsonValueType::Array, 0);
 			return Json(arr);
 		}
 		while (true) {
@@ -216,6 +310,7 @@ namespace DianaJSON {
 				_curr++;
 			else if (*_curr == ']') {
 				_start = ++_curr;
+				leaveContainer(JsonValueType::Array, arr.size());
 				return Json(arr);
 			} else {
 				error("MISS COMMA OR SQUARE BRACKET");
@@ -226,9 +321,11 @@ namespace DianaJSON {
 	Json Parser::parseObject() {
 		Json::_object obj;
 		++_curr;// 跳过'{'
+		enterContainer();
 		parseWhitespace();
 		if (*_curr == '}') {
 			_start = ++_curr;
+			leaveContainer(JsonValueType::Object, 0);
 			return Json(obj);
 		}
 		while (true) {
@@ -237,6 +334,7 @@ namespace DianaJSON {
 				error("MISS KEY");
 			}
 			std::string key = parseRawString();
+			countKey();
 			parseWhitespace();
 			if (*_curr++ != ':') {
 				error("MISS COLON");
@@ -249,6 +347,7 @@ namespace DianaJSON {
 				_curr++;
 			else if (*_curr == '}') {
 				_start = ++_curr;
+				leaveContainer(JsonValueType::Object, obj.size());
 				return Json(obj);
 			} else {
 				error("MISS COMMA OR CURLY BRACKET");
@@ -257,6 +356,10 @@ namespace DianaJSON {
 	}
 
 	Json Parser::parse() {
+#ifdef DIANA_JSON_PARSE_STATS
+		StatsScope scope(_stats, _curr);
+		_depth = 0;
+#endif
 		// Json-text = ws value ws
 		parseWhitespace();
 		Json json = parseValue();
@@ -267,6 +370,368 @@ namespace DianaJSON {
 		}
 		return json;
 	}
+	Json Parser::parse(const Projection &projection) {
+#ifdef DIANA_JSON_PARSE_STATS
+		StatsScope scope(_stats, _curr);
+		_depth = 0;
+#endif
+		parseWhitespace();
+		Json json = parseProjected(projection);
+		parseWhitespace();
+		if (*_curr) {
+			error("ROOT NOT SINGULAR");
+		}
+		return json;
+	}
+
+	Json Parser::parseProjected(const Projection &projection) {
+		if (projection.keepAll) {
+			return parseValue();
+		}
+		switch (*_curr) {
+			case '[':
+				return parseArrayProjected(projection);
+			case '{':
+				return parseObjectProjected(projection);
+			default:
+				// 标量无法包含更深的路径
+				skipValue();
+				return Json(nullptr);
+		}
+	}
+
+	Json Parser::parseArrayProjected(const Projection &projection) {
+		Json::_array arr;
+		++_curr;// 跳过'['
+		enterContainer();
+		parseWhitespace();
+		if (*_curr == ']') {
+			_start = ++_curr;
+			leaveContainer(JsonValueType::Array, 0);
+			return Json(std::move(arr));
+		}
+		while (true) {
+			parseWhitespace();
+			if (*_curr == '[' || *_curr == '{') {
+				arr.push_back(parseProjected(projection));
+			} else {
+				skipValue();
+			}
+			parseWhitespace();
+			if (*_curr == ',')
+				_curr++;
+			else if (*_curr == ']') {
+				_start = ++_curr;
+				leaveContainer(JsonValueType::Array, arr.size());
+				return Json(std::move(arr));
+			} else {
+				error("MISS COMMA OR SQUARE BRACKET");
+			}
+		}
+	}
+
+	Json Parser::parseObjectProjected(const Projection &projection) {
+		Json::_object obj;
+		++_curr;// 跳过'{'
+		enterContainer();
+		parseWhitespace();
+		if (*_curr == '}') {
+			_start = ++_curr;
+			leaveContainer(JsonValueType::Object, 0);
+			return Json(std::move(obj));
+		}
+		while (true) {
+			parseWhitespace();
+			if (*_curr != '"') {
+				error("MISS KEY");
+			}
+			std::string key = parseRawString();
+			countKey();
+			parseWhitespace();
+			if (*_curr++ != ':') {
+				error("MISS COLON");
+			}
+			parseWhitespace();
+			const Projection *child = projection.find(key);
+			if (child && (child->keepAll || *_curr == '[' || *_curr == '{')) {
+				obj.emplace(std::move(key), parseProjected(*child));
+			} else {
+				skipValue();
+			}
+			parseWhitespace();
+			if (*_curr == ',')
+				_curr++;
+			else if (*_curr == '}') {
+				_start = ++_curr;
+				leaveContainer(JsonValueType::Object, obj.size());
+				return Json(std::move(obj));
+			} else {
+				error("MISS COMMA OR CURLY BRACKET");
+			}
+		}
+	}
+
+	// 跳过字符串，校验UTF-8、控制字符与转义，不解码
+	void Parser::skipString() {
+		while (true) {
+			const char *end = simd::scanString(_curr + 1);
+			if (end == nullptr) {
+				error("INVALID UTF8");
+			}
+			_curr = end;
+			switch (*_curr) {
+				case '\"':
+					++_curr;
+					return;
+				case '\0':
+					error("MISS QUOTATION MARK");
+				default:// scanString只停在控制字符上
+					error("INVALID STRING CHAR");
+				case '\\':
+					switch (*++_curr) {
+						case '\"':
+						case '\\':
+						case '/':
+						case 'b':
+						case 'f':
+						case 'n':
+						case 't':
+						case 'r':
+							break;
+						case 'u': {
+							unsigned u = parse4hex();
+							if (u >= 0xd800 && u <= 0xdbff) {// 高代理区后必须紧跟低代理区
+								if (*++_curr != '\\' || *++_curr != 'u') {
+									error("INVALID UNICODE SURROGATE");
+								}
+								u = parse4hex();
+								if (u < 0xdc00 || u > 0xdfff) {
+									error("INVALID UNICODE SURROGATE");
+								}
+							}
+						} break;
+						default:
+							error("INVALID STRING ESCAPE");
+					}
+					break;
+			}
+		}
+	}
+
+	// 跳过对象成员的键与冒号
+	void Parser::skipKey() {
+		if (*_curr != '"') {
+			error("MISS KEY");
+		}
+		skipString();
+		parseWhitespace();
+		if (*_curr++ != ':') {
+			error("MISS COLON");
+		}
+		parseWhitespace();
+	}
+
+	// 跳过一个值：按语法校验但不构建节点，不解码字符串与数字
+	// 未闭合的括号记在栈中，嵌套不超过15层时不分配内存
+	void Parser::skipValue() {
+		std::string brackets;
+		while (true) {
+			// 此处应为一个值
+			switch (*_curr) {
+				case '\"':
+					skipString();
+					break;
+				case '[':
+				case '{':
+					brackets.push_back(*_curr == '[' ? ']' : '}');
+					++_curr;
+					parseWhitespace();
+					if (*_curr == brackets.back()) {// 空数组或空对象
+						++_curr;
+						brackets.pop_back();
+						break;
+					}
+					if (brackets.back() == '}') skipKey();
+					continue;
+				case 'n':
+					skipLiteral("null");
+					break;
+				case 't':
+					skipLiteral("true");
+					break;
+				case 'f':
+					skipLiteral("false");
+					break;
+				case '\0':
+					error("EXPECT VALUE");
+				default:
+					scanNumber();// 不是数字（包括空值）时报错
+					break;
+			}
+			// 值之后为逗号或所在容器的右括号
+			while (true) {
+				if (brackets.empty()) {
+					_start = _curr;
+					return;
+				}
+				parseWhitespace();
+				if (*_curr == brackets.back()) {
+					++_curr;
+					brackets.pop_back();
+				} else if (*_curr == ',') {
+					++_curr;
+					parseWhitespace();
+					if (brackets.back() == '}') skipKey();
+					break;
+				} else {
+					error(brackets.back() == ']' ? "MISS COMMA OR SQUARE BRACKET" : "MISS COMMA OR CURLY BRACKET");
+				}
+			}
+		}
+	}
+
+	void Parser::skipLiteral(const char *literal) {
+		size_t n = strlen(literal);
+		if (strncmp(_curr, literal, n) != 0) {
+			error("INVALID VALUE");
+		}
+		_curr += n;
+	}
+
+	char Parser::peek() noexcept {
+		parseWhitespace();
+		return *_curr;
+	}
+
+	bool Parser::consume(char ch) noexcept {
+		parseWhitespace();
+		if (*_curr != ch) return false;
+		_start = ++_curr;
+		return true;
+	}
+
+	void Parser::expect(char ch, const std::string &msg) {
+		if (!consume(ch)) {
+			error(msg);
+		}
+	}
+
+	std::string Parser::readString() {
+		if (peek() != '"') {
+			error("EXPECT STRING");
+		}
+		return parseRawString();
+	}
+
+	double Parser::readNumber() {
+		char ch = peek();
+		if (ch != '-' && !is0to9(ch)) {
+			error("EXPECT NUMBER");
+		}
+		return parseRawNumber();
+	}
+
+	long long Parser::readInteger() {
+		char ch = peek();
+		if (ch != '-' && !is0to9(ch)) {
+			error("EXPECT NUMBER");
+		}
+		if (!scanNumber()) {
+			error("EXPECT INTEGER");
+		}
+		errno = 0;
+		long long val = strtoll(_start, nullptr, 10);
+		if (errno == ERANGE) {
+			error("NUMBER TOO BIG");
+		}
+		_start = _curr;
+		return val;
+	}
+
+	unsigned long long Parser::readUnsigned() {
+		char ch = peek();
+		if (ch == '-') {
+			error("NUMBER OUT OF RANGE");
+		}
+		if (!is0to9(ch)) {
+			error("EXPECT NUMBER");
+		}
+		if (!scanNumber()) {
+			error("EXPECT INTEGER");
+		}
+		errno = 0;
+		unsigned long long val = strtoull(_start, nullptr, 10);
+		if (errno == ERANGE) {
+			error("NUMBER TOO BIG");
+		}
+		_start = _curr;
+		return val;
+	}
+
+	bool Parser::readBool() {
+		switch (peek()) {
+			case 't':
+				return parseLiteral("true").toBool();
+			case 'f':
+				return parseLiteral("false").toBool();
+			default:
+				error("EXPECT BOOL");
+		}
+	}
+
+	void Parser::readNull() {
+		if (peek() != 'n') {
+			error("EXPECT NULL");
+		}
+		parseLiteral("null");
+	}
+
+	Json Parser::readValue() {
+		parseWhitespace();
+		return parseValue();
+	}
+
+	void Parser::skip() {
+		parseWhitespace();
+		skipValue();
+	}
+
+	void Parser::finish() {
+		parseWhitespace();
+		if (*_curr) {
+			error("ROOT NOT SINGULAR");
+		}
+	}
+
+	void Projection::add(const std::string &path) {
+		Projection *node = this;
+		size_t begin = 0;
+		while (!node->keepAll) {
+			size_t end = path.find('.', begin);
+			std::string key = path.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+			Projection *child = const_cast<Projection *>(node->find(key));
+			if (!child) {
+				node->children.emplace_back(std::move(key), Projection());
+				child = &node->children.back().second;
+			}
+			node = child;
+			if (end == std::string::npos) {
+				// 路径末端保留整个子树
+				node->keepAll = true;
+				node->children.clear();
+				break;
+			}
+			begin = end + 1;
+		}
+	}
+
+	const Projection *Projection::find(const std::string &key) const noexcept {
+		for (auto &child : children) {
+			if (child.first == key) return &child.second;
+		}
+		return nullptr;
+	}
+
 	void Parser::error(const std::string &msg) const {
 		throw JsonException(msg + ": " + _start);
 	}
@@ -1,6 +1,9 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include <utility>
+#include <vector>
+
 #include "json.h"
 #include "jsonerror.h"
 
@@ -8,6 +11,15 @@ namespace DianaJSON {
 	inline constexpr bool is1to9(char ch) { return ch >= '1' && ch <= '9'; }
 	inline constexpr bool is0to9(char ch) { return ch >= '0' && ch <= '9'; }
 
+	// 投影解析的字段白名单树，路径以'.'分隔逐级匹配对象成员名，数组对其元素透明
+	struct Projection {
+		bool keepAll = false;// 叶子节点：保留整个子树
+		std::vector<std::pair<std::string, Projection>> children;
+
+		void add(const std::string &path);
+		const Projection *find(const std::string &key) const noexcept;
+	};
+
 	class Parser {
 	public:
 		// 构造函数
@@ -24,6 +36,30 @@ namespace DianaJSON {
 	public:
 		// 唯一对外开放的解析结果获取接口
 		Json parse();
+		// 投影解析，仅构建白名单路径上的节点，其余子树直接跳过
+		Json parse(const Projection &projection);
+
+	public:
+		// 流式读取接口，直接从文本取值而不构建Json节点（供jsonbind.h类型绑定使用）
+		char peek() noexcept;          // 跳过白空格后返回当前字符
+		bool consume(char ch) noexcept;// 跳过白空格后若当前字符为ch则跳过并返回true
+		void expect(char ch, const std::string& msg);
+		std::string readString();
+		double readNumber();
+		long long readInteger();// 仅接受不含小数与指数部分的数字
+		unsigned long long readUnsigned();// 同上，且不接受负号
+		bool readBool();
+		void readNull();
+		Json readValue();
+		void skip();  // 跳过一个值
+		void finish();// 根节点之后只允许白空格
+		[[noreturn]] void fail(const std::string& msg) const { error(msg); }
+
+#ifdef DIANA_JSON_PARSE_STATS
+	public:
+		// 最近一次parse()的统计，出错时统计到出错的位置为止
+		const JsonParseStats& stats() const noexcept { return _stats; }
+#endif
 
 	private:
 		// 内部解析方法
@@ -33,17 +69,39 @@ namespace DianaJSON {
 		Json parseObject();
 		Json parseString();
 		Json parseNumber();
+		Json parseProjected(const Projection &projection);
+		Json parseArrayProjected(const Projection &projection);
+		Json parseObjectProjected(const Projection &projection);
 
 	private:
 		void parseWhitespace() noexcept;
 		std::string parseRawString();
 		unsigned parse4hex();
 		std::string encodeUTF8(unsigned u) noexcept;
-		void error(const std::string& msg) const;
+		void skipValue();
+		void skipString();
+		void skipKey();
+		void skipLiteral(const char* literal);
+		bool scanNumber();
+		double parseRawNumber();
+		[[noreturn]] void error(const std::string& msg) const;
+
+	private:
+		// 解析统计，未定义DIANA_JSON_PARSE_STATS时为空函数
+		void countValue(JsonValueType type) noexcept;
+		void countString(size_t bytes) noexcept;
+		void countKey() noexcept;
+		void countEscape(bool unicode) noexcept;
+		void enterContainer() noexcept;
+		void leaveContainer(JsonValueType type, size_t size) noexcept;
 
 	private:
 		const char* _start;
 		const char* _curr;
+#ifdef DIANA_JSON_PARSE_STATS
+		JsonParseStats _stats;
+		size_t _depth = 0;
+#endif
 	};
 }// namespace DianaJSON
 
@@ -1,7 +1,94 @@
 // Simple Test
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "json.h"
+#include "jsonbind.h"
+#include "jsonerror.h"
+#include "jsonliteral.h"
+#include "jsonparallel.h"
+#include "jsonpath.h"
+#include "jsontape.h"
+
+namespace {
+	int failures = 0;
+
+	// 行为检查：失败时输出表达式，main以失败数决定返回值
+	void check(bool ok, const char *what) {
+		if (!ok) {
+			std::cout << "FAILED: " << what << std::endl;
+			++failures;
+		}
+	}
+
+	// 类型绑定用的结构体
+	struct Item {
+		std::string sku;
+		unsigned long long count = 0;
+		std::optional<double> price;
+	};
+
+	struct Order {
+		int id = 0;
+		std::string note;
+		bool paid = false;
+		std::vector<Item> items;
+		std::optional<Item> gift;
+		std::vector<int> tags;
+		int8_t priority = 0;
+		uint16_t weight = 0;
+	};
+
+	struct Note {
+		std::string text;
+	};
+
+	// JSONPath查询结果与期望的JSON数组比较，ordered为false时忽略顺序（对象成员的遍历顺序不确定）
+	bool queries(const DianaJSON::Json &root, const char *expr, const char *expected, bool ordered = true) {
+		std::string errorText;
+		std::vector<std::string> actual, wanted;
+		for (const DianaJSON::Json *item : DianaJSON::JsonPath(expr).query(root)) actual.push_back(item->serialize());
+		DianaJSON::Json expectedJson = DianaJSON::Json::parse(expected, errorText);
+		for (auto &item : expectedJson.toArray()) wanted.push_back(item.serialize());
+		if (!ordered) {
+			std::sort(actual.begin(), actual.end());
+			std::sort(wanted.begin(), wanted.end());
+		}
+		return actual == wanted;
+	}
+
+	// 表达式非法时编译抛出JsonException
+	bool rejects(const char *expr) {
+		try {
+			DianaJSON::JsonPath path(expr);
+		} catch (DianaJSON::JsonException &) {
+			return true;
+		}
+		return false;
+	}
+
+	bool operator==(const Item &a, const Item &b) {
+		return a.sku == b.sku && a.count == b.count && a.price == b.price;
+	}
+
+	bool operator==(const Order &a, const Order &b) {
+		return a.id == b.id && a.note == b.note && a.paid == b.paid && a.items == b.items && a.gift == b.gift &&
+			   a.tags == b.tags && a.priority == b.priority && a.weight == b.weight;
+	}
+}// namespace
+
+DIANA_JSON_BIND(Item, DIANA_JSON_FIELD(sku), DIANA_JSON_FIELD(count), DIANA_JSON_FIELD(price))
+DIANA_JSON_BIND(Note, DIANA_JSON_FIELD_NAMED(text, "t\"\\\n\x01"))
+DIANA_JSON_BIND(Order, DIANA_JSON_FIELD(id), DIANA_JSON_FIELD(note), DIANA_JSON_FIELD(paid), DIANA_JSON_FIELD(items),
+				DIANA_JSON_FIELD(gift), DIANA_JSON_FIELD(tags), DIANA_JSON_FIELD(priority), DIANA_JSON_FIELD_NAMED(weight, "w"))
+
+#define CHECK(expr) check((expr), #expr)
 
 int main() {
 	using namespace DianaJSON;
@@ -76,5 +163,557 @@ int main() {
 		}
 	}
 
-	return 0;
+	// JSONPath查询：切片、递归下降、过滤器、带引号的名称与非法表达式
+	{
+		CHECK(queries(json, "$.o.o2[?(@ == true || @ == 2)]", "[2, true]"));
+		Json store = Json::parse(R"({"store": {"book": [{"t": "a", "p": 8.95, "c": "ref"}, {"t": "b", "p": 12.99, "c": "fic"},
+			{"t": "c", "p": 8.99, "c": "fic", "isbn": "x"}, {"t": "d", "p": 22.99, "c": "fic", "isbn": "y"}],
+			"bike": {"color": "red", "p": 19.95}}, "a.b": 1, "it's": 2, "nums": [0, 1, 2, 3, 4, 5, 6, 7, 8, 9]})",
+								 errorText);
+		CHECK(queries(store, "$.nums[1:4]", "[1, 2, 3]"));
+		CHECK(queries(store, "$.nums[-2:]", "[8, 9]"));
+		CHECK(queries(store, "$.nums[::3]", "[0, 3, 6, 9]"));
+		CHECK(queries(store, "$.nums[::-1]", "[9, 8, 7, 6, 5, 4, 3, 2, 1, 0]"));
+		CHECK(queries(store, "$.nums[7:2:-2]", "[7, 5, 3]"));
+		CHECK(queries(store, "$.nums[-1:-4:-1]", "[9, 8, 7]"));
+		CHECK(queries(store, "$.nums[0, -1, 3]", "[0, 9, 3]"));
+		CHECK(queries(store, "$.nums[20:]", "[]"));
+		CHECK(queries(store, "$..p", "[8.95, 12.99, 8.99, 22.99, 19.95]", false));
+		CHECK(queries(store, "$..isbn", "[\"x\", \"y\"]"));
+		CHECK(queries(store, "$.store..color", "[\"red\"]"));
+		CHECK(queries(store, "$.store.book[*].t", "[\"a\", \"b\", \"c\", \"d\"]"));
+		CHECK(queries(store, "$.store.book[?(@.p < 10 && @.c == 'fic')].t", "[\"c\"]"));
+		CHECK(queries(store, "$.store.book[?(@.p > 20 || @.c == 'ref')].t", "[\"a\", \"d\"]"));
+		CHECK(queries(store, "$.store.book[?(!(@.p >= 10) || (@.c != 'fic' && @.p <= 9))].t", "[\"a\", \"c\"]"));
+		CHECK(queries(store, "$.store.book[?(@.p == $.store.bike.p || @.isbn == 'y')].t", "[\"d\"]"));
+		CHECK(queries(store, "$['a.b']", "[1]"));
+		CHECK(queries(store, "$[\"it's\"]", "[2]"));
+		CHECK(queries(store, "$['store']['bike'].color", "[\"red\"]"));
+		CHECK(queries(store, "$.missing.x", "[]"));
+		CHECK(JsonPath("$.store.book[1].t").first(store)->toString() == "b");
+
+		const char *invalid[] = {"", "store", "$.", "$[", "$['a", "$.nums[1:2:0]", "$[?(@.p <)]", "$[?(@.p == 1]", "$.nums[x]"};
+		for (const char *expr : invalid) {
+			check(rejects(expr), expr);
+		}
+
+		// 元素数超过parallelThreshold时过滤器并行求值，结果顺序不变
+		Json::_array big;
+		for (size_t i = 0; i != JsonPath::parallelThreshold * 2 + 3; ++i) {
+			big.emplace_back(Json::_object{{"i", Json(static_cast<double>(i))}});
+		}
+		Json items(std::move(big));
+		auto found = JsonPath("$[?(@.i >= 4095 && @.i < 4098 || @.i == 8194)].i").query(items);
+		CHECK(found.size() == 4 && found[0]->toDouble() == 4095 && found[2]->toDouble() == 4097 && found[3]->toDouble() == 8194);
+		auto all = JsonPath("$[?(@.i >= 0)]").query(items);
+		bool ordered = all.size() == items.size();
+		for (size_t i = 0; ordered && i != all.size(); ++i) ordered = all[i] == &items[i];
+		CHECK(ordered);
+	}
+
+	// 结构化哈希：计算哈希之后经保留的子节点引用修改，祖先不得沿用旧的哈希
+	{
+		Json a = Json::parse("[[1]]", errorText), b = Json::parse("[[1]]", errorText);
+		Json &child = a[0];
+		a.hash();
+		b.hash();
+		child[0] = Json(2.0);
+		b[0][0] = Json(2.0);
+		b.hash();
+		CHECK(a == b);
+		CHECK(a.hash() == b.hash());
+		CHECK(std::hash<Json>{}(a) == std::hash<Json>{}(b));
+
+		Json c = Json::parse("{\"k\":[1,2]}", errorText);
+		c.hash();
+		Json &k = c["k"];// 先计算哈希再取引用
+		k[1] = Json(3.0);
+		CHECK(c == Json::parse("{\"k\":[1,3]}", errorText));
+		CHECK(c.hash() == Json::parse("{\"k\":[1,3]}", errorText).hash());
+
+		Json d = c;// 副本可以重新缓存
+		d.hash();
+		CHECK(d.cachedHash() != 0 && d.hash() == c.hash());
+		const Json parsed = Json::parse("[[1],{\"a\":null}]", errorText);
+		parsed.hash();
+		CHECK(parsed.cachedHash() != 0);
+	}
+
+	// CBOR与MessagePack：往返不变，嵌套过深或截断时报错而不崩溃
+	{
+		Json doc = Json::parse("{\"i\":-42, \"f\":1.5, \"d\":0.1, \"s\":\"\u4e2d\u6587\", \"a\":[null, true, false, [], {}], \"o\":{\"k\":[1, 2.5]}}", errorText);
+		std::string err;
+		CHECK(Json::parseCBOR(doc.serializeCBOR(), err) == doc && err.empty());
+		CHECK(Json::parseMessagePack(doc.serializeMessagePack(), err) == doc && err.empty());
+
+		Json deep = Json::parseMessagePack(std::string(500000, '\x91') + '\xC0', err);
+		CHECK(deep.isNull() && err == "DEPTH EXCEEDED");
+		err.clear();
+		Json::parseCBOR(std::string(500000, '\x81') + '\xF6', err);
+		CHECK(err == "DEPTH EXCEEDED");
+		err.clear();
+		Json tagged = Json::parseCBOR(std::string(250000, '\xC1') + '\x01', err);// 连续的标签
+		CHECK(err.empty() && tagged.toDouble() == 1);
+		err.clear();
+		std::string cbor = doc.serializeCBOR();
+		Json::parseCBOR(cbor.substr(0, cbor.size() - 1), err);
+		CHECK(!err.empty());
+	}
+
+	// JSON Patch：成功时按序应用；任一操作失败时整体回滚，文档保持原样
+	{
+		Json doc = Json::parse("{\"a\":[1,2],\"b\":{\"c\":\"x\"}}", errorText);
+		const Json original = doc;
+		std::string err;
+		Json ok = Json::parse("[{\"op\":\"add\",\"path\":\"/a/-\",\"value\":3},{\"op\":\"move\",\"from\":\"/b/c\",\"path\":\"/d\"},{\"op\":\"test\",\"path\":\"/d\",\"value\":\"x\"}]", errorText);
+		CHECK(doc.applyPatch(ok, err) && err.empty());
+		CHECK(doc == Json::parse("{\"a\":[1,2,3],\"b\":{},\"d\":\"x\"}", errorText));
+
+		doc = original;
+		Json bad = Json::parse("[{\"op\":\"remove\",\"path\":\"/a/0\"},{\"op\":\"replace\",\"path\":\"/b/c\",\"value\":null},{\"op\":\"test\",\"path\":\"/a/0\",\"value\":1}]", errorText);
+		CHECK(!doc.applyPatch(bad, err) && !err.empty());
+		CHECK(doc == original);
+		err.clear();
+		Json missing = Json::parse("[{\"op\":\"add\",\"path\":\"/e\",\"value\":1},{\"op\":\"remove\",\"path\":\"/nope\"}]", errorText);
+		CHECK(!doc.applyPatch(missing, err) && !err.empty());
+		CHECK(doc == original);
+
+		// 移动到根节点后失败，回滚须恢复整个文档
+		Json rooted = Json::parse("{\"a\":{\"x\":1},\"b\":2}", errorText);
+		const Json rootedOriginal = rooted;
+		err.clear();
+		CHECK(!rooted.applyPatch(Json::parse("[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"\"},{\"op\":\"test\",\"path\":\"/x\",\"value\":9}]", errorText), err));
+		CHECK(rooted == rootedOriginal && err.find("ROLLBACK") == std::string::npos);
+		err.clear();
+		CHECK(!rooted.applyPatch(Json::parse("[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/b\"},{\"op\":\"remove\",\"path\":\"/a\"}]", errorText), err));
+		CHECK(rooted == rootedOriginal);
+
+		doc.applyMergePatch(Json::parse("{\"a\":null,\"b\":{\"c\":\"y\",\"n\":1}}", errorText));
+		CHECK(doc == Json::parse("{\"b\":{\"c\":\"y\",\"n\":1}}", errorText));
+	}
+
+	// 结构化差异：diff得到的补丁应用到from上得到to
+	{
+		const char *pairs[][2] = {
+			{"{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":true}}", "{\"a\":2,\"b\":[1,3,4],\"e\":null}"},
+			{"[1,2,3,4,5]", "[0,1,3,5,6]"},
+			{"[{\"k\":1},\"x\"]", "[\"x\",{\"k\":2}]"},
+			{"{\"a\":[]}", "[]"},
+			{"\"a/b~c\"", "{\"a/b\":{\"~\":1}}"},
+		};
+		for (auto &pair : pairs) {
+			Json from = Json::parse(pair[0], errorText), to = Json::parse(pair[1], errorText);
+			std::string err;
+			Json patched = from;
+			CHECK(patched.applyPatch(Json::diff(from, to), err) && patched == to);
+			patched = from;// 超过代价上限时按下标比较，结果同样正确
+			CHECK(patched.applyPatch(Json::diff(from, to, 0), err) && patched == to);
+		}
+		Json same = Json::parse("{\"a\":[1,{\"b\":2}]}", errorText);
+		CHECK(Json::diff(same, same).size() == 0);
+
+		// 经可修改接口构建的文档不缓存哈希：逐层嵌套后只改动最深处的一个值，补丁只含这一处
+		Json deepA(Json::_array{}), deepB;
+		Json *node = &deepA;
+		std::string leafPath;
+		for (int level = 0; level != 200; ++level) {
+			auto &arr = node->asArray();
+			arr.push_back(Json(Json::_object{{"x", Json(level)}, {"y", Json("same")}}));
+			arr.push_back(Json(Json::_array{}));
+			node = &arr.back();
+			leafPath += "/1";
+		}
+		node->asArray().push_back(Json(1));
+		deepB = deepA;
+		Json *leaf = &deepB;
+		for (int level = 0; level != 200; ++level) leaf = &(*leaf)[1];
+		(*leaf)[0] = Json(2);
+		Json ops = Json::diff(deepA, deepB);
+		CHECK(ops.size() == 1 && ops[0]["op"].toString() == "replace" && ops[0]["path"].toString() == leafPath + "/0");
+		Json patched = deepA;
+		std::string err;
+		CHECK(patched.applyPatch(ops, err) && patched == deepB);
+	}
+
+	// 投影解析：只保留白名单路径，数组对路径透明，其余子树跳过但仍须合法
+	{
+		std::string text = "{\"user\":{\"name\":\"a\",\"age\":3,\"tags\":[1,2]},\"items\":[{\"id\":1,\"x\":[{}]},{\"id\":2},5],\"meta\":{\"n\":null}}";
+		std::string err;
+		Json projected = Json::parse(text, {"user.name", "items.id", "meta"}, err);
+		CHECK(err.empty());
+		CHECK(projected == Json::parse("{\"user\":{\"name\":\"a\"},\"items\":[{\"id\":1},{\"id\":2}],\"meta\":{\"n\":null}}", errorText));
+		CHECK(Json::parse(text, {"user"}, err) == Json::parse("{\"user\":{\"name\":\"a\",\"age\":3,\"tags\":[1,2]}}", errorText));
+		CHECK(Json::parse(text, {"none"}, err).size() == 0 && err.empty());
+
+		const char *invalid[] = {
+			"{\"user\":{\"name\":\"a\"},\"skip\":[1,",
+			"{\"a\":,\"user\":{\"name\":\"x\"}}",
+			"{\"s\":[1,},\"user\":{\"name\":\"x\"}}",
+			"{\"s\":[1},\"user\":{\"name\":\"x\"}}",
+			"{\"s\":{\"k\":1],\"user\":{\"name\":\"x\"}}",
+			"{\"s\":tru,\"user\":{\"name\":\"x\"}}",
+			"{\"s\":1.2.3,\"user\":{\"name\":\"x\"}}",
+			"{\"s\":[1 2],\"user\":{\"name\":\"x\"}}",
+			"{\"s\":{\"k\" 1},\"user\":{\"name\":\"x\"}}",
+			"{\"s\":{1:1},\"user\":{\"name\":\"x\"}}",
+			"{\"s\":\"\\x\",\"user\":{\"name\":\"x\"}}",
+			"{\"s\":-,\"user\":{\"name\":\"x\"}}",
+			"{\"user\":{\"name\":\"x\",\"age\":01}}",
+		};
+		for (const char *text : invalid) {// 跳过的子树出错同样报错
+			err.clear();
+			Json broken = Json::parse(text, {"user.name"}, err);
+			check(broken.isNull() && !err.empty(), text);
+		}
+		err.clear();
+		CHECK(Json::parse("{\"s\":[{},[],{\"k\":[null,true,false,-0.5e+3,\"\\u00e9\\\"\"]}],\"user\":{\"name\":\"x\"}}", {"user.name"}, err) ==
+			  Json::parse("{\"user\":{\"name\":\"x\"}}", errorText) && err.empty());
+	}
+
+	// 磁带：保存后重新映射，查询结果与原文档一致；文件损坏时load失败
+	{
+		std::string text = "{\"s\":\"\u4e2d\\n\",\"n\":-1.5,\"a\":[null,true,false,[],{}],\"o\":{\"k\":[1,{\"x\":\"y\"}]}}";
+		std::string err;
+		JsonTape built = JsonTape::parse(text, err);
+		CHECK(err.empty() && built.root().toJson() == Json::parse(text, errorText));
+		CHECK(JsonTape::fromJson(Json::parse(text, errorText)).root().toJson() == built.root().toJson());
+
+		const char *path = "diana_test.tape";
+		CHECK(built.save(path, err));
+		JsonTape loaded = JsonTape::load(path, err);
+		CHECK(err.empty() && loaded.byteSize() == built.byteSize());
+		JsonTapeRef root = loaded.root();
+		CHECK(root.toJson() == Json::parse(text, errorText));
+		CHECK(root["s"].toString() == "\u4e2d\n" && root["n"].toDouble() == -1.5);
+		CHECK(root["a"].size() == 5 && root["a"][1].toBool() && root["a"][3].isArray());
+		CHECK(root["o"]["k"][1]["x"].toString() == "y" && !root.contains("x"));
+
+		auto writeFile = [path](const std::string &data) {
+			std::FILE *file = std::fopen(path, "wb");
+			if (file) {
+				std::fwrite(data.data(), 1, data.size(), file);
+				std::fclose(file);
+			}
+		};
+		writeFile("not a tape");
+		err.clear();
+		CHECK(JsonTape::load(path, err).empty() && !err.empty());
+
+		// 头部合法但内容损坏：任何访问都只能抛出corrupt tape，不得越界读取
+		CHECK(JsonTape::parse("[[]]", err).save(path, err));
+		std::string image;
+		if (std::FILE *file = std::fopen(path, "rb")) {
+			char buffer[256];
+			size_t n;
+			while ((n = std::fread(buffer, 1, sizeof(buffer), file)) != 0) image.append(buffer, n);
+			std::fclose(file);
+		}
+		auto patchWord = [&](size_t index, uint64_t value) {// 头部4个字依次为魔数、字节序标记、字数与字符串区字节数
+			std::string corrupted = image;
+			std::memcpy(&corrupted[index * sizeof(uint64_t)], &value, sizeof(value));
+			writeFile(corrupted);
+		};
+		auto corruptTape = [&]() {
+			JsonTape tape = JsonTape::load(path, err);
+			try {
+				tape.root().toJson();
+			} catch (JsonException &e) {
+				return std::string(e.what()) == "corrupt tape";
+			}
+			return false;
+		};
+		CHECK(image.size() == 8 * sizeof(uint64_t));
+		if (image.size() == 8 * sizeof(uint64_t)) {
+			uint64_t root;
+			std::memcpy(&root, &image[4 * sizeof(uint64_t)], sizeof(root));
+			patchWord(2, 3);// 字数少一，最后一个字为'['
+			CHECK(corruptTape());
+			patchWord(2, 1);// 只剩根节点的'['
+			CHECK(corruptTape());
+			patchWord(4, (root & ~0x00FFFFFFFFFFFFFFull) | 1);// 跳转偏移早于首个元素
+			CHECK(corruptTape());
+			patchWord(4, (root & ~0x00FFFFFFFFFFFFFFull) | 100);// 跳转偏移越界
+			CHECK(corruptTape());
+			patchWord(5, uint64_t(1) << 40);// 元素数远超容器大小
+			CHECK(corruptTape());
+		}
+		std::remove(path);
+	}
+
+	// 类型化解析：嵌套结构体、optional与vector，未绑定的键被跳过，越界与含小数的整数报错
+	{
+		Order order;
+		std::string err;
+		CHECK(typedParse("{\"id\":7,\"extra\":{\"a\":[1,{\"b\":null}]},\"note\":\"n\\u00e9\",\"paid\":true,"
+						 "\"items\":[{\"sku\":\"a\",\"count\":18446744073709551615,\"price\":null},{\"sku\":\"b\",\"price\":2.5,\"x\":1}],"
+						 "\"gift\":{\"sku\":\"g\"},\"tags\":[],\"priority\":-128,\"w\":65535}",
+						 order, err));
+		CHECK(err.empty() && order.id == 7 && order.note == "n\u00e9" && order.paid);
+		CHECK(order.items.size() == 2 && order.items[0].count == 18446744073709551615ull && !order.items[0].price);
+		CHECK(order.items[1].sku == "b" && order.items[1].count == 0 && order.items[1].price == 2.5);
+		CHECK(order.gift && order.gift->sku == "g" && order.tags.empty() && order.priority == -128 && order.weight == 65535);
+
+		const char *invalid[] = {
+			"{\"id\":1.5}",
+			"{\"id\":1e2}",
+			"{\"id\":2147483648}",
+			"{\"priority\":128}",
+			"{\"w\":65536}",
+			"{\"w\":-1}",
+			"{\"items\":[{\"count\":-0}]}",
+			"{\"items\":[{\"count\":18446744073709551616}]}",
+			"{\"tags\":[1,]}",
+			"{\"paid\":1}",
+			"{\"gift\":[]}",
+			"{\"id\":1,\"extra\":[}",
+			"{\"id\":1} x",
+		};
+		for (const char *text : invalid) {
+			Order o;
+			err.clear();
+			check(!typedParse(text, o, err) && !err.empty(), text);
+		}
+		std::vector<int> numbers;
+		CHECK(typedParse("[1, -2, 3]", numbers, err) && numbers == std::vector<int>({1, -2, 3}));
+	}
+
+	// 类型化生成：往返不变，输出与Json::serialize()逐字节相同（含转义、optional与空vector）
+	{
+		Order order;
+		order.id = -3;
+		order.note = "q\"b\\s\n\t\x01\u00e9/";
+		order.items = {{"a", 18446744073709551615ull, std::nullopt}, {"b\"", 0, 0.1}};
+		order.gift = Item{"g", 1, 1e300};
+		order.priority = -128;
+		order.weight = 65535;
+		std::string text = typedSerialize(order), err;
+		Order parsed;
+		CHECK(typedParse(text, parsed, err) && parsed == order);
+
+		// 对象成员的顺序不确定，整体按Json比较，单个成员与数组按文本比较
+		Json expected = Json::parse("{\"id\":-3,\"note\":\"q\\\"b\\\\s\\n\\t\\u0001\u00e9/\",\"paid\":false,"
+									"\"items\":[{\"sku\":\"a\",\"count\":18446744073709551615,\"price\":null},{\"sku\":\"b\\\"\",\"count\":0,\"price\":0.1}],"
+									"\"gift\":{\"sku\":\"g\",\"count\":1,\"price\":1e300},\"tags\":[],\"priority\":-128,\"w\":65535}",
+									errorText);
+		CHECK(Json::parse(text, err) == expected);
+		CHECK(typedSerialize(order.note) == Json(order.note).serialize());
+		CHECK(typedSerialize(order.tags) == Json(Json::_array()).serialize());
+		CHECK(typedSerialize(std::vector<std::optional<double>>{1.5, std::nullopt, -0.25}) == Json::parse("[1.5,null,-0.25]", err).serialize());
+		CHECK(typedSerialize(std::vector<std::string>{"", "\x1f\r"}) == Json(Json::_array{Json(""), Json("\x1f\r")}).serialize());
+		Note note{"v\b"};
+		CHECK(typedSerialize(note) == Json(Json::_object{{"t\"\\\n\x01", Json("v\b")}}).serialize());
+		Note back;
+		CHECK(typedParse(typedSerialize(note), back, err) && back.text == note.text);
+	}
+
+	// 编译期字面量：查找、下标与字符串反转义均在编译期求值，toJson()与运行时解析一致
+	{
+		static constexpr auto config = DIANA_JSON_LITERAL(R"({"port": 8080, "hosts": ["a", "b\u00e9\n"], "tls": {"on": true, "ratio": -1.25e-2}, "none": null, "q": "\"\\\/"})");
+		static_assert(config.size() == 5);
+		static_assert(config["port"].toDouble() == 8080);
+		static_assert(config["hosts"].size() == 2 && config["hosts"][0].toString() == "a");
+		static_assert(config["hosts"][1].toString() == "b\u00e9\n");
+		static_assert(config["tls"]["on"].toBool() && config["tls"]["ratio"].toDouble() == -1.25e-2);
+		static_assert(config["none"].isNull() && !config.root().contains("missing"));
+		static_assert(config["q"].toString() == "\"\\/");
+		static constexpr auto empty = DIANA_JSON_LITERAL("[[], {}]");
+		static_assert(empty.size() == 2 && empty[0].isArray() && empty[1].size() == 0);
+		CHECK(config.toJson() == Json::parse(R"({"port": 8080, "hosts": ["a", "b\u00e9\n"], "tls": {"on": true, "ratio": -1.25e-2}, "none": null, "q": "\"\\\/"})", errorText));
+		CHECK(empty.toJson() == Json::parse("[[], {}]", errorText));
+	}
+
+	// 并行算法：元素数少于与多于minChunk时结果相同，过滤保持顺序，回调的异常传回调用方
+	{
+		JsonThreadPool pool(4);
+		for (size_t n : {size_t(0), size_t(100), JsonThreadPool::minChunk * 40 + 7}) {
+			Json::_array values;
+			for (size_t i = 0; i != n; ++i) values.emplace_back(static_cast<double>(i));
+			Json arr(std::move(values));
+
+			std::atomic<size_t> visited{0};
+			parallelForEach(arr, [&](const Json &v) { visited += static_cast<size_t>(v.toDouble()) + 1; }, pool);
+			CHECK(visited == n * (n + 1) / 2);
+
+			Json doubled = parallelTransform(arr, [](const Json &v) { return v.toDouble() * 2; }, pool);
+			bool same = doubled.size() == n;
+			for (size_t i = 0; same && i != n; ++i) same = doubled[i].toDouble() == 2.0 * i;
+			CHECK(same);
+
+			Json odd = parallelFilter(arr, [](const Json &v) { return static_cast<size_t>(v.toDouble()) % 2 == 1; }, pool);
+			bool ordered = odd.size() == n / 2;
+			for (size_t i = 0; ordered && i != odd.size(); ++i) ordered = odd[i].toDouble() == 2.0 * i + 1;
+			CHECK(ordered);
+
+			double sum = parallelReduce(arr, 0.0, [](double acc, const Json &v) { return acc + v.toDouble(); }, std::plus<double>(), pool);
+			CHECK(sum * 2 == n * (n - 1.0));
+
+			bool thrown = false;
+			try {
+				parallelForEach(arr, [](const Json &v) { if (v.toDouble() == 42) throw JsonException("boom"); }, pool);
+			} catch (JsonException &e) {
+				thrown = std::string(e.what()) == "boom";
+			}
+			CHECK(thrown == (n > 42));
+		}
+
+		Json obj = Json::parse("{\"a\":1,\"b\":2,\"c\":3}", errorText);
+		Json keyed = parallelTransform(obj, [](const std::string &key, const Json &v) { return key + std::to_string(static_cast<int>(v.toDouble())); }, pool);
+		CHECK(keyed == Json::parse("{\"a\":\"a1\",\"b\":\"b2\",\"c\":\"c3\"}", errorText));
+		CHECK(parallelFilter(obj, [](const Json &v) { return v.toDouble() > 1; }, pool) == Json::parse("{\"b\":2,\"c\":3}", errorText));
+		CHECK(parallelReduce(obj, std::string(), [](std::string acc, const std::string &key, const Json &) { return acc + key; },
+							 [](std::string a, std::string b) { return a + b; }, pool).size() == 3);
+		std::atomic<int> total{0};
+		parallelForEach(obj, [&](const std::string &, const Json &v) { total += static_cast<int>(v.toDouble()); }, pool);
+		CHECK(total == 6);
+
+		bool rejected = false;
+		try {
+			parallelForEach(Json::parse("[1]", errorText), [](const std::string &, const Json &) {}, pool);
+		} catch (JsonException &e) {
+			rejected = std::string(e.what()).find("(key, value)") != std::string::npos;
+		}
+		CHECK(rejected);
+
+		// 线程池：每个下标恰好执行一次，嵌套调用不死锁
+		std::vector<std::atomic<int>> hits(1000);
+		pool.parallelFor(hits.size(), 7, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i != end; ++i) ++hits[i];
+		});
+		CHECK(std::all_of(hits.begin(), hits.end(), [](const std::atomic<int> &h) { return h == 1; }));
+		std::atomic<size_t> nested{0};
+		pool.parallelFor(8, 1, [&](size_t, size_t) {
+			pool.parallelFor(100, 10, [&](size_t begin, size_t end) { nested += end - begin; });
+		});
+		CHECK(nested == 800);
+	}
+
+	// 内存统计：节点按类型计数，字节数随内容增长；分配计数只统计Json树自身的分配
+	{
+		std::string longText(100, 'x');
+		Json doc = Json::parse("{\"a\":[1,2,null],\"t\":true,\"s\":\"" + longText + "\"}", errorText);
+		JsonMemoryUsage usage = doc.memoryUsage();
+		size_t counts[6] = {1, 1, 2, 1, 1, 1};// 以JsonValueType为下标
+		CHECK(std::equal(std::begin(counts), std::end(counts), std::begin(usage.nodes)));
+		CHECK(usage.bytes >= 7 * sizeof(Json) + 3 * sizeof(Json) + longText.size() + 1);
+		doc["a"].asArray().resize(1000);
+		CHECK(doc.memoryUsage().bytes >= usage.bytes + 997 * sizeof(Json) && doc.memoryUsage().nodes[0] == 998);
+
+		JsonAllocationCounter outer;
+		std::vector<int> unrelated(1000);// 非Json的分配不计入
+		CHECK(outer.stats().allocations == 0 && outer.stats().bytes == 0);
+		{
+			JsonAllocationCounter inner;
+			Json parsed = Json::parse("[{\"k\":[1,2,3]},\"s\",null]", errorText);
+			CHECK(JsonAllocationCounter::enabled() == (inner.stats().allocations != 0));
+			CHECK(inner.stats().allocations == outer.stats().allocations && inner.stats().peak >= inner.stats().bytes);
+		}
+		CHECK(outer.stats().bytes == 0 && outer.stats().frees == outer.stats().allocations);
+		outer.reset();
+		CHECK(outer.stats().allocations == 0 && outer.stats().peak == 0);
+	}
+
+#ifdef DIANA_JSON_PARSE_STATS
+	// 解析统计：值与键的个数、嵌套深度、转义与最大容器；出错时统计到出错的位置为止
+	{
+		std::string text = R"({"a": [1, 2, {"b": "x\n\u00e9\ud83d\ude00"}], "c": null, "d": true, "e": [[], {}]})";
+		JsonParseStats stats;
+		std::string err;
+		Json doc = Json::parse(text, err, stats);
+		CHECK(err.empty() && stats.bytes == text.size());
+		size_t values[6] = {1, 1, 2, 1, 3, 3};// 以JsonValueType为下标
+		CHECK(std::equal(std::begin(values), std::end(values), std::begin(stats.values)));
+		CHECK(stats.keys == 5 && stats.stringBytes == 5 + 1 + 1 + 2 + 4);
+		CHECK(stats.escapes == 4 && stats.unicodeEscapes == 3);
+		CHECK(stats.maxDepth == 3 && stats.largestContainer == 4);
+		CHECK(stats.seconds >= 0);
+
+		Json::parse("[[1, 2], [3, x]]", err, stats);
+		CHECK(!err.empty() && stats.bytes == 13 && stats.values[static_cast<size_t>(JsonValueType::Number)] == 3 && stats.maxDepth == 2);
+	}
+#endif
+
+#if !defined(DIANA_JSON_VALIDATE_UTF8) || DIANA_JSON_VALIDATE_UTF8
+	// UTF-8校验：非法序列位于16与32字节块边界的各个位置时均被拒绝，合法序列原样保留
+	{
+		const char *invalid[] = {
+			"\xC0\xAF",        // 过长编码
+			"\xE0\x80\xAF",    // 过长编码
+			"\xF0\x80\x80\xAF",// 过长编码
+			"\xED\xA0\x80",    // 代理项U+D800
+			"\xED\xBF\xBF",    // 代理项U+DFFF
+			"\xF4\x90\x80\x80",// 超出U+10FFFF
+			"\xF5\x80\x80\x80",// 超出U+10FFFF
+			"\xE6\x97",        // 截断
+			"\xF0\x9D\x84",    // 截断
+			"\x80",            // 孤立的后续字节
+			"\xFF",
+		};
+		const char *valid[] = {"\xC3\xA9", "\xE2\x82\xAC", "\xED\x9F\xBF", "\xEE\x80\x80", "\xF0\x9D\x84\x9E", "\xF4\x8F\xBF\xBF"};
+		std::string err;
+		bool rejected = true, kept = true;
+		for (size_t offset = 0; offset != 64; ++offset) {
+			for (const char *bad : invalid) {
+				std::string text = "\"" + std::string(offset, 'a') + bad + std::string(40, 'b') + "\"";
+				err.clear();
+				rejected = rejected && Json::parse(text, err).isNull() && err.compare(0, 12, "INVALID UTF8") == 0;
+				err.clear();// 紧接在右引号之前
+				rejected = rejected && Json::parse("[\"" + std::string(offset, 'a') + bad + "\"]", err).isNull() && !err.empty();
+			}
+			for (const char *good : valid) {
+				std::string content = std::string(offset, 'a') + good + std::string(offset % 7, 'b') + good;
+				err.clear();
+				Json parsed = Json::parse("\"" + content + "\"", err);
+				kept = kept && err.empty() && parsed.isString() && parsed.toString() == content;
+			}
+		}
+		CHECK(rejected);
+		CHECK(kept);
+	}
+#endif
+
+	// 白空格：以不同的起始偏移与长度插入，覆盖换行加缩进、CRLF、制表符与混合的情况，跨越向量块的边界与文本末尾
+	{
+		const char ws[] = " \t\n\r";
+		unsigned seed = 2025;
+		bool ok = true;
+		for (size_t i = 0; i != 2000; ++i) {
+			size_t n = i % 80;
+			std::string text(i % 48, ' ');
+			text += '[';
+			for (size_t j = 0; j != 4; ++j) {
+				seed = seed * 1103515245 + 12345;
+				switch (i % 4) {
+					case 0:// 换行后接n个空格
+						text += '\n' + std::string(n, ' ');
+						break;
+					case 1:// CRLF后接n个空格
+						text += "\r\n" + std::string(n, ' ');
+						break;
+					case 2:// 制表符缩进
+						text += '\n' + std::string(n % 12, '\t');
+						break;
+					default:// 随机混合
+						for (size_t k = (seed >> 8) % 80; k > 0; --k) {
+							seed = seed * 1103515245 + 12345;
+							text += ws[(seed >> 16) % 4];
+						}
+						break;
+				}
+				text += "1,2]"[j];
+			}
+			std::string err;
+			Json parsed = Json::parse(text, err);
+			ok = ok && err.empty() && parsed.isArray() && parsed.size() == 2;
+			err.clear();
+			Json::parse(text + "\n  x", err);
+			ok = ok && err.compare(0, 17, "ROOT NOT SINGULAR") == 0;
+			err.clear();
+			Json::parse(text + "\n  " + std::string(n, (i & 1) ? ' ' : '\t'), err);// 以白空格结尾
+			ok = ok && err.empty();
+		}
+		CHECK(ok);
+	}
+
+	std::cout << (failures == 0 ? "all checks passed" : "checks failed") << std::endl;
+	return failures == 0 ? 0 : 1;
 }
\ No newline at end of file